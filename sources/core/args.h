@@ -504,6 +504,13 @@ class arguments
 
 								getline(linestream, data, '\r');
 								args.update(key, data) ;
+
+								// '#BEGIN_STREAM' is immediately followed by
+								// the binary payload, which may well start
+								// with a '#' byte: stop here.
+								if (key == "BEGIN_STREAM") {
+									break;
+								}
 							}
 						}
 					}
@@ -35,6 +35,10 @@
 
 #include <Eigen/Core>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 typedef Eigen::VectorXd vec;
 typedef Eigen::Ref<vec> vecref;
 typedef Eigen::Ref<const vec> const_vecref;
@@ -106,6 +110,59 @@ static bool close_to(const T a, const T b, const T epsilon = 1E-7)
     return std::abs(a - b) < epsilon;
 }
 
+/*! \brief Split [0, N) in consecutive ranges of at most CHUNK indices and
+ *  call FN(C, FIRST, COUNT) for the C-th range [FIRST, FIRST + COUNT), in
+ *  parallel when OpenMP is available.
+ *
+ *  \details
+ *  The ranges only depend on N and CHUNK, not on the number of threads, so
+ *  that per-range results can be combined in the order of C to get
+ *  reproducible results.  FN must be safe to call concurrently on distinct
+ *  ranges.  At most NB_THREADS threads are used when it is positive, and the
+ *  OpenMP default otherwise; the process-wide setting is left unchanged.
+ */
+template<typename Function>
+void parallel_for_chunks(int n, int chunk, Function fn, int nb_threads = 0)
+{
+    const int count = (n + chunk - 1) / chunk;
+
+#ifdef _OPENMP
+    if(nb_threads <= 0)
+        nb_threads = omp_get_max_threads();
+#else
+    (void) nb_threads;
+#endif
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nb_threads)
+    for(int c = 0; c < count; ++c)
+        fn(c, c * chunk, std::min(chunk, n - c * chunk));
+}
+
+/*! \brief Return the sum of FN(FIRST, COUNT) over the ranges of
+ *  \a parallel_for_chunks, starting from ZERO, on at most NB_THREADS
+ *  threads when it is positive.
+ *
+ *  \details
+ *  The partial results are added in the order of the ranges, so the result
+ *  does not depend on the number of threads.
+ */
+template<typename T, typename Function>
+T parallel_sum_chunks(int n, int chunk, const T& zero, Function fn,
+                      int nb_threads = 0)
+{
+    std::vector<T> partial((n + chunk - 1) / chunk, zero);
+    parallel_for_chunks(n, chunk, [&](int c, int first, int count)
+    {
+        partial[c] = fn(first, count);
+    }, nb_threads);
+
+    T result = zero;
+    for(const T& p : partial)
+        result += p;
+
+    return result;
+}
+
 
 /* Mark a type, class, method, function, or variable as deprecated.  */
 #ifdef __GNUC__
@@ -28,6 +28,27 @@ void data::save(const std::string& filename) const
     file.close();
 }
 
+void data::get_block(int first, Eigen::Ref<RowMatrixXd> block) const
+{
+    assert(first >= 0 && first + block.rows() <= size());
+    assert(block.cols() == _parameters.dimX() + _parameters.dimY());
+
+    for(int i = 0; i < block.rows(); i++)
+    {
+        block.row(i) = get(first + i);
+    }
+}
+
+void data::values(const Eigen::Ref<const RowMatrixXd>& x,
+                  Eigen::Ref<RowMatrixXd> y) const
+{
+    assert(x.rows() == y.rows());
+    for(int i = 0; i < x.rows(); i++)
+    {
+        y.row(i) = value(x.row(i).transpose()).transpose();
+    }
+}
+
 bool data::equals(const data& data, double epsilon)
 {
     if (size() != data.size()
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <cmath>
 #include <cassert>
+#include <algorithm>
 
 #include "common.h"
 #include "args.h"
@@ -63,6 +64,20 @@ class data
     // Acces to data
     virtual vec get(int i) const = 0 ;
 
+    //! \brief Copy the (dimX + dimY) coordinates of the rows [FIRST, FIRST
+    //! + BLOCK.rows()) to BLOCK.
+    //!
+    //! \details
+    //! Reading the data block by block, in increasing row order, is the
+    //! access pattern that suits data objects that are not resident in
+    //! memory, such as \a streaming_data.  The default implementation
+    //! calls \a get for each row.
+    virtual void get_block(int first, Eigen::Ref<RowMatrixXd> block) const;
+
+    //! \brief Return the preferred number of rows of the blocks passed to
+    //! \a get_block.
+    virtual int block_size() const { return 4096; }
+
     //! \brief Provide an evaluation of the data using interpolation. If
     //! the data object does not provide an interpolation mechanism, it
     //! should throw an exception.
@@ -72,6 +87,17 @@ class data
     //! match the total dimension: dimX + dimY.
     virtual vec value(const vec& in) const = 0;
 
+    //! \brief Interpolate the data at each row of X, a N×dimX block of
+    //! input points, and store the results in the rows of Y, a N×dimY
+    //! block.
+    //!
+    //! \details
+    //! The default implementation calls \a value for each row.  Plugins
+    //! that interpolate sparse data should override it to process all the
+    //! points of the block at once.
+    virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+                        Eigen::Ref<RowMatrixXd> y) const;
+
     //! \brief Put the sample inside the data at index I.
     virtual void set(int i, const vec& x) = 0;
 
@@ -109,6 +135,47 @@ class data
     vec _min, _max;
 } ;
 
+/*! \brief Call FN(FIRST, BLOCK) for consecutive blocks of rows of D, where
+ *  BLOCK is a matrix holding the (dimX + dimY) coordinates of the rows
+ *  starting at FIRST.
+ *
+ *  \details
+ *  The rows are read with \a data::get_block, so D need not be resident in
+ *  memory.  BLOCK is only valid during the call to FN.
+ */
+template<typename Function>
+void for_each_block(const data& d, Function fn)
+{
+    RowMatrixXd block(std::min(d.block_size(), d.size()),
+                      d.parametrization().dimX() + d.parametrization().dimY());
+
+    for(int first = 0; first < d.size(); first += block.rows())
+    {
+        if(d.size() - first < block.rows())
+            block.conservativeResize(d.size() - first, Eigen::NoChange);
+
+        d.get_block(first, block);
+        fn(first, const_cast<const RowMatrixXd&>(block));
+    }
+}
+
+/*! \brief Call FN(I, ROW) for each row I of D, where ROW points to the
+ *  (dimX + dimY) coordinates of that row.
+ *
+ *  \details
+ *  The rows are read block by block with \a for_each_block.  ROW is only
+ *  valid during the call to FN.
+ */
+template<typename Function>
+void for_each_row(const data& d, Function fn)
+{
+    for_each_block(d, [&](int first, const RowMatrixXd& block)
+    {
+        for(int i = 0; i < block.rows(); ++i)
+            fn(first + i, &block(i, 0));
+    });
+}
+
 /*! \brief Change the parametrization of data to fit the parametrization of the
  *  function to be fitted.
  *
@@ -14,14 +14,30 @@
 #include "vertical_segment.h"
 
 #include <iostream>
+#include <sstream>
 #include <limits>
 #include <iomanip>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 #ifdef __GLIBC__
 # include <endian.h>
 #endif
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
 using namespace alta;
 using namespace Eigen;
 
@@ -33,6 +49,12 @@ static void delete_array(double *thing)
     delete[] thing;
 }
 
+// Version of the binary format written by 'save_data_as_binary'.  Version 1
+// pads the header so that the sample stream starts at a multiple of
+// BINARY_DATA_ALIGNMENT bytes, which allows it to be mapped in memory.
+static const int binary_format_version = 1;
+static const size_t binary_data_alignment = 4096;
+
 
 static bool cosine_correction(vecref v, unsigned int dimX, unsigned int dimY,
                               alta::params::input in_param)
@@ -49,12 +71,7 @@ static bool cosine_correction(vecref v, unsigned int dimX, unsigned int dimY,
     {
         factor = 1.0/cart[5]*cart[2];
         for(unsigned int i = 0; i < dimY; ++i)
-        {
-            std::cout << "i = " << i << " dimx = " << dimX
-                      << " + = " << i + dimX << " | " << v.size()
-                      << std::endl;
             v(i + dimX) /= factor;
-        }
         return true;
     }
     else return false;
@@ -85,13 +102,56 @@ static int number_from_ci_kind(vertical_segment::ci_kind kind)
                ? 1 : 0);
 }
 
-// Read a confidence interval on the output parameters from INPUT into V.
-static void read_confidence_interval(std::istream& input,
+// Options controlling the confidence interval of the samples read from a
+// text stream.  They are looked up once rather than for every sample.
+struct ci_options
+{
+    double dt;
+    bool relative, max, positive;
+
+    ci_options(const alta::arguments& args)
+        : dt(args.get_double("dt", 0.1)),
+          relative(args.is_defined("dt-relative")),
+          max(args.is_defined("dt-max")),
+          positive(args.is_defined("dt-positive"))
+    {}
+};
+
+// Parse a floating-point number from the line [CURSOR, END) into RESULT and
+// advance CURSOR past it.  Return false, leaving RESULT untouched, when the
+// line contains no more numbers.
+static bool parse_number(const char*& cursor, const char* end, double& result)
+{
+    while (cursor < end && std::isspace((unsigned char) *cursor))
+        ++cursor;
+
+    if (cursor == end)
+        return false;
+
+    // Note: A number cannot span several lines, so 'strtod' stops before
+    // END.
+    char* next;
+    double value = std::strtod(cursor, &next);
+    if (next == cursor)
+    {
+        // Not a number: like 'operator>>', give up on the rest of the line.
+        cursor = end;
+        return false;
+    }
+
+    cursor = next;
+    result = value;
+    return true;
+}
+
+// Read a confidence interval on the output parameters from the line
+// [CURSOR, END) into V.
+static void read_confidence_interval(const char*& cursor, const char* end,
                                      vecref v,
                                      vertical_segment::ci_kind kind,
                                      unsigned int dimX,
                                      unsigned int dimY,
-                                     const alta::arguments& args)
+                                     const ci_options& options)
 {
     assert(v.size() == dimX + 3 * dimY);
 
@@ -101,33 +161,32 @@ static void read_confidence_interval(std::istream& input,
 
         if(i == 0 && kind == vertical_segment::ASYMMETRICAL_CONFIDENCE_INTERVAL)
         {
-            input >> min_dt ;
-            input >> max_dt ;
+            parse_number(cursor, end, min_dt);
+            parse_number(cursor, end, max_dt);
             //min_dt = min_dt-v(dimX + i);
             //max_dt = max_dt-v(dimX + i);
             min_dt = -min_dt;
         }
         else if(i == 0 && kind == vertical_segment::SYMMETRICAL_CONFIDENCE_INTERVAL)
         {
-            double dt ;
-            input >> dt ;
+            double dt = 0.0;
+            parse_number(cursor, end, dt);
             min_dt = -dt;
             max_dt =  dt;
         }
         else
         {
             // Confidence interval data not provided in INPUT.
-            double dt = args.get_double("dt", 0.1);
-            min_dt = -dt;
-            max_dt =  dt;
+            min_dt = -options.dt;
+            max_dt =  options.dt;
         }
 
-        if(args.is_defined("dt-relative"))
+        if(options.relative)
         {
             v(dimX +   dimY+i) = v(dimX + i) * (1.0 + min_dt) ;
             v(dimX + 2*dimY+i) = v(dimX + i) * (1.0 + max_dt) ;
         }
-        else if(args.is_defined("dt-max"))
+        else if(options.max)
         {
             v(dimX +   dimY+i) = v(dimX + i) + std::max(v(dimX + i) * min_dt, min_dt);
             v(dimX + 2*dimY+i) = v(dimX + i) + std::max(v(dimX + i) * max_dt, max_dt);
@@ -141,26 +200,144 @@ static void read_confidence_interval(std::istream& input,
         // You can enforce the vertical segment to stay in the positive
         // region using the --data-positive command line argument. Note
         // that the data point is also clamped to zero if negative.
-        if(args.is_defined("dt-positive"))
+        if(options.positive)
         {
             v(dimX +        i) = std::max(v(dimX +        i), 0.0);
             v(dimX +   dimY+i) = std::max(v(dimX +   dimY+i), 0.0);
             v(dimX + 2*dimY+i) = std::max(v(dimX + 2*dimY+i), 0.0);
         }
+    }
+}
 
-#ifdef DEBUG
-        std::cout << "<<DEBUG>> vs = [" << v[dimX +   dimY+i] << ", " << v[dimX + 2*dimY+i] << "]" << std::endl;
-#endif
+// Everything needed to turn the lines of a text stream into rows of a
+// 'vertical_segment'.
+struct text_layout
+{
+    unsigned int dimX, dimY;
+    params::input in_param;
+    vertical_segment::ci_kind kind;
+    vec min, max, ymin, ymax;
+    bool correct_cosine;
+    ci_options options;
+
+    size_t row_count() const
+    {
+        return dimX + 3 * dimY;
+    }
+};
+
+// Return true if the line [BEGIN, END) is a comment or contains only
+// blanks.
+static bool is_blank_line(const char* begin, const char* end)
+{
+    if (begin < end && *begin == '#')
+        return true;
+
+    for (; begin < end; ++begin)
+        if (!std::isspace((unsigned char) *begin))
+            return false;
+
+    return true;
+}
+
+// Return the number of lines of [BEGIN, END) that may hold a sample.
+static size_t count_sample_lines(const char* begin, const char* end)
+{
+    size_t count = 0;
+    while (begin < end)
+    {
+        const char* eol = std::find(begin, end, '\n');
+        if (!is_blank_line(begin, eol))
+            ++count;
+        begin = eol + (eol < end ? 1 : 0);
     }
+
+    return count;
+}
+
+// Parse the samples found in [BEGIN, END) into OUT, which must have room
+// for one row per sample line, and return the number of rows kept once
+// filtering has been applied.
+static size_t parse_sample_lines(const char* begin, const char* end,
+                                 double* out, const text_layout& layout)
+{
+    using namespace alta;
+
+    size_t kept = 0;
+    const size_t row_count = layout.row_count();
+
+    while (begin < end)
+    {
+        const char* eol = std::find(begin, end, '\n');
+        const char* cursor = begin;
+        begin = eol + (eol < end ? 1 : 0);
+
+        // Discard comments and empty lines.
+        if (is_blank_line(cursor, eol))
+            continue;
+
+        Map<VectorXd> v(out + kept * row_count, row_count);
+
+        // Read the data point x and y coordinates.  Missing coordinates
+        // are read as zero, as with 'operator>>'.
+        for (int i = 0; i < layout.dimX + layout.dimY; ++i)
+        {
+            v(i) = 0.;
+            parse_number(cursor, eol, v(i));
+        }
+
+        // Read the confidence interval data if available.
+        read_confidence_interval(cursor, eol, v, layout.kind,
+                                 layout.dimX, layout.dimY, layout.options);
+
+        // Check if we need to filter out what we just read according to ARGS.
+        // TODO: Move filtering to a post-parsing operation on 'data'.
+        if (!(within_bounds(v.segment(0, layout.dimX), layout.min, layout.max)
+              && within_bounds(v.segment(layout.dimX, layout.dimY),
+                               layout.ymin, layout.ymax)))
+            continue;
+
+        if (layout.correct_cosine
+            && !cosine_correction(v.segment(0, layout.dimX + layout.dimY),
+                                  layout.dimX, layout.dimY, layout.in_param))
+            continue;
+
+        ++kept;
+    }
+
+    return kept;
+}
+
+// Return the rest of INPUT as a string.
+static std::string read_remaining(std::istream& input)
+{
+    std::string body;
+
+    // Use a single read when the size of the stream is known.
+    std::streampos start = input.tellg();
+    if (start != std::streampos(-1) && input.seekg(0, std::ios::end))
+    {
+        std::streampos end = input.tellg();
+        input.seekg(start);
+        body.resize(end - start);
+        input.read(&body[0], body.size());
+        body.resize(input.gcount());
+    }
+    else
+    {
+        input.clear();
+        std::ostringstream buffer;
+        buffer << input.rdbuf();
+        body = buffer.str();
+    }
+
+    return body;
 }
 
 alta::data* alta::load_data_from_text(std::istream& input,
                                       const alta::arguments& header,
                                       const alta::arguments& args)
 {
-  vec min, max ;
-  vec ymin, ymax;
-
   if(! header.is_defined("DIM")) {
     std::cerr << "<<ERROR>> Undefined dimensions ! ";
     std::cerr << "Please add DIM [int] [int] into the file header." << std::endl;
@@ -171,74 +348,86 @@ alta::data* alta::load_data_from_text(std::istream& input,
   params::output out_param = params::parse_output(header.get_string("PARAM_OUT", "UNKNOWN_OUTPUT"));
 
   std::pair<int, int> dim = header.get_pair<int>("DIM");
-  size_t row_count = dim.first + 3 * dim.second;
 
-  min = args.get_vec("min", dim.first, -std::numeric_limits<float>::max()) ;
-  max = args.get_vec("max", dim.first,  std::numeric_limits<float>::max()) ;
-#ifdef DEBUG
-  std::cout << "<<DEBUG>> data will remove outside of " << min << " -> " << max << " x-interval" << std::endl;
-#endif
+  const text_layout layout =
+  {
+      (unsigned int) dim.first, (unsigned int) dim.second, in_param,
+      ci_kind_from_number(header.get_int("VS")),
+      args.get_vec("min", dim.first, -std::numeric_limits<float>::max()),
+      args.get_vec("max", dim.first,  std::numeric_limits<float>::max()),
+      args.get_vec("ymin", dim.second, -std::numeric_limits<float>::max()),
+      args.get_vec("ymax", dim.second,  std::numeric_limits<float>::max()),
+      args.is_defined("data-correct-cosine"),
+      ci_options(args)
+  };
+  const size_t row_count = layout.row_count();
 
-  ymin = args.get_vec("ymin", dim.second, -std::numeric_limits<float>::max()) ;
-  ymax = args.get_vec("ymax", dim.second,  std::numeric_limits<float>::max()) ;
 #ifdef DEBUG
-  std::cout << "<<DEBUG>> data will remove outside of " << ymin << " -> " << ymax << " y-interval" << std::endl;
+  std::cout << "<<DEBUG>> data will remove outside of " << layout.min << " -> " << layout.max << " x-interval" << std::endl;
+  std::cout << "<<DEBUG>> data will remove outside of " << layout.ymin << " -> " << layout.ymax << " y-interval" << std::endl;
 #endif
 
-  auto kind = ci_kind_from_number(header.get_int("VS"));
-  std::vector<double> content;
-
   std::cout << "<<INFO>> Starting to load file ... " << std::endl;
 
-  // Now read the body.
-  while(input.good())
+  const std::string body = read_remaining(input);
+  const char* const begin = body.data();
+  const char* const end = begin + body.size();
+
+  // Split the body into chunks at line boundaries.  Chunks are parsed
+  // concurrently, each one into its own range of rows of the final buffer.
+#ifdef _OPENMP
+  const int chunk_count = body.size() < (1 << 20)
+      ? 1 : 4 * omp_get_max_threads();
+#else
+  const int chunk_count = 1;
+#endif
+  std::vector<const char*> bounds(chunk_count + 1, end);
+  bounds[0] = begin;
+  for (int c = 1; c < chunk_count; ++c)
+  {
+      const char* target = std::max(bounds[c - 1],
+                                    begin + body.size() / chunk_count * c);
+      const char* eol = std::find(target, end, '\n');
+      bounds[c] = eol + (eol < end ? 1 : 0);
+  }
+
+  // First pass: count the sample lines of each chunk to know where its
+  // rows go.
+  std::vector<size_t> first_row(chunk_count + 1, 0);
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < chunk_count; ++c)
+      first_row[c + 1] = count_sample_lines(bounds[c], bounds[c + 1]);
+  for (int c = 0; c < chunk_count; ++c)
+      first_row[c + 1] += first_row[c];
+
+  // Second pass: parse and filter the samples.
+  const size_t capacity = first_row[chunk_count];
+  double *raw_content = new double[std::max<size_t>(capacity, 1) * row_count];
+  std::vector<size_t> kept(chunk_count, 0);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < chunk_count; ++c)
+      kept[c] = parse_sample_lines(bounds[c], bounds[c + 1],
+                                   raw_content + first_row[c] * row_count,
+                                   layout);
+
+  // Close the gaps left by filtered-out samples.
+  size_t element_count = 0;
+  for (int c = 0; c < chunk_count; ++c)
   {
-    std::string line ;
-    std::getline(input, line) ;
-    std::stringstream linestream(line) ;
+      if (element_count != first_row[c])
+          memmove(raw_content + element_count * row_count,
+                  raw_content + first_row[c] * row_count,
+                  kept[c] * row_count * sizeof(double));
+      element_count += kept[c];
+  }
 
-    // Discard comments and empty lines.
-    if(line.empty() || linestream.peek() == '#')
-    {
-      continue ;
-    }
-    else
-    {
-      auto start = content.size();
-
-      // Read the data point x and y coordinates
-      for(int i=0; i < dim.first + dim.second; ++i)
-      {
-          double item;
-          linestream >> item;
-          content.push_back(item);
-      }
-
-      // Save room for the confidence interval.
-      for (int i = 0; i < 2 * dim.second; i++)
-          content.push_back(0.);
-
-      Map<VectorXd> v(&content[start], row_count);
-
-      // Read the confidence interval data if available.
-      read_confidence_interval(linestream, v, kind,
-                               dim.first, dim.second, args);
-
-      // Check if we need to filter out what we just read according to ARGS.
-      // TODO: Move filtering to a post-parsing operation on 'data'.
-      if (!(within_bounds(v.segment(0, dim.first), min, max)
-            && within_bounds(v.segment(dim.first, dim.second),
-                             ymin, ymax)))
-      {
-          content.resize(start);
-      }
-      else if (args.is_defined("data-correct-cosine"))
-      {
-          if (!cosine_correction(v.segment(0, dim.first + dim.second),
-                                 dim.first, dim.second, in_param))
-              content.resize(start);
-      }
-    }
+  // Do not hold on to a mostly empty buffer.
+  if (element_count < capacity / 2)
+  {
+      double *tight = new double[std::max<size_t>(element_count, 1) * row_count];
+      memcpy(tight, raw_content, element_count * row_count * sizeof(double));
+      delete[] raw_content;
+      raw_content = tight;
   }
 
   std::cout << "<<INFO>> loaded input stream" << std::endl ;
@@ -246,18 +435,13 @@ alta::data* alta::load_data_from_text(std::istream& input,
             << dim.first
             << " -> R^" << dim.second << std::endl ;
 
-  std::cout << "<<DEBUG>> " << content.size() << " double loaded. " << std::endl ;
-
-
-  double *raw_content = new double[content.size()];
-  memcpy(raw_content, content.data(), content.size() * sizeof(double));
+  std::cout << "<<DEBUG>> " << element_count * row_count << " double loaded. " << std::endl ;
 
   parameters param(dim.first, dim.second, in_param, out_param);
-  size_t element_count = content.size() / row_count;
   data* result = new vertical_segment(param, element_count,
                                       std::shared_ptr<double>(raw_content,
-                                                                            delete_array));
-  if(args.is_defined("data-correct-cosine"))
+                                                              delete_array));
+  if(layout.correct_cosine)
       result->save("/tmp/data-corrected.dat");
 
   std::cout << "<<INFO>> " << element_count << " elements (rows) loaded" << std::endl ;
@@ -265,30 +449,50 @@ alta::data* alta::load_data_from_text(std::istream& input,
   return result;
 }
 
-void alta::save_data_as_text(std::ostream& out, const alta::data &data)
+void alta::save_text_header(std::ostream& out, const alta::parameters& params)
 {
-        using namespace alta;
-
-    out << "#DIM " << data.parametrization().dimX() << " " << data.parametrization().dimY() << std::endl;
+    out << "#DIM " << params.dimX() << " " << params.dimY() << std::endl;
     out << "#PARAM_IN  "
-        << params::get_name(data.parametrization().input_parametrization())
+        << params::get_name(params.input_parametrization())
         << std::endl;
     out << "#PARAM_OUT "
-        << params::get_name(data.parametrization().output_parametrization())
+        << params::get_name(params.output_parametrization())
         << std::endl;
+}
 
-    for(int i=0; i < data.size(); ++i)
+void alta::save_text_rows(std::ostream& out,
+                          const Eigen::Ref<const RowMatrixXd>& rows)
+{
+    for(int i=0; i < rows.rows(); ++i)
     {
-        vec x = data.get(i);
-        for(int j=0; j< data.parametrization().dimX() + data.parametrization().dimY(); ++j)
+        for(int j=0; j < rows.cols(); ++j)
         {
                     out << std::setprecision(std::numeric_limits<double>::digits10)
-                        << x[j] << "\t";
+                        << rows(i, j) << "\t";
         }
         out << std::endl;
     }
 }
 
+void alta::save_data_as_text(std::ostream& out, const alta::data &data)
+{
+        using namespace alta;
+
+    save_text_header(out, data.parametrization());
+
+    RowMatrixXd block(std::min(data.block_size(), data.size()),
+                      data.parametrization().dimX()
+                      + data.parametrization().dimY());
+    for(int first=0; first < data.size(); first += block.rows())
+    {
+        if(data.size() - first < block.rows())
+            block.conservativeResize(data.size() - first, Eigen::NoChange);
+
+        data.get_block(first, block);
+        save_text_rows(out, block);
+    }
+}
+
 void alta::save_data_as_binary(std::ostream &out, const alta::data& data)
 {
     using namespace alta;
@@ -298,29 +502,46 @@ void alta::save_data_as_binary(std::ostream &out, const alta::data& data)
         ? maybe_vs->confidence_interval_kind()
         : vertical_segment::NO_CONFIDENCE_INTERVAL;
 
-    out << "#DIM " << data.parametrization().dimX() << " " << data.parametrization().dimY() << std::endl;
-    out << "#PARAM_IN  "
-        << params::get_name(data.parametrization().input_parametrization())
-        << std::endl;
-    out << "#PARAM_OUT "
-        << params::get_name(data.parametrization().output_parametrization())
-        << std::endl;
-    out << "#FORMAT binary" << std::endl;
-    out << "#VERSION 0" << std::endl;
-    out << "#PRECISION ieee754-double" << std::endl;
-    out << "#SAMPLE_COUNT " << data.size() << std::endl;
-    out << "#VS " << number_from_ci_kind(kind) << std::endl;
+    // Build the header in memory first so that we know its length and can
+    // pad it such that the sample stream starts on a page boundary.
+    std::ostringstream header;
+
+    header << "#DIM " << data.parametrization().dimX() << " " << data.parametrization().dimY() << std::endl;
+    header << "#PARAM_IN  "
+           << params::get_name(data.parametrization().input_parametrization())
+           << std::endl;
+    header << "#PARAM_OUT "
+           << params::get_name(data.parametrization().output_parametrization())
+           << std::endl;
+    header << "#FORMAT binary" << std::endl;
+    header << "#VERSION " << binary_format_version << std::endl;
+    header << "#PRECISION ieee754-double" << std::endl;
+    header << "#SAMPLE_COUNT " << data.size() << std::endl;
+    header << "#VS " << number_from_ci_kind(kind) << std::endl;
 
     // FIXME: Note: on non-glibc systems, both macros may be undefined, so
     // the conditional is equivalent to "#if 0 == 0", which is usually what
     // we want.
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-    out << "#ENDIAN little" << std::endl;
+    header << "#ENDIAN little" << std::endl;
 #else
-    out << "#ENDIAN big" << std::endl;
+    header << "#ENDIAN big" << std::endl;
 #endif
 
-    out << "#BEGIN_STREAM" << std::endl;
+    static const std::string begin_stream = "#BEGIN_STREAM\n";
+
+    // Pad with a '# ' comment line, which header parsers ignore.
+    std::streamoff start = std::max<std::streamoff>(out.tellp(), 0);
+    size_t length = start + header.str().size() + begin_stream.size();
+    size_t padding = (binary_data_alignment
+                      - length % binary_data_alignment)
+        % binary_data_alignment;
+    if (padding > 0 && padding < 3)
+        padding += binary_data_alignment;
+    if (padding > 0)
+        header << "# " << std::string(padding - 3, ' ') << "\n";
+
+    out << header.str() << begin_stream;
 
     if (kind == vertical_segment::NO_CONFIDENCE_INTERVAL)
     {
@@ -348,13 +569,21 @@ void alta::save_data_as_binary(std::ostream &out, const alta::data& data)
     out << std::endl << "#END_STREAM" << std::endl;
 }
 
-alta::data* alta::load_data_from_binary(std::istream& in, const alta::arguments& header)
+// Layout of the sample stream of a binary file, as described by its header.
+struct binary_layout
 {
-    using namespace alta;
+    parameters param;
+    vertical_segment::ci_kind kind;
+    size_t sample_count;
+    size_t element_count;
+};
 
+static binary_layout parse_binary_header(const alta::arguments& header)
+{
     // FIXME: For now we make a number of assumptions.
     assert(header["FORMAT"] == "binary");
-    assert(header.get_int("VERSION") == 0);
+    assert(header.get_int("VERSION") >= 0
+           && header.get_int("VERSION") <= binary_format_version);
     assert(header["PRECISION"] == "ieee754-double");
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     assert(header["ENDIAN"] == "little");
@@ -367,37 +596,116 @@ alta::data* alta::load_data_from_binary(std::istream& in, const alta::arguments&
 
     auto kind = ci_kind_from_number(header.get_int("VS"));
 
-    in.exceptions(std::ios_base::failbit);
-
     int sample_count = header.get_int("SAMPLE_COUNT");
-      if(sample_count <= 0) {
-         std::cerr << "<<ERROR>> Uncorrect or not samples count in the header, please check \'SAMPLE_COUNT\'" << std::endl;
-      }
-
-      size_t ci_rows =
-          kind == vertical_segment::ASYMMETRICAL_CONFIDENCE_INTERVAL
-          ? 2 : (kind == vertical_segment::SYMMETRICAL_CONFIDENCE_INTERVAL
-                 ? 1 : 0);
-
-      size_t rows = dim.first + dim.second + ci_rows * dim.second;
-      size_t element_count = sample_count * rows;
-      double *content = new double[element_count];
-      size_t byte_count = element_count * sizeof *content;
-
-      // TODO: Arrange to use mmap and make it zero-alloc and zero-copy.
-      for (std::streamsize total = 0;
-           total < byte_count && !in.eof();
-           total += in.gcount())
-      {
-          in.read((char *) content + total, byte_count - total);
-      }
+    if(sample_count <= 0) {
+        std::cerr << "<<ERROR>> Uncorrect or not samples count in the header, please check \'SAMPLE_COUNT\'" << std::endl;
+        sample_count = 0;
+    }
+
+    size_t ci_rows =
+        kind == vertical_segment::ASYMMETRICAL_CONFIDENCE_INTERVAL
+        ? 2 : (kind == vertical_segment::SYMMETRICAL_CONFIDENCE_INTERVAL
+               ? 1 : 0);
+
+    size_t rows = dim.first + dim.second + ci_rows * dim.second;
 
     parameters param(dim.first, dim.second,
                      params::parse_input(header["PARAM_IN"]),
                      params::parse_output(header["PARAM_OUT"]));
 
-    return new alta::vertical_segment(param, sample_count,
+    return binary_layout { param, kind, size_t(sample_count),
+                           sample_count * rows };
+}
+
+alta::data* alta::load_data_from_binary(std::istream& in, const alta::arguments& header)
+{
+    using namespace alta;
+
+    auto layout = parse_binary_header(header);
+
+    in.exceptions(std::ios_base::failbit);
+
+    double *content = new double[layout.element_count];
+    size_t byte_count = layout.element_count * sizeof *content;
+
+    for (std::streamsize total = 0;
+         total < byte_count && !in.eof();
+         total += in.gcount())
+    {
+        in.read((char *) content + total, byte_count - total);
+    }
+
+    return new alta::vertical_segment(layout.param, layout.sample_count,
                                       std::shared_ptr<double>(content,
                                                               delete_array),
-                                      kind);
+                                      layout.kind);
+}
+
+alta::data* alta::load_data_from_mapped_binary(const std::string& file,
+                                               const alta::arguments& header,
+                                               size_t offset)
+{
+    // Version 0 files do not align the sample stream, so mapping it could
+    // lead to misaligned 'double' accesses.
+    if (header.get_int("VERSION") < 1 || offset % sizeof(double) != 0)
+        return NULL;
+
+    auto layout = parse_binary_header(header);
+    size_t byte_count = layout.element_count * sizeof(double);
+
+    // The mapping is private: pages are shared with other processes mapping
+    // the same file until 'vertical_segment::set' writes to them.
+    std::shared_ptr<char> mapping = map_file(file, offset, byte_count, true);
+    if (!mapping)
+        return NULL;
+
+    // Alias the mapping: the samples live as long as any 'shared_ptr'
+    // referring to them.
+    std::shared_ptr<double> content(mapping, (double *) mapping.get());
+
+    return new alta::vertical_segment(layout.param, layout.sample_count,
+                                      content, layout.kind);
+}
+
+std::shared_ptr<char> alta::map_file(const std::string& file,
+                                     size_t offset, size_t length,
+                                     bool writable)
+{
+#ifdef _WIN32
+    // Files are not mapped on Windows: callers fall back to reading the
+    // stream.
+    return std::shared_ptr<char>();
+#else
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::shared_ptr<char>();
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < offset + length)
+    {
+        std::cerr << "<<ERROR>> '" << file << "' is shorter than "
+                  << offset + length << " bytes" << std::endl;
+        ::close(fd);
+        return std::shared_ptr<char>();
+    }
+
+    // Map the file from its beginning rather than from OFFSET so that we do
+    // not depend on the system's page size.  Writable mappings are private,
+    // so writes are never propagated to the file.
+    size_t total = offset + length;
+    void *base = ::mmap(NULL, total,
+                        writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                        writable ? MAP_PRIVATE : MAP_SHARED,
+                        fd, 0);
+    ::close(fd);
+
+    if (base == MAP_FAILED)
+        return std::shared_ptr<char>();
+
+    std::shared_ptr<void> mapping(base, [total](void *p) {
+            ::munmap(p, total);
+        });
+
+    return std::shared_ptr<char>(mapping, (char *) base + offset);
+#endif
 }
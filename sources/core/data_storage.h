@@ -11,6 +11,8 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <memory>
 #include "data.h"
 #include "vertical_segment.h"
 #include "common.h"
@@ -21,6 +23,15 @@ namespace alta
     // Write DATA to OUT in ALTA's text format.
     void save_data_as_text(std::ostream& out, const alta::data &data);
 
+    // Write to OUT the header of ALTA's text format for data with
+    // parameters PARAMS.
+    void save_text_header(std::ostream& out, const alta::parameters& params);
+
+    // Write the (dimX + dimY) coordinates of ROWS to OUT in ALTA's text
+    // format.  Use it after 'save_text_header' to write data incrementally.
+    void save_text_rows(std::ostream& out,
+                        const Eigen::Ref<const RowMatrixXd>& rows);
+
     // Write DATA to OUT in a compact binary format.
     void save_data_as_binary(std::ostream& out, const alta::data& data);
 
@@ -34,5 +45,26 @@ namespace alta
 
     // Return the data read from the binary-formatted stream IN.
     data* load_data_from_binary(std::istream& in, const alta::arguments& header);
+
+    // Return the data of the binary-formatted FILE, whose header HEADER has
+    // already been parsed and whose sample stream starts at byte OFFSET.
+    // The samples are mapped in memory rather than read, so loading is
+    // O(header) and processes loading the same file share its pages.
+    // Return NULL when the file cannot be mapped, for instance because it
+    // uses version 0 of the format.
+    data* load_data_from_mapped_binary(const std::string& file,
+                                       const alta::arguments& header,
+                                       size_t offset);
+
+    // Map LENGTH bytes of FILE, starting at byte OFFSET, in memory and
+    // return a pointer to them that keeps the mapping alive.  Read-only
+    // mappings share their pages with all the processes mapping FILE;
+    // WRITABLE mappings are private and copy the pages they write to.
+    // Return NULL when FILE cannot be mapped or is too short, and always on
+    // Windows, where files are not mapped: callers must then read FILE
+    // through their stream, as the MERL, UTIA and EXR loaders do.
+    std::shared_ptr<char> map_file(const std::string& file,
+                                   size_t offset, size_t length,
+                                   bool writable = false);
 }
 
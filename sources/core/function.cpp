@@ -19,8 +19,38 @@
 
 using namespace alta;
 
+// Return the rows of X, points in the FROM parametrization, expressed in
+// the input space of F.  BUFFER holds the converted points when needed.
+static Eigen::Ref<const RowMatrixXd>
+input_block(const Eigen::Ref<const RowMatrixXd>& x, params::input from,
+            const function& f, RowMatrixXd& buffer)
+{
+	const params::input to = f.parametrization().input_parametrization();
+	if(from == to)
+	{
+		return x;
+	}
+
+	buffer.resize(x.rows(), f.parametrization().dimX());
+	for(int n=0; n<x.rows(); ++n)
+	{
+		params::convert(x.row(n).data(), from, to, &buffer(n, 0));
+	}
+	return buffer;
+}
+
 /*--- Functions implementation ----*/
 
+void function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                      Eigen::Ref<RowMatrixXd> y) const
+{
+	assert(x.rows() == y.rows());
+	for(int n=0; n<x.rows(); ++n)
+	{
+		y.row(n) = value(x.row(n).transpose()).transpose();
+	}
+}
+
 void function::bootstrap(const ptr<data>, const arguments& args)
 {
   #ifdef BOOTSTRAP_DEBUG
@@ -396,6 +426,16 @@ vec nonlinear_function::getParametersMin() const
 	return m;
 }
 
+void nonlinear_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                             Eigen::Ref<RowMatrixXd> jac) const
+{
+	assert(x.rows() == jac.rows());
+	for(int n=0; n<x.rows(); ++n)
+	{
+		jac.row(n) = parametersJacobian(x.row(n).transpose()).transpose();
+	}
+}
+
 
 
 /*--- Compound functions implementation ----*/
@@ -420,6 +460,22 @@ vec compound_function::value(const vec& x) const
 	return res;
 }
 
+void compound_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                               Eigen::Ref<RowMatrixXd> y) const
+{
+	assert(x.rows() == y.rows());
+	y.setZero();
+
+	RowMatrixXd temp_x, temp_y(x.rows(), parametrization().dimY());
+	for(unsigned int i=0; i<fs.size(); ++i)
+	{
+		fs[i]->values(input_block(x, parametrization().input_parametrization(),
+		                          *fs[i], temp_x),
+		              temp_y);
+		y += temp_y;
+	}
+}
+
 vec compound_function::parametersJacobian(const vec& x) const
 {
 	int nb_params = nbParameters();
@@ -457,6 +513,42 @@ vec compound_function::parametersJacobian(const vec& x) const
 	return jac;
 }
 
+void compound_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                            Eigen::Ref<RowMatrixXd> jac) const
+{
+	const int nb_params = nbParameters();
+	assert(x.rows() == jac.rows());
+	assert(jac.cols() == nb_params*parametrization().dimY());
+	jac.setZero();
+
+	int start_i = 0;
+
+	// Export the sub-Jacobian for each function
+	RowMatrixXd temp_x, func_jac;
+	for(unsigned int f=0; f<fs.size(); ++f)
+	{
+		const ptr<nonlinear_function>& func = fs[f];
+		int nb_f_params = func->nbParameters();
+
+		// Only export Jacobian if there are non-linear parameters
+		if(nb_f_params > 0 && !is_fixed[f])
+		{
+			func_jac.resize(x.rows(), nb_f_params*parametrization().dimY());
+			func->parametersJacobians(input_block(x, parametrization().input_parametrization(),
+			                                      *func, temp_x),
+			                          func_jac);
+
+			for(int y=0; y<parametrization().dimY(); ++y)
+			{
+				jac.middleCols(y*nb_params + start_i, nb_f_params) =
+					func_jac.middleCols(y*nb_f_params, nb_f_params);
+			}
+
+			start_i += nb_f_params;
+		}
+	}
+}
+
 // Return the parameters of the composition of FUNCTIONS.
 static const parameters
 compound_parameters(const std::vector<ptr<nonlinear_function> >& functions)
@@ -1239,6 +1331,83 @@ vec product_function::parametersJacobian(const vec& x) const
 	return jac;
 }
 
+void product_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                              Eigen::Ref<RowMatrixXd> y) const
+{
+	assert(x.rows() == y.rows());
+
+	RowMatrixXd xf1, xf2;
+	RowMatrixXd f1_value(x.rows(), f1->parametrization().dimY());
+	RowMatrixXd f2_value(x.rows(), f2->parametrization().dimY());
+	f1->values(input_block(x, parametrization().input_parametrization(), *f1, xf1),
+	           f1_value);
+	f2->values(input_block(x, parametrization().input_parametrization(), *f2, xf2),
+	           f2_value);
+
+	// Same as 'product', row by row
+	if(f1_value.cols() == 1)
+		y = f2_value.array().colwise() * f1_value.col(0).array();
+	else if(f2_value.cols() == 1)
+		y = f1_value.array().colwise() * f2_value.col(0).array();
+	else
+		y = f1_value.cwiseProduct(f2_value);
+}
+
+void product_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                           Eigen::Ref<RowMatrixXd> jac) const
+{
+	int const nb_f1_params = f1->nbParameters();
+	int const nb_f2_params = f2->nbParameters();
+	int const nb_params = product_function::nbParameters();
+	int const dimY = parametrization().dimY();
+
+	assert(x.rows() == jac.rows());
+	assert(jac.cols() == nb_params*dimY);
+
+	// Convert the input block to the input space of each function
+	RowMatrixXd xf1_buffer, xf2_buffer;
+	const Eigen::Ref<const RowMatrixXd> xf1 =
+		input_block(x, parametrization().input_parametrization(), *f1, xf1_buffer);
+	const Eigen::Ref<const RowMatrixXd> xf2 =
+		input_block(x, parametrization().input_parametrization(), *f2, xf2_buffer);
+
+	// Value and Jacobian of each function for the given block
+	RowMatrixXd f1_value(x.rows(), f1->parametrization().dimY());
+	RowMatrixXd f2_value(x.rows(), f2->parametrization().dimY());
+	f1->values(xf1, f1_value);
+	f2->values(xf2, f2_value);
+
+	// d(F * f)(x) /dp = F(x) df(x) /dp + f(x) dF(x) / dp
+	jac.setZero();
+
+	RowMatrixXd f_jacobian;
+	if( ! _is_fixed.first)
+	{
+		f_jacobian.resize(x.rows(), nb_f1_params*dimY);
+		f1->parametersJacobians(xf1, f_jacobian);
+		for(int y=0; y<dimY; ++y)
+		{
+			jac.middleCols(y*nb_params, nb_f1_params) =
+				f_jacobian.middleCols(y*nb_f1_params, nb_f1_params).array().colwise()
+				* f2_value.col(f2_value.cols() == 1 ? 0 : y).array();
+		}
+	}
+
+	if( ! _is_fixed.second )
+	{
+		const int start_i = _is_fixed.first ? 0 : nb_f1_params;
+
+		f_jacobian.resize(x.rows(), nb_f2_params*dimY);
+		f2->parametersJacobians(xf2, f_jacobian);
+		for(int y=0; y<dimY; ++y)
+		{
+			jac.middleCols(y*nb_params + start_i, nb_f2_params) =
+				f_jacobian.middleCols(y*nb_f2_params, nb_f2_params).array().colwise()
+				* f1_value.col(f1_value.cols() == 1 ? 0 : y).array();
+		}
+	}
+}
+
 nonlinear_function* product_function::first() const
 {
 	return f1.get();
@@ -59,6 +59,17 @@ class function
 		virtual vec operator()(const vec& x) const { return this->value(x); } ;
 		virtual vec value(const vec& x) const = 0 ;
 
+		//! \brief Evaluate the function at each row of X, a N×dimX block of
+		//! input points, and store the results in the rows of Y, a N×dimY
+		//! block.
+		//!
+		//! \details
+		//! The default implementation calls \a value for each row.  Plugins
+		//! evaluated by the fitters should override it to avoid a virtual
+		//! call and a vector allocation per point.
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
+
 		//! \brief Provide a first rough fit of the function. 
 		//!
 		//! \details
@@ -196,6 +207,17 @@ class nonlinear_function: public function
 		//! dimension first, then parameters.
 		virtual vec parametersJacobian(const vec& x) const = 0;
 
+		//! \brief Obtain the derivatives of the function with respect to the
+		//! parameters at each row of X, a N×dimX block of input points.
+		//!
+		//! \details
+		//! Row n of JAC, a N×(dimY·nbParameters) block provided by the
+		//! caller, receives the Jacobian at the n-th point, ordered as the
+		//! result of \a parametersJacobian.  The default implementation calls
+		//! \a parametersJacobian for each row.
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
+
 		//! \brief default non_linear import. Parse the parameters in order.
 		virtual bool load(std::istream& in);
 
@@ -222,6 +244,10 @@ class compound_function: public nonlinear_function
 		virtual vec operator()(const vec& x) const;
 		virtual vec value(const vec& x) const;
 
+		//! \brief Sum the evaluations of each function on the block X.
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
+
 		//! \brief Access to the i-th function of the compound
 		nonlinear_function* operator[](int i) const;
 
@@ -282,6 +308,8 @@ class compound_function: public nonlinear_function
 		// The result vector should be orderer as res[i + dimY()*j], output
 		// dimension first, then parameters.
 		virtual vec parametersJacobian(const vec& x) const;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 		//! \brief save function specific data. This has no use for ALTA export
 		//! but allows to factorize the code in the C++ or matlab export by
@@ -339,6 +367,8 @@ class product_function : public nonlinear_function
 		//! f2. The input parameter x should be in the parametrization of f1. This
 		//! function will do the conversion before getting f2's value.
 		virtual vec value(const vec& x) const;
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
 
 
 		/* IMPORT/EXPORT FUNCTIONS */
@@ -382,6 +412,8 @@ class product_function : public nonlinear_function
 		//! \brief Obtain the derivatives of the function with respect to the 
 		//! parameters.
 		virtual vec parametersJacobian(const vec& x) const;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 	private: // data
 
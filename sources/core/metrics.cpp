@@ -1,46 +1,58 @@
 #include "metrics.h"
 
+#include <algorithm>
+
 using namespace alta;
 
 void errors::compute(const data* in,   const data* ref,
                      const data* mask, metrics& res) {
 
-   const int size = checkMaskSize(ref, mask);
+   assert(mask == nullptr || ref->size() == mask->size());
 
-   //Here we go new way and faster because we evaluate the function just once
-   Eigen::MatrixXd ref_y = Eigen::MatrixXd::Zero(size, ref->parametrization().dimY());
-   Eigen::MatrixXd inp_y = Eigen::MatrixXd::Zero(size, ref->parametrization().dimY()) ;
+   const auto nX = ref->parametrization().dimX();
+   const auto nY = ref->parametrization().dimY();
 
-#ifdef DEBUG
-   timer  t;
-   t.start();
-#endif
-   evaluate(in, ref, mask, inp_y, ref_y);
-#ifdef DEBUG
-   t.stop();
-   std::cout << "<<INFO>> Evaluate function for all data in  " << t << std::endl;
-   t.reset();
-#endif
+   // Process 'ref' block by block so that it need not be resident in
+   // memory.
+   const int block_size = std::min(ref->block_size(), ref->size());
+   RowMatrixXd ref_xy(block_size, nX + nY);
+   Eigen::MatrixXd ref_y(block_size, nY);
+   Eigen::MatrixXd inp_y(block_size, nY);
 
    // Ouput norms
-   Eigen::VectorXd L1_norm   = Eigen::VectorXd::Zero(ref->parametrization().dimY());
-   Eigen::VectorXd L2_norm   = Eigen::VectorXd::Zero(ref->parametrization().dimY());
-   Eigen::VectorXd L3_norm   = Eigen::VectorXd::Zero(ref->parametrization().dimY());
-   Eigen::VectorXd LInf_norm = Eigen::VectorXd::Zero(ref->parametrization().dimY());
-   Eigen::VectorXd mse       = Eigen::VectorXd::Zero(ref->parametrization().dimY());
-   Eigen::VectorXd rmse      = Eigen::VectorXd::Zero(ref->parametrization().dimY());
+   Eigen::VectorXd L1_norm   = Eigen::VectorXd::Zero(nY);
+   Eigen::VectorXd L2_norm   = Eigen::VectorXd::Zero(nY);
+   Eigen::VectorXd L3_norm   = Eigen::VectorXd::Zero(nY);
+   Eigen::VectorXd LInf_norm = Eigen::VectorXd::Zero(nY);
 
 #ifdef DEBUG
+   timer  t;
    t.start();
 #endif
-   fastNormComputation(inp_y, ref_y,
-                       L1_norm, L2_norm, L3_norm,
-                       LInf_norm, mse, rmse);
+   int size = 0;
+   for(int first = 0; first < ref->size(); first += block_size) {
+      const int rows = std::min(block_size, ref->size() - first);
+      if(rows < ref_xy.rows()) {
+         ref_xy.conservativeResize(rows, Eigen::NoChange);
+      }
+
+      ref->get_block(first, ref_xy);
+      const int count = evaluate(in, ref, mask, first, ref_xy, inp_y, ref_y);
+      accumulateNorms(inp_y, ref_y, count,
+                      L1_norm, L2_norm, L3_norm, LInf_norm);
+      size += count;
+   }
 #ifdef DEBUG
    t.stop();
-   std::cout << "<<INFO>> Fast Norm Computations in  " << t << std::endl;
+   std::cout << "<<INFO>> Evaluate function and norms for all data in  " << t << std::endl;
 #endif
 
+   // Turn the sums into norms and compute the RMSE and MSE
+   Eigen::VectorXd mse  = L2_norm / std::max(size, 1);
+   Eigen::VectorXd rmse = mse.cwiseSqrt();
+   L2_norm = L2_norm.cwiseSqrt();
+   L3_norm = L3_norm.unaryExpr([](double x) { return std::cbrt(x); });
+
    res.clear();
    res["L1"]   = L1_norm;
    res["L2"]   = L2_norm;
@@ -50,75 +62,54 @@ void errors::compute(const data* in,   const data* ref,
    res["RMSE"] = rmse;
 }
 
-int errors::checkMaskSize(const data* ref, const data* mask) {
-
-   if(mask == nullptr) {
-      return ref->size();
-   }
-
-   assert(ref->size() == mask->size());
-
-   // Evaluate the input data at each position of data_x configuration
-   int nb_elems = 0;
-   for(auto i=0; i<ref->size(); i++) {
-      // If the mask value is set to zero, skip the current entry
-      if(mask->get(i).tail(1)[0] == 0.0) {
-         ++nb_elems;
-      }
-   }
-
-   return nb_elems;
-}
-
-
-void errors::evaluate(const data* inp,
-                      const data* ref,
-                      const data* mask,
-                      Eigen::MatrixXd& inp_y,
-                      Eigen::MatrixXd& ref_y) {
-
-   // Temp variables
-   vec ref_xy = vec::Zero(ref->parametrization().dimX() + ref->parametrization().dimY());
-   vec ref_x  = vec::Zero(ref->parametrization().dimX());
-   vec dat_x  = vec::Zero(inp->parametrization().dimX());
-   vec cart   = vec::Zero(6);
+int errors::evaluate(const data* inp,
+                     const data* ref,
+                     const data* mask,
+                     int first,
+                     const RowMatrixXd& ref_xy,
+                     Eigen::MatrixXd& inp_y,
+                     Eigen::MatrixXd& ref_y) {
 
    // Constants
    const auto nY = ref->parametrization().dimY();
    const auto nX = ref->parametrization().dimX();
+   const auto dX = inp->parametrization().dimX();
+   const int  n  = ref_xy.rows();
+
+   // Convert all the abscissae of the block at once, first to cartesian
+   // coordinates to test the hemisphere, then to the `inp' parametrization.
+   RowMatrixXd cart(n, 6), dat_x(n, dX);
+   params::convert(ref_xy.data(),
+                   ref->parametrization().input_parametrization(),
+                   params::CARTESIAN,
+                   cart.data(), n, ref_xy.cols(), 6);
+   params::convert(cart.data(),
+                   params::CARTESIAN,
+                   inp->parametrization().input_parametrization(),
+                   dat_x.data(), n, 6, dX);
+   const auto ref_values = ref_xy.middleCols(nX, nY);
 
    // Is there a mask function to be applied
    const bool has_mask = mask != nullptr;
 
    // Evaluate the input data at each position of data_x configuration
-   for(auto i=0; i<ref->size(); i++) {
+   int count = 0;
+   vec x(dX);
+   for(auto i=0; i<n; i++) {
 
       // If the mask value is set to zero, skip the current entry
-      if(has_mask && mask->get(i).tail(1)[0] == 0.0) {
+      if(has_mask && mask->get(first + i).tail(1)[0] == 0.0) {
          continue;
       }
 
-      ref_xy = ref->get(i);
-      ref_x  = ref_xy.head(nX);
-
-      params::convert(ref_x.data(),
-                      ref->parametrization().input_parametrization(),
-                      params::CARTESIAN,
-                      cart.data());
-
       // Check if the output configuration is below the hemisphere when
       // converted to cartesian coordinates. Note that this prevent from
       // converting BTDF data.
-      if(cart[2] >= 0.0 || cart[5] >= 0.0) {
-
-         // Convert to the query data `dat` parametrization
-         params::convert(cart.data(),
-                         params::CARTESIAN,
-                         inp->parametrization().input_parametrization(),
-                         dat_x.data());
+      if(cart(i, 2) >= 0.0 || cart(i, 5) >= 0.0) {
 
-         ref_y.row(i) = ref_xy.tail(nY);
-         inp_y.row(i) = inp->value(dat_x);
+         x = dat_x.row(i);
+         ref_y.row(count) = ref_values.row(i);
+         inp_y.row(count) = inp->value(x);
          /*
          params::convert(inp->value(dat_x).data(),
                          inp->output_parametrization(),
@@ -128,23 +119,27 @@ void errors::evaluate(const data* inp,
                          inp_y.row(i).data());
          */
       } else {
-         ref_y.row(i).setZero();
-         inp_y.row(i).setZero();
+         ref_y.row(count).setZero();
+         inp_y.row(count).setZero();
       }
+
+      ++count;
    }
+
+   return count;
 }
 
-void errors::fastNormComputation(const Eigen::MatrixXd& o_data_y,
-                                 const Eigen::MatrixXd& f_y,
-                                 Eigen::VectorXd& L1,
-                                 Eigen::VectorXd& L2,
-                                 Eigen::VectorXd& L3,
-                                 Eigen::VectorXd& LInf,
-                                 Eigen::VectorXd& mse,
-                                 Eigen::VectorXd& rmse) {
+void errors::accumulateNorms(const Eigen::MatrixXd& o_data_y,
+                             const Eigen::MatrixXd& f_y,
+                             int rows,
+                             Eigen::VectorXd& L1,
+                             Eigen::VectorXd& L2,
+                             Eigen::VectorXd& L3,
+                             Eigen::VectorXd& LInf) {
    assert(o_data_y.rows() == f_y.rows());
    assert(o_data_y.cols() == f_y.cols());
-   const auto dMatrix = (o_data_y - f_y);
+   const Eigen::ArrayXXd dMatrix =
+      (o_data_y.topRows(rows) - f_y.topRows(rows)).array().abs();
 
    // Check that the output dimensions match in size for all the
    // vectors and the difference matrix.
@@ -154,15 +149,13 @@ void errors::fastNormComputation(const Eigen::MatrixXd& o_data_y,
    assert(L3.size()   == ncols);
    assert(LInf.size() == ncols);
 
-   // Compute the different distance metrics per output dimension
+   // Accumulate the different distance metrics per output dimension
    for(auto i=0; i<ncols; i++) {
-      L1(i)   = dMatrix.col(i).lpNorm<1>();
-      L2(i)   = dMatrix.col(i).lpNorm<2>();
-      L3(i)   = dMatrix.col(i).lpNorm<3>();
-      LInf(i) = dMatrix.col(i).lpNorm<Eigen::Infinity>();
+      L1(i)  += dMatrix.col(i).sum();
+      L2(i)  += dMatrix.col(i).square().sum();
+      L3(i)  += dMatrix.col(i).cube().sum();
+      if(rows > 0) {
+         LInf(i) = std::max(LInf(i), dMatrix.col(i).maxCoeff());
+      }
    }
-
-   // Compute the RMSE and MSE
-   mse  = dMatrix.array().square().colwise().sum() / o_data_y.rows();
-   rmse = mse.cwiseSqrt();
 }
@@ -53,27 +53,26 @@ class errors {
 
    private:
 
-      /* Return the number of non-zero elements in the 'mask' data object.
+      /* Evaluate the interpolated data 'in' at the abscissas of the rows
+       * [first, first + ref_xy.rows()) of 'ref', whose coordinates are
+       * given in 'ref_xy'. Rows for which 'mask' is zero are skipped, the
+       * others fill the first rows of 'in_y' and 'ref_y'. Return the number
+       * of rows filled.
        */
-      static int checkMaskSize(const data* ref, const data* mask);
+      static int evaluate(const data* in, const data* ref, const data* mask,
+                          int first, const RowMatrixXd& ref_xy,
+                          Eigen::MatrixXd& in_y, Eigen::MatrixXd& ref_y);
 
-      /* Evaluate the output Eigen matrices containing the evaluation of the
-       * interpolated data 'in' with respect to 'ref' abscissas.
+      /* Accumulate the per-dimension sums needed for the Lp norms of the
+       * difference between the first 'rows' rows of 'in' and 'ref': sum of
+       * absolute values, of squares and of cubes, and maximum.
        */
-      static void evaluate(const data* in, const data* ref, const data* mask,
-                           Eigen::MatrixXd& in_y, Eigen::MatrixXd& ref_y);
-
-      /* Use Eigen Norm computation to compute efficiently a bunch of metrics
-       * such a Lp norm, MSE and RMSE. The \a evaluate method needs to be used
-       * to evaluate the 'in' and 'ref' arguments.
-       */
-      static void fastNormComputation(const Eigen::MatrixXd& in,
-                                      const Eigen::MatrixXd& ref,
-                                      Eigen::VectorXd& L1,
-                                      Eigen::VectorXd& L2,
-                                      Eigen::VectorXd& L3,
-                                      Eigen::VectorXd& LInf,
-                                      Eigen::VectorXd& mse,
-                                      Eigen::VectorXd& rmse);
+      static void accumulateNorms(const Eigen::MatrixXd& in,
+                                  const Eigen::MatrixXd& ref,
+                                  int rows,
+                                  Eigen::VectorXd& L1,
+                                  Eigen::VectorXd& L2,
+                                  Eigen::VectorXd& L3,
+                                  Eigen::VectorXd& LInf);
 };
 }
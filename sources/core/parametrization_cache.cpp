@@ -0,0 +1,51 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#include "parametrization_cache.h"
+
+#include <algorithm>
+
+using namespace alta;
+
+parametrization_cache::parametrization_cache(const data& d,
+                                             const parameters& target,
+                                             bool with_cosine)
+    : _abscissae(RowMatrixXd::Zero(d.size(), target.dimX())),
+      _cosines(vec::Ones(d.size()))
+{
+    const params::input in = d.parametrization().input_parametrization();
+    const params::input out = target.input_parametrization();
+    const int dimX = std::min(d.parametrization().dimX(), target.dimX());
+
+    for_each_block(d, [&](int first, const RowMatrixXd& block)
+    {
+        auto x = _abscissae.middleRows(first, block.rows());
+
+        // Unknown parametrizations cannot be converted: copy the abscissae
+        // as is when the parametrizations match.
+        if(in == out)
+        {
+            x.leftCols(dimX) = block.leftCols(dimX);
+        }
+        else
+        {
+            params::convert(block.data(), in, out, x.data(), block.rows(),
+                            block.cols(), x.cols());
+        }
+
+        if(with_cosine)
+        {
+            RowMatrixXd cart(block.rows(), 6);
+            params::convert(block.data(), in, params::CARTESIAN, cart.data(),
+                            block.rows(), block.cols(), 6);
+            _cosines.segment(first, block.rows()) = cart.col(5);
+        }
+    });
+}
@@ -0,0 +1,59 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#pragma once
+
+#include "common.h"
+#include "data.h"
+#include "params.h"
+
+namespace alta {
+
+/*! \ingroup core
+ *  \brief The abscissae of a data object, converted once to the input
+ *  parametrization of a function.
+ *
+ *  \details
+ *  Fitters evaluate the function at the same abscissae at each iteration.
+ *  This class stores the result of \a params::convert from the input
+ *  parametrization of the data to that of the function, and optionally the
+ *  cosine factor of each sample (the elevation cosine of the outgoing
+ *  direction, used by <strong>\-\-fit-with-cosine</strong>), so that
+ *  conversions are done once per fit instead of once per iteration.
+ *
+ *  Row i of \a abscissae and element i of \a cosines correspond to the i-th
+ *  sample of the data.  Note that the converted abscissae are resident in
+ *  memory, even for data that is not.
+ */
+class parametrization_cache
+{
+  public: // methods
+
+    //! \brief Convert the abscissae of D to the input parametrization of
+    //! TARGET.  When WITH_COSINE is false, all the cosine factors are one.
+    parametrization_cache(const data& d, const parameters& target,
+                          bool with_cosine = false);
+
+    //! \brief Return the converted abscissae, a size()×dimX matrix where
+    //! dimX is the input dimension of the target parametrization.
+    const RowMatrixXd& abscissae() const { return _abscissae; }
+
+    //! \brief Return the cosine factor of each sample.
+    const vec& cosines() const { return _cosines; }
+
+    //! \brief Return the number of samples.
+    int size() const { return _abscissae.rows(); }
+
+  private: // data
+
+    RowMatrixXd _abscissae;
+    vec _cosines;
+};
+}
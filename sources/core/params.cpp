@@ -12,6 +12,7 @@
 #include "params.h"
 #include "common.h"
 #include <cassert>
+#include <algorithm>
 
 using namespace alta;
 
@@ -736,6 +737,290 @@ void params::from_cartesian(const double* invec, params::input outtype,
 			break;
 	}
 }
+
+/* Batch conversions.  The loops below are the same as the point-wise
+ * conversions, with the dispatch on the parametrization hoisted out of
+ * them. */
+
+// Closed-form version of 'half_to_cartesian' that avoids building rotation
+// matrices.
+static inline void rusin_to_cartesian(double theta_h, double phi_h,
+                                      double theta_d, double phi_d,
+                                      double* out)
+{
+	const double sth = sin(theta_h), cth = cos(theta_h);
+	const double sph = sin(phi_h),   cph = cos(phi_h);
+	const double s_td = sin(theta_d), ctd = cos(theta_d);
+
+	const double half[3] = { sth*cph, sth*sph, cth };
+
+	// Diff vector rotated around the binormal by theta_h, then around the
+	// normal by phi_h.
+	const double dx = s_td*cos(phi_d), dy = s_td*sin(phi_d), dz = ctd;
+	const double rx = cth*dx + sth*dz;
+	const double rz = cth*dz - sth*dx;
+	out[0] = cph*rx - sph*dy;
+	out[1] = sph*rx + cph*dy;
+	out[2] = rz;
+
+	const double dot = out[0]*half[0] + out[1]*half[1] + out[2]*half[2];
+	out[3] = -out[0] + 2.0*dot * half[0];
+	out[4] = -out[1] + 2.0*dot * half[1];
+	out[5] = -out[2] + 2.0*dot * half[2];
+}
+
+// Store in HALF the normalized half vector of the CARTESIAN point IN, as
+// 'half_vector' does.
+static inline void half_of(const double* in, double* half)
+{
+	half[0] = in[0] + in[3];
+	half[1] = in[1] + in[4];
+	half[2] = in[2] + in[5];
+	const double sqnorm = half[0]*half[0] + half[1]*half[1] + half[2]*half[2];
+
+	if(sqnorm <= 0.)
+	{
+		half[0] = 0.0;
+		half[1] = 0.0;
+		half[2] = 1.0;
+	}
+	else
+	{
+		const double inv = 1.0 / sqrt(sqnorm);
+		half[0] *= inv;
+		half[1] *= inv;
+		half[2] *= inv;
+	}
+}
+
+// Store in DIFF the first vector of the CARTESIAN point IN expressed in the
+// frame of the half vector HALF, as done by 'from_cartesian' for the Rusinkiewicz
+// parametrizations, but without building rotation matrices.
+static inline void diff_of(const double* in, const double* half, double* diff)
+{
+	const double sth = sqrt(half[0]*half[0] + half[1]*half[1]);
+	const double cth = half[2];
+	const double cph = sth > 0. ? half[0] / sth : 1.0;
+	const double sph = sth > 0. ? half[1] / sth : 0.0;
+
+	const double x =  cph*in[0] + sph*in[1];
+	const double y = -sph*in[0] + cph*in[1];
+	diff[0] = cth*x - sth*in[2];
+	diff[1] = y;
+	diff[2] = sth*x + cth*in[2];
+}
+
+void params::to_cartesian(const double* invec, params::input intype,
+                          double* outvec, int n, int instride, int outstride)
+{
+	switch(intype)
+	{
+		case params::COS_TH:
+			for(int i=0; i<n; ++i)
+			{
+				rusin_to_cartesian(acos(invec[i*instride]), 0.0, 0.0, 0.0,
+				                   outvec + i*outstride);
+			}
+			break;
+		case params::RUSIN_TH_TD:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				rusin_to_cartesian(in[0], 0.0, in[1], 0.5*M_PI, outvec + i*outstride);
+			}
+			break;
+		case params::RUSIN_TH_PH_TD:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				rusin_to_cartesian(in[0], in[1], in[2], 0.0, outvec + i*outstride);
+			}
+			break;
+		case params::RUSIN_TH_TD_PD:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				rusin_to_cartesian(in[0], 0.0, in[1], in[2], outvec + i*outstride);
+			}
+			break;
+		case params::RUSIN_TH_PH_TD_PD:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				rusin_to_cartesian(in[0], in[1], in[2], in[3], outvec + i*outstride);
+			}
+			break;
+		case params::ISOTROPIC_TV_TL_DPHI:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				double* out = outvec + i*outstride;
+				out[0] = sin(in[0]);
+				out[1] = 0.0;
+				out[2] = cos(in[0]);
+				out[3] = cos(in[2])*sin(in[1]);
+				out[4] = sin(in[2])*sin(in[1]);
+				out[5] = cos(in[1]);
+			}
+			break;
+		case params::SPHERICAL_TL_PL_TV_PV:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				double* out = outvec + i*outstride;
+				out[0] = cos(in[3])*sin(in[2]);
+				out[1] = sin(in[3])*sin(in[2]);
+				out[2] = cos(in[2]);
+				out[3] = cos(in[1])*sin(in[0]);
+				out[4] = sin(in[1])*sin(in[0]);
+				out[5] = cos(in[0]);
+			}
+			break;
+		case params::CARTESIAN:
+			for(int i=0; i<n; ++i)
+			{
+				memcpy(outvec + i*outstride, invec + i*instride, 6*sizeof(double));
+			}
+			break;
+		default:
+			for(int i=0; i<n; ++i)
+			{
+				to_cartesian(invec + i*instride, intype, outvec + i*outstride);
+			}
+			break;
+	}
+}
+
+void params::from_cartesian(const double* invec, params::input outtype,
+                            double* outvec, int n, int instride, int outstride)
+{
+	switch(outtype)
+	{
+		case params::COS_TH:
+			for(int i=0; i<n; ++i)
+			{
+				double half[3];
+				half_of(invec + i*instride, half);
+				outvec[i*outstride] = half[2];
+			}
+			break;
+		case params::COS_TLV:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				outvec[i*outstride] = in[0]*in[3] + in[1]*in[4] + in[2]*in[5];
+			}
+			break;
+		case params::RUSIN_VH:
+			for(int i=0; i<n; ++i)
+			{
+				half_of(invec + i*instride, outvec + i*outstride);
+			}
+			break;
+		case params::RUSIN_TH_TD_PD:
+			for(int i=0; i<n; ++i)
+			{
+				double half[3], diff[3];
+				double* out = outvec + i*outstride;
+				half_of(invec + i*instride, half);
+				diff_of(invec + i*instride, half, diff);
+				out[0] = acos(half[2]);
+				out[1] = acos(diff[2]);
+				out[2] = alongside_z(diff) ? 0.0 : atan2(diff[1], diff[0]);
+			}
+			break;
+		case params::RUSIN_TH_PH_TD_PD:
+			for(int i=0; i<n; ++i)
+			{
+				double half[3], diff[3];
+				double* out = outvec + i*outstride;
+				half_of(invec + i*instride, half);
+				diff_of(invec + i*instride, half, diff);
+				out[0] = acos(half[2]);
+				out[1] = atan2(half[1], half[0]);
+				if(alongside_z(diff))
+				{
+					out[2] = 0.0;
+					out[3] = 0.0;
+				}
+				else
+				{
+					out[2] = acos(diff[2]);
+					out[3] = atan2(diff[1], diff[0]);
+				}
+			}
+			break;
+		case params::ISOTROPIC_TV_TL_DPHI:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				double* out = outvec + i*outstride;
+				out[0] = acos(in[2]);
+				out[1] = acos(in[5]);
+				out[2] = atan2(in[4], in[3]) - atan2(in[1], in[0]);
+			}
+			break;
+		case params::SPHERICAL_TL_PL_TV_PV:
+			for(int i=0; i<n; ++i)
+			{
+				const double* in = invec + i*instride;
+				double* out = outvec + i*outstride;
+				out[0] = acos(in[5]);
+				out[1] = atan2(in[4], in[3]);
+				out[2] = acos(in[2]);
+				out[3] = atan2(in[1], in[0]);
+			}
+			break;
+		case params::CARTESIAN:
+			for(int i=0; i<n; ++i)
+			{
+				memcpy(outvec + i*outstride, invec + i*instride, 6*sizeof(double));
+			}
+			break;
+		default:
+			for(int i=0; i<n; ++i)
+			{
+				from_cartesian(invec + i*instride, outtype, outvec + i*outstride);
+			}
+			break;
+	}
+}
+
+void params::convert(const double* invec, params::input intype,
+                     params::input outtype, double* outvec,
+                     int n, int instride, int outstride)
+{
+	if(intype == outtype)
+	{
+		const int dim = dimension(outtype);
+		for(int i=0; i<n; ++i)
+		{
+			for(int j=0; j<dim; ++j) { outvec[i*outstride + j] = invec[i*instride + j]; }
+		}
+	}
+	else if(intype == params::CARTESIAN)
+	{
+		from_cartesian(invec, outtype, outvec, n, instride, outstride);
+	}
+	else if(outtype == params::CARTESIAN)
+	{
+		to_cartesian(invec, intype, outvec, n, instride, outstride);
+	}
+	else
+	{
+		// Go through the CARTESIAN parametrization by chunks small enough to
+		// remain in cache.
+		static const int chunk = 256;
+		double temp[chunk*6];
+		for(int first=0; first<n; first+=chunk)
+		{
+			const int count = std::min(chunk, n - first);
+			to_cartesian(invec + first*instride, intype, temp, count, instride, 6);
+			from_cartesian(temp, outtype, outvec + first*outstride, count, 6, outstride);
+		}
+	}
+}
+
 params::input params::parse_input(const std::string& txt)
 {
 
@@ -288,6 +288,31 @@ class params
         static void from_cartesian(const double* invec, params::input outtype,
                                    double* outvec);
 
+        //! \brief Convert N points from the INTYPE to the OUTTYPE
+        //! parametrization.  The i-th point is read at INVEC + i*INSTRIDE
+        //! and written at OUTVEC + i*OUTSTRIDE, so that columns of
+        //! row-major blocks can be converted directly.
+        //!
+        //! \details
+        //! The parametrizations are dispatched once for the whole batch
+        //! instead of once per point, and the common parametrizations have
+        //! dedicated loops.  Points that need to go through the CARTESIAN
+        //! parametrization are converted by chunks.  INVEC and OUTVEC must
+        //! not overlap.
+        static void convert(const double* invec, params::input intype,
+                            params::input outtype, double* outvec,
+                            int n, int instride, int outstride);
+
+        //! \brief Batch version of \a to_cartesian, see \a convert.
+        static void to_cartesian(const double* invec, params::input intype,
+                                 double* outvec,
+                                 int n, int instride, int outstride);
+
+        //! \brief Batch version of \a from_cartesian, see \a convert.
+        static void from_cartesian(const double* invec, params::input outtype,
+                                   double* outvec,
+                                   int n, int instride, int outstride);
+
         //! \brief provide a dimension associated with a parametrization
         static int  dimension(params::input t);
 
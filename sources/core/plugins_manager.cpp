@@ -12,6 +12,7 @@
 #include "plugins_manager.h"
 #include "rational_function.h"
 #include "data_storage.h"
+#include "streaming_data.h"
 
 #ifdef _WIN32
     #include <windows.h>
@@ -473,25 +474,36 @@ ptr<data> plugins_manager::get_data(const std::string& n, size_t size,
     }
 }
 
+// Load a 'vertical_segment' whose header HEADER has already been read from
+// INPUT.
+static ptr<data> load_vertical_segment(std::istream& input,
+                                       const arguments& header,
+                                       const arguments& args)
+{
+    if(!header.is_defined("FORMAT")) {
+        std::cerr << "<<DEBUG>> The file format is undefined, assuming TEXT"
+                  << std::endl;
+    }
+
+    if (header["FORMAT"] == "binary") {
+        return ptr<data>(load_data_from_binary(input, header));
+    } else {
+        return ptr<data>(load_data_from_text(input, header, args));
+    }
+}
+
 ptr<data> plugins_manager::load_data(const std::string& type, std::istream& input,
                                      const arguments& args)
 {
     ptr<data> result;
 
-    if (type.empty() || type == "vertical_segment")
+    // Note: A stream cannot be read on demand, so 'streaming_data' is
+    // loaded in memory here.
+    if (type.empty() || type == "vertical_segment"
+        || type == "streaming_data")
     {
         auto header = arguments::parse_header(input);
-
-        if(!header.is_defined("FORMAT")) {
-            std::cerr << "<<DEBUG>> The file format is undefined, assuming TEXT"
-                      << std::endl;
-        }
-
-        if (header["FORMAT"] == "binary") {
-            result = ptr<data>(load_data_from_binary(input, header));
-        } else {
-            result = ptr<data>(load_data_from_text(input, header, args));
-        }
+        result = load_vertical_segment(input, header, args);
     }
     else
     {
@@ -522,7 +534,37 @@ ptr<data> plugins_manager::load_data(const std::string& file,
     stream.exceptions(std::ios::failbit);
     stream.open(file.c_str(), std::ifstream::binary);
     stream.exceptions(std::ios::goodbit);
-    ptr<data> result = load_data(type, stream, n_args);
+
+    ptr<data> result;
+    if (type == "streaming_data")
+    {
+        // Only the binary format can be read without parsing the whole
+        // file.
+        auto header = arguments::parse_header(stream);
+        if (header["FORMAT"] == "binary")
+            result = ptr<data>(new streaming_data(file,
+                                                  args.get_int("data-window",
+                                                               65536)));
+        else
+        {
+            std::cerr << "<<WARNING>> '" << file << "' is not a binary file, "
+                      << "loading it in memory" << std::endl;
+            result = load_vertical_segment(stream, header, n_args);
+        }
+    }
+    else if (type.empty() || type == "vertical_segment")
+    {
+        // Binary files can be mapped in memory instead of being read.
+        auto header = arguments::parse_header(stream);
+        if (header["FORMAT"] == "binary")
+            result = ptr<data>(load_data_from_mapped_binary(file, header,
+                                                            stream.tellg()));
+        if (!result)
+            result = load_vertical_segment(stream, header, n_args);
+    }
+    else
+        result = load_data(type, stream, n_args);
+
     stream.close();                          // FIXME: make it auto-close
 
     return result;
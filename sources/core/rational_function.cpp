@@ -17,20 +17,27 @@
 #include <limits>
 #include <algorithm>
 #include <cmath>
+#include <map>
+#include <numeric>
+#include <atomic>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace alta;
 
 rational_function_1d::rational_function_1d(const parameters& params,
                                            unsigned int np, unsigned int nq,
                                            bool separable)
-    : function(params), _separable(separable)
+    : function(params), _max_degree(0), _horner_degree(-1), _separable(separable)
 {
     resize(np, nq);
 }
 
 rational_function_1d::rational_function_1d(int nX, unsigned int np, unsigned int nq, 
                                            bool separable):
-    function(parameters(nX, 1, params::UNKNOWN_INPUT, params::UNKNOWN_OUTPUT))
+    function(parameters(nX, 1, params::UNKNOWN_INPUT, params::UNKNOWN_OUTPUT)),
+    _max_degree(0), _horner_degree(-1)
 {
 	resize(np, nq);
 	_separable = separable;
@@ -183,12 +190,7 @@ void rational_function_1d::update(const vec& in_a,
   const unsigned int nq = in_b.size();
 
 	// Resize the coefficient vector if they do not match
-	if(np != _p_coeffs.size()) {
-		_p_coeffs.resize(np);
-	}
-	if(nq != _q_coeffs.size()) {
-		_q_coeffs.resize(nq);
-	}
+	resize(np, nq);
 
 #define NORMALIZE
 
@@ -207,6 +209,8 @@ void rational_function_1d::update(const vec& in_a,
 	{
 		_q_coeffs[k].a = in_b[k] / b0;
 	}
+
+	update_horner();
 }
 		
 void rational_function_1d::update(const rational_function_1d* r)
@@ -226,6 +230,90 @@ void rational_function_1d::update(const rational_function_1d* r)
 		_q_coeffs[k].a = r->_q_coeffs[k].a;
 	}
 
+	update_horner();
+
+}
+
+// Append to LAYOUT the indices of the basis functions of the polynomials in
+// the dimensions [0, D] of total degree up to T, the degrees of the
+// dimensions above D being already set in DEG, in the order read by
+// 'horner'. INDEX maps a vector of degree to its basis function.
+static void horner_layout(const std::map<std::vector<int>, int>& index,
+                          std::vector<int>& deg, int d, int T,
+                          std::vector<int>& layout)
+{
+	for(int e=T; e>=0; --e)
+	{
+		deg[d] = e;
+		if(d == 0)
+		{
+			const auto it = index.find(deg);
+			layout.push_back(it != index.end() ? it->second : -1);
+		}
+		else
+		{
+			horner_layout(index, deg, d-1, T-e, layout);
+		}
+	}
+	deg[d] = 0;
+}
+
+// Evaluate at X the polynomial in D variables of total degree up to T whose
+// coefficients are read from C, in the order of 'horner_layout', as
+// x_{D-1} (.. (x_{D-1} c_T + c_{T-1}) ..) + c_0, where c_e is the
+// polynomial in the D-1 first variables of total degree up to T-e.
+template<int D>
+static inline double horner(const double*& c, const double* x, int T)
+{
+	double res = horner<D-1>(c, x, 0);
+	for(int e=T-1; e>=0; --e)
+	{
+		res = res*x[D-1] + horner<D-1>(c, x, T-e);
+	}
+	return res;
+}
+
+template<>
+inline double horner<1>(const double*& c, const double* x, int T)
+{
+	double res = *c++;
+	for(int e=T-1; e>=0; --e)
+	{
+		res = res*x[0] + *c++;
+	}
+	return res;
+}
+
+// Evaluate the rational function in D dimensions whose coefficients are
+// laid out for 'horner' at X.
+template<int D>
+static inline double horner_value(const vec& x, const vec& min, const vec& max,
+                                  const double* p, const double* q, int T)
+{
+	double xp[D];
+	for(int k=0; k<D; ++k)
+	{
+		xp[k] = 2.0*((x[k] - min[k]) / (max[k]-min[k]) - 0.5);
+	}
+
+	return horner<D>(p, xp, T) / horner<D>(q, xp, T);
+}
+
+void rational_function_1d::update_horner()
+{
+	_horner_p.clear();
+	_horner_q.clear();
+	if(_horner_index.empty() || !monomial_basis()) { return; }
+
+	const int np = _p_coeffs.size(), nq = _q_coeffs.size();
+	_horner_p.assign(_horner_index.size(), 0.0);
+	_horner_q.assign(_horner_index.size(), 0.0);
+	for(unsigned int k=0; k<_horner_index.size(); ++k)
+	{
+		const int i = _horner_index[k];
+		if(i >= 0 && i < np) { _horner_p[k] = _p_coeffs[i].a; }
+		if(i >= 0 && i < nq) { _horner_q[k] = _q_coeffs[i].a; }
+	}
 }
 
 void rational_function_1d::resize(unsigned int np, unsigned int nq)
@@ -235,14 +323,54 @@ void rational_function_1d::resize(unsigned int np, unsigned int nq)
 	// happen at the creation of the rational function object.
 	if(_parameters.dimX() == 0) { return; }
 
+	// Compute the degree table once for both the numerator and the
+	// denominator
+	if(_degrees.size() != std::max(np, nq))
+	{
+		_degrees = degree_table(_parameters.dimX(), std::max(np, nq));
+
+		_max_degree = 0;
+		for(const std::vector<int>& deg : _degrees)
+		{
+			_max_degree = std::max(_max_degree,
+			                       *std::max_element(deg.begin(), deg.end()));
+		}
+
+		// Layout of the coefficients for the Horner evaluation, for the
+		// dimensions that have a specialized evaluator
+		_horner_index.clear();
+		_horner_degree = -1;
+		const int nX = _parameters.dimX();
+		if(nX <= 3 && !_degrees.empty())
+		{
+			const std::vector<int>& last = _degrees.back();
+			_horner_degree = std::accumulate(last.begin(), last.end(), 0);
+
+			std::map<std::vector<int>, int> index;
+			for(unsigned int i=0; i<_degrees.size(); ++i)
+			{
+				index[_degrees[i]] = i;
+			}
+
+			std::vector<int> deg(nX, 0);
+			horner_layout(index, deg, nX-1, _horner_degree, _horner_index);
+		}
+	}
+
+	// The coefficients must be set again by 'update'
+	if(_p_coeffs.size() != np || _q_coeffs.size() != nq)
+	{
+		_horner_p.clear();
+		_horner_q.clear();
+	}
+
 	// Resize the numerator
 	if(_p_coeffs.size() != np)
 	{
 		_p_coeffs.resize(np);
 		for(unsigned int k=0; k<np; ++k)
 		{
-			std::vector<int> deg = index2degree(k);
-			_p_coeffs[k].deg = deg;
+			_p_coeffs[k].deg = _degrees[k];
 		}
 	}
 
@@ -252,8 +380,7 @@ void rational_function_1d::resize(unsigned int np, unsigned int nq)
 		_q_coeffs.resize(nq);
 		for(unsigned int k=0; k<nq; ++k)
 		{
-			std::vector<int> deg = index2degree(k);
-			_q_coeffs[k].deg = deg;
+			_q_coeffs[k].deg = _degrees[k];
 		}
 	}
 }
@@ -263,169 +390,66 @@ void rational_function_1d::resize(unsigned int np, unsigned int nq)
 // Get the p_i and q_j function
 vec rational_function_1d::p(const vec& x) const
 {
-	vec res(1) ;
-
-	const unsigned int np = _p_coeffs.size() ;
-	for(unsigned int i=0; i<np; ++i)
-	{
-		res[0] += _p_coeffs[i].a * this->p(x, i) ;
-	}
+	vec pi(_p_coeffs.size()), qi(_q_coeffs.size());
+	basis(x, pi, qi);
 
+	vec res(1) ;
+	res[0] = getP().dot(pi);
 	return res ;
 }
 vec rational_function_1d::q(const vec& x) const 
 {
+	vec pi(_p_coeffs.size()), qi(_q_coeffs.size());
+	basis(x, pi, qi);
+
 	vec res(1) ;
+	res[0] = getQ().dot(qi);
+	return res ;
+}
 
-	const unsigned int np = _q_coeffs.size() ;
-	for(unsigned int i=0; i<np; ++i)
+// Append to TABLE the vectors of degree whose sum is REMAINING over the
+// dimensions [0, D], the dimensions above D being already set in DEG, until
+// TABLE holds N vectors. Higher dimensions vary slowest, by increasing
+// degree.
+static void append_degrees(std::vector<std::vector<int> >& table,
+                           std::vector<int>& deg, int d, int remaining, int n)
+{
+	if(d == 0)
 	{
-		res[0] += _q_coeffs[i].a * this->q(x, i) ;
+		deg[0] = remaining;
+		table.push_back(deg);
+		return;
 	}
 
-	return res ;
-}
-
-// Estimate the number of configuration for an indice vector of dimension
-// d with maximum element value being k. This function is heavy to call and
-// should be use lightely. I did the maximum I could to unroll the dimension
-// loop.
-int rational_function_1d::estimate_dk(int k, int d)
-{
-	// For dim = 1, only one configuration is possible and only one 
-	// configuration with zeroth powers remains
-	if (d == 1 || k == 0) {
-		return 1;
-
-	// If only one power is available, there is dim configurations
-	} else if (k == 1) {
-		return d;
-
-/*  // This one is not working. I need to redo the maths here.
-
-	// If max power is two, then there is d^2 configuration minus the
-	// number of symmetric configurations: d(d+1)/2.
-	} else if (k == 2) {
-		return (d*(d-1))/2;
-*/
-
-	// For dim = 2, configuration are [k-i, i], i \in [0,k]
-	} else if (d == 2) {
-		return k+1;
-
-	// For dim = 3, we need to list all the possible cases for the first
-	// dimension equals to i \in [0,k] and the remaining dimensions
-	// sharing the k-i remaining elements.
-	} else if (d == 3) {
-		const int k2 = k+1;
-		return k2*k2 - (k2*k)/2;
-
-	} else {
-		int res = 0;
-		for(int i=0; i<=k; ++i)	{
-			res += estimate_dk(k-i, d-1);
-		}
-		return res;
+	for(int k=0; k<=remaining && int(table.size())<n; ++k)
+	{
+		deg[d] = k;
+		append_degrees(table, deg, d-1, remaining-k, n);
 	}
 }
 
-// Populate a vector of degrees of dimension N using a
-// maximum degree of M. The index at the current level
-// is j
-void rational_function_1d::populate(std::vector<int>& vec, int N, int M, int j)
+std::vector<std::vector<int> > rational_function_1d::degree_table(int dimX, int n)
 {
-	// For each dimension, estimate the current level
-	// based on the number of configurations in the
-	// other dimensions
-	int current_M = M ;
-	int nb_conf = 0;
-	for(int d=0; d<N-1; ++d)
+	// Enumerate the vectors of degree by increasing total degree
+	std::vector<std::vector<int> > table;
+	table.reserve(n);
+	for(int total=0; int(table.size())<n; ++total)
 	{
-		int k;
-		for(k=0; k<=current_M; ++k)
-		{
-			int oracle = estimate_dk(current_M-k, N-(d+1));
-			if(nb_conf <= j && j < nb_conf+oracle)
-			{
-				break;
-			}
-			nb_conf += oracle;
-		}
-
-		vec[N-1 - d] = k ;	
-		current_M -= k ;
+		std::vector<int> deg(dimX, 0);
+		append_degrees(table, deg, dimX-1, total, n);
 	}
-	vec[0] = current_M;
+
+	return table;
 }
 
 std::vector<int> rational_function_1d::index2degree(int i) const
 {
-	std::vector<int> deg ; deg.assign(_parameters.dimX(), 0) ;
-
-	if(i == 0)
-		return deg ;
-	
-	// The case of one dimensional signals is trivial
-	if(_parameters.dimX() == 1)
-	{
-		deg[0] = i;
-		return deg;
-	}
-#ifdef NOT_WORKING
-	// Case of two or more dimension signal, we differ the treatment of
-	// separable signals and non separable signals.
-	if(_separable)
+	if(i < int(_degrees.size()))
 	{
-		const int index = i-1;
-		const int base  = index / _parameters.dimX() + 1;
-		for(int k=0; k<_parameters.dimX(); ++k)
-		{
-			deg[k] = (index % _parameters.dimX() == k) ? base : 0;
-		}
-	}
-	else
-#endif
-	{
-		if(_parameters.dimX() == 2)
-		{
-			int Nk = 1 ;
-			int k  = 1 ;
-			while(!(i >= Nk && i < Nk+k+1))
-			{
-				Nk += k+1 ;
-				++k ;
-			}
-
-			int r = i-Nk ;
-			deg[0] = k-r;
-			deg[1] = r;
-		}
-		else
-		{
-			int Nk = 1 ;
-			int k  = 1 ;
-			int dk = estimate_dk(k, _parameters.dimX()) ;
-			while(!(i >= Nk && i < Nk+dk))
-			{
-				Nk += dk ;
-				++k ;
-				dk = estimate_dk(k, _parameters.dimX()) ;
-			}
-
-			// Populate the vector from front to back
-			int j = i-Nk ;
-			populate(deg, _parameters.dimX(), k, j) ;
-		}
-	}
-
-#ifdef CORE_DEBUG
-	for(int k=0; k<deg.size(); ++k) {
-		std::cout << deg[k] << ", ";
+		return _degrees[i];
 	}
-	std::cout << std::endl;
-#endif
-	return deg ;
 
+	return degree_table(_parameters.dimX(), i+1)[i];
 }
 
 // Get the p_i and q_j function
@@ -452,27 +476,139 @@ double rational_function_1d::q(const vec& x, int i) const
 	return res ;
 }
 
+void rational_function_1d::basis_table(double x, vecref t) const
+{
+	t[0] = 1.0;
+	for(int e=1; e<t.size(); ++e)
+	{
+		t[e] = t[e-1] * x;
+	}
+}
+
+void rational_function_1d::tabulated_basis(const double* x, Eigen::Ref<Eigen::MatrixXd> table,
+                                           double* p, int np, double* q, int nq) const
+{
+	// Table of the polynomials of each normalized coordinate
+	const int nX = _parameters.dimX();
+	for(int k=0; k<nX; ++k)
+	{
+		const double xp = 2.0*((x[k] - _min[k]) / (_max[k]-_min[k]) - 0.5);
+		basis_table(xp, table.col(k));
+	}
+
+	for(int i=0; i<np; ++i)
+	{
+		double res = 1.0;
+		for(int k=0; k<nX; ++k) { res *= table(_degrees[i][k], k); }
+		p[i] = res;
+	}
+
+	for(int i=0; i<nq; ++i)
+	{
+		double res = 1.0;
+		for(int k=0; k<nX; ++k) { res *= table(_degrees[i][k], k); }
+		q[i] = res;
+	}
+}
+
+// Number of doubles of the buffers that 'basis' and 'value' keep on the
+// stack. Larger buffers are allocated on the heap.
+static const int stack_buffer_size = 256;
+
+void rational_function_1d::basis(const vec& x, vecref p, vecref q) const
+{
+	assert(p.size() == int(_p_coeffs.size()));
+	assert(q.size() == int(_q_coeffs.size()));
+
+	const int rows = _max_degree+1, cols = _parameters.dimX();
+	double buffer[stack_buffer_size];
+	Eigen::MatrixXd heap;
+	double* storage = buffer;
+	if(rows*cols > stack_buffer_size)
+	{
+		heap.resize(rows, cols);
+		storage = heap.data();
+	}
+
+	Eigen::Map<Eigen::MatrixXd> table(storage, rows, cols);
+	tabulated_basis(x.data(), table, p.data(), p.size(), q.data(), q.size());
+}
+
+void rational_function_1d::bases(const Eigen::Ref<const RowMatrixXd>& x,
+                                 Eigen::Ref<RowMatrixXd> p,
+                                 Eigen::Ref<RowMatrixXd> q) const
+{
+	assert(x.cols() >= _parameters.dimX());
+	assert(p.rows() == x.rows() && p.cols() == int(_p_coeffs.size()));
+	assert(q.rows() == x.rows() && q.cols() == int(_q_coeffs.size()));
+
+	Eigen::MatrixXd table(_max_degree+1, _parameters.dimX());
+	for(int i=0; i<x.rows(); ++i)
+	{
+		tabulated_basis(x.row(i).data(), table,
+		                p.row(i).data(), p.cols(), q.row(i).data(), q.cols());
+	}
+}
+
+void rational_function_1d::basis_from_indices(const vec& x, vecref p, vecref q) const
+{
+	for(int i=0; i<p.size(); ++i) { p[i] = this->p(x, i); }
+	for(int i=0; i<q.size(); ++i) { q[i] = this->q(x, i); }
+}
+
 // Overload the function operator
 vec rational_function_1d::value(const vec& x) const 
 {
-	vec res(1) ;
+	// Use the evaluator specialized for the dimension, if any
+	if(!_horner_p.empty())
+	{
+		const double* p = _horner_p.data();
+		const double* q = _horner_q.data();
+
+		vec res(1) ;
+		switch(_parameters.dimX())
+		{
+			case 1:
+				res[0] = horner_value<1>(x, _min, _max, p, q, _horner_degree);
+				return res;
+			case 2:
+				res[0] = horner_value<2>(x, _min, _max, p, q, _horner_degree);
+				return res;
+			case 3:
+				res[0] = horner_value<3>(x, _min, _max, p, q, _horner_degree);
+				return res;
+		}
+	}
 
-	unsigned int const np = _p_coeffs.size();
-	unsigned int const nq = _q_coeffs.size();
+	// Otherwise evaluate the basis functions, in a buffer on the stack
+	// unless there are many of them
+	const int np = _p_coeffs.size(), nq = _q_coeffs.size();
+	double buffer[stack_buffer_size];
+	vec heap;
+	double* storage = buffer;
+	if(np+nq > stack_buffer_size)
+	{
+		heap.resize(np+nq);
+		storage = heap.data();
+	}
 
-	double p = 0.0f ;
-	double q = 0.0f ;
+	Eigen::Map<vec> pi(storage, np), qi(storage+np, nq);
+	basis(x, pi, qi);
 
-	for(unsigned int i=0; i<np; ++i)
+	double p = 0.0 ;
+	double q = 0.0 ;
+
+	for(unsigned int i=0; i<_p_coeffs.size(); ++i)
 	{
-		p += _p_coeffs[i].a*this->p(x, i) ;
+		p += _p_coeffs[i].a*pi[i] ;
 	}
 
-	for(unsigned int i=0; i<nq; ++i)
+	for(unsigned int i=0; i<_q_coeffs.size(); ++i)
 	{
-		q += _q_coeffs[i].a*this->q(x, i) ;
+		q += _q_coeffs[i].a*qi[i] ;
 	}
 
+	vec res(1) ;
 	res[0] = p/q ;
 	return res ;
 }
@@ -524,7 +660,7 @@ rational_function::rational_function(int np, int nq) : np(np), nq(nq)
 {
 }
 
-rational_function_1d::rational_function_1d()
+rational_function_1d::rational_function_1d() : _max_degree(0), _horner_degree(-1)
 {
 }
 
@@ -724,3 +860,33 @@ std::ostream& operator<< (std::ostream& out, const rational_function& r)
 
 
 #endif
+
+bool alta::fit_channels(rational_function& r,
+                        const std::function<bool(int, rational_function_1d*)>& fit,
+                        int nb_threads)
+{
+	const int nY = r.parametrization().dimY();
+
+	// Allocate the 1D functions before the threads get them
+	std::vector<rational_function_1d*> rs(nY);
+	for(int j=0; j<nY; ++j)
+	{
+		rs[j] = r.get(j);
+	}
+
+#ifdef _OPENMP
+	const int threads = nb_threads > 0 ? nb_threads : omp_get_max_threads();
+#endif
+
+	std::atomic<bool> fitted(true);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads) if(nY > 1)
+	for(int j=0; j<nY; ++j)
+	{
+		if(fitted && !fit(j, rs[j]))
+		{
+			fitted = false;
+		}
+	}
+
+	return fitted;
+}
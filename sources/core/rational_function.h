@@ -14,6 +14,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <functional>
 
 // Interface
 #include "function.h"
@@ -53,7 +54,10 @@ class rational_function_1d : public function
 
 		/* FUNCTION INHERITANCE */
 
-		//! Overload the function operator
+		//! Overload the function operator. Up to three dimensions, monomial
+		//! bases use a nested Horner evaluation; otherwise the basis
+		//! functions are evaluated in a buffer on the stack, so that the
+		//! returned vector is the only allocation of small functions.
 		virtual vec value(const vec& x) const ;
 		virtual vec operator()(const vec& x) const { return value(x) ; }
 
@@ -90,6 +94,26 @@ class rational_function_1d : public function
 		//! denominator of the rational function.
 		virtual double q(const vec& x, int j) const ;
 
+		//! Evaluate all the basis functions at once: P[i] is set to
+		//! \f$p_i(\mathbf{x})\f$ and Q[j] to \f$q_j(\mathbf{x})\f$, where P
+		//! and Q have as many elements as the numerator and denominator.
+		//!
+		//! The default implementation evaluates the one-dimensional
+		//! polynomials of each normalized coordinate once, with \a
+		//! basis_table, and combines them according to the degree table,
+		//! which is much cheaper than calling \a p(x, i) and \a q(x, j)
+		//! for each basis function. Classes that override \a p(x, i) or \a
+		//! q(x, j) must override \a basis_table or this method as well.
+		virtual void basis(const vec& x, vecref p, vecref q) const ;
+
+		//! Evaluate the basis functions on each row of X: the I-th rows of P
+		//! and Q are set as \a basis does for the I-th row of X. The storage
+		//! of the one-dimensional polynomials is shared by all the rows.
+		//! Classes that override \a basis must override this method as well.
+		virtual void bases(const Eigen::Ref<const RowMatrixXd>& x,
+		                   Eigen::Ref<RowMatrixXd> p,
+		                   Eigen::Ref<RowMatrixXd> q) const ;
+
 
 		//! Update the coefficient vectors with new values. The new values
 		//! are normalized by the first element of the denominator 
@@ -138,9 +162,45 @@ class rational_function_1d : public function
 
 	protected: // functions
 
-		static int estimate_dk(int k, int d);
-
-		static void populate(std::vector<int>& vec, int N, int M, int j);
+		//! Return the vector of degree associated with the I-th basis
+		//! function, see \a index2degree. I must be lower than the
+		//! number of coefficients of the numerator or the denominator.
+		const std::vector<int>& degree(int i) const { return _degrees[i]; }
+
+		//! Set T[e] to the one-dimensional polynomial of degree e at the
+		//! normalized coordinate X, in [-1, 1], for e < T.size(). The
+		//! default polynomials are the monomials \f$x^e\f$. Classes that use
+		//! another family of polynomials can override this method to get a
+		//! fast \a basis, for example with a three-term recurrence.
+		virtual void basis_table(double x, vecref t) const ;
+
+		//! Is the basis made of the monomials of the normalized
+		//! coordinates? In that case, and when dimX is at most 3, \a value
+		//! uses an evaluator specialized for the dimension that performs a
+		//! nested Horner evaluation of the numerator and the denominator.
+		//! Classes that override \a basis_table or \a basis must return
+		//! false.
+		virtual bool monomial_basis() const { return true; }
+
+		//! Fill the NP elements of P and the NQ elements of Q with the basis
+		//! functions at X, using TABLE, of (max degree + 1) × dimX
+		//! elements, to store the one-dimensional polynomials of each
+		//! coordinate.
+		void tabulated_basis(const double* x, Eigen::Ref<Eigen::MatrixXd> table,
+		                     double* p, int np, double* q, int nq) const ;
+
+		//! Fill P and Q by calling \a p(x, i) and \a q(x, j) for each
+		//! basis function. This is an implementation of \a basis for
+		//! classes that provide their own basis functions.
+		void basis_from_indices(const vec& x, vecref p, vecref q) const ;
+
+		//! Return the vectors of degree of the N first basis functions
+		//! for DIMX dimensions, in the order used by \a index2degree.
+		static std::vector<std::vector<int> > degree_table(int dimX, int n);
+
+		//! Copy the coefficients in the layout of the Horner evaluation, if
+		//! the basis and the dimension allow it.
+		void update_horner();
 
 
 	protected: // data
@@ -163,6 +223,22 @@ class rational_function_1d : public function
 		std::vector<coeff> _p_coeffs;
 		std::vector<coeff> _q_coeffs;
 
+		//! Vectors of degree of the basis functions of the numerator and
+		//! the denominator, computed once by \a resize, and the highest
+		//! degree they contain.
+		std::vector<std::vector<int> > _degrees;
+		int _max_degree;
+
+		//! Layout of the coefficients for the Horner evaluation of \a value:
+		//! the index of the basis function stored at each position, or -1,
+		//! for polynomials of total degree up to \a _horner_degree. The
+		//! coefficients of the numerator and the denominator are copied in
+		//! this order by \a update, and are empty when the specialized
+		//! evaluator is not used.
+		std::vector<int> _horner_index;
+		std::vector<double> _horner_p, _horner_q;
+		int _horner_degree;
+
 		//! Is the function separable with respect to its input dimensions?
 		//! \todo Make possible to have only part of the dimensions
 		//! separable.
@@ -265,4 +341,19 @@ class rational_function : public function
 		//! color channel?
 		int np, nq;
 };
+
+/*! \brief Fit each output channel of R independently, calling FIT with the
+ *  index of the channel and its 1D rational function.
+ *
+ *  \details
+ *  The channels are fitted concurrently on at most NB_THREADS threads, or
+ *  on the number of threads OpenMP would use if NB_THREADS is not positive.
+ *  The 1D functions are allocated beforehand so that each call to FIT only
+ *  updates the function of its channel.  Once a channel fails, the
+ *  channels that are not started yet are skipped.  Return true if all the
+ *  channels were fitted.
+ */
+bool fit_channels(rational_function& r,
+                  const std::function<bool(int, rational_function_1d*)>& fit,
+                  int nb_threads = 0);
 }
@@ -0,0 +1,99 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#include "streaming_data.h"
+
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+using namespace alta;
+
+streaming_data::streaming_data(const std::string& file, int window_rows)
+    : data(parameters(), 0), _window_first(0), _window_rows(0)
+{
+    _input.exceptions(std::ios_base::failbit);
+    _input.open(file.c_str(), std::ios_base::binary);
+
+    auto header = arguments::parse_header(_input);
+    _offset = _input.tellg();
+
+    // FIXME: Like 'load_data_from_binary', assume a native-endian file of
+    // double-precision numbers.
+    assert(header["FORMAT"] == "binary");
+    assert(header["PRECISION"] == "ieee754-double");
+
+    std::pair<int, int> dim = header.get_pair<int>("DIM");
+    _parameters = parameters(dim.first, dim.second,
+                             params::parse_input(header["PARAM_IN"]),
+                             params::parse_output(header["PARAM_OUT"]));
+    _size = std::max(header.get_int("SAMPLE_COUNT"), 0);
+
+    int vs = header.get_int("VS");
+    _ci_kind = vs == 2 ? vertical_segment::ASYMMETRICAL_CONFIDENCE_INTERVAL
+        : (vs == 1 ? vertical_segment::SYMMETRICAL_CONFIDENCE_INTERVAL
+           : vertical_segment::NO_CONFIDENCE_INTERVAL);
+    _columns = dim.first + dim.second
+        + vertical_segment::confidence_interval_columns(_ci_kind,
+                                                        _parameters);
+
+    _window.resize(std::max(1, std::min(window_rows, _size)), _columns);
+
+    // Compute the domain of definition with a first pass over the file.
+    _min = vec::Constant(dim.first, std::numeric_limits<double>::max());
+    _max = vec::Constant(dim.first, -std::numeric_limits<double>::max());
+    for(int first = 0; first < _size; first += _window_rows)
+    {
+        load_window(first);
+        auto x = _window.topLeftCorner(_window_rows, dim.first);
+        _min = _min.cwiseMin(x.colwise().minCoeff().transpose());
+        _max = _max.cwiseMax(x.colwise().maxCoeff().transpose());
+    }
+}
+
+void streaming_data::load_window(int i) const
+{
+    assert(i >= 0 && i < _size);
+
+    if(i >= _window_first && i < _window_first + _window_rows)
+        return;
+
+    _window_first = i;
+    _window_rows = std::min<int>(_window.rows(), _size - i);
+
+    _input.seekg(_offset + std::streamoff(i) * _columns * sizeof(double));
+    _input.read((char *) _window.data(),
+                std::streamsize(_window_rows) * _columns * sizeof(double));
+}
+
+vec streaming_data::get(int i) const
+{
+    load_window(i);
+    return _window.row(i - _window_first)
+        .head(_parameters.dimX() + _parameters.dimY());
+}
+
+void streaming_data::get_block(int first, Eigen::Ref<RowMatrixXd> block) const
+{
+    assert(first >= 0 && first + block.rows() <= size());
+    assert(block.cols() == _parameters.dimX() + _parameters.dimY());
+
+    // Copy the rows that are in the window, then slide it.
+    for(int row = 0; row < block.rows(); )
+    {
+        load_window(first + row);
+        int offset = first + row - _window_first;
+        int count = std::min<int>(block.rows() - row, _window_rows - offset);
+
+        block.middleRows(row, count) =
+            _window.block(offset, 0, count, block.cols());
+        row += count;
+    }
+}
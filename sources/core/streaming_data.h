@@ -0,0 +1,92 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#pragma once
+
+#include <string>
+#include <fstream>
+
+#include "common.h"
+#include "data.h"
+#include "vertical_segment.h"
+
+namespace alta {
+
+/*! \ingroup core
+ *  \ingroup datas
+ *
+ *  \brief
+ *  A read-only data object that keeps its samples on disk.
+ *
+ *  This class reads an ALTA binary data file (see \ref data-formats) on
+ *  demand, keeping at most a window of rows in memory.  This allows
+ *  processing data sets larger than the available memory, provided they are
+ *  accessed sequentially, ideally through \a data::get_block.  Random accesses
+ *  through \a get remain possible but reload the window whenever they fall
+ *  outside of it.
+ *
+ *  This data object is selected with <strong>\-\-data streaming_data</strong>
+ *  and accepts the following option:
+ *
+ *  + <strong>\-\-data-window</strong> <em>[int]</em> the maximum number of
+ *    rows kept in memory (65536 by default).
+ *
+ *  Note that accesses are not thread-safe since they share the window.
+ */
+class streaming_data : public data
+{
+  public: // methods
+
+    //! \brief Open FILE, an ALTA binary data file, keeping at most
+    //! WINDOW_ROWS rows in memory.
+    streaming_data(const std::string& file, int window_rows = 65536);
+
+    virtual vec get(int i) const;
+
+    virtual void get_block(int first, Eigen::Ref<RowMatrixXd> block) const;
+
+    virtual int block_size() const { return _window.rows(); }
+
+    virtual vec value(const vec&) const {
+        NOT_IMPLEMENTED();
+    }
+
+    //! \brief Streaming data is read-only.
+    virtual void set(int, const vec&) {
+        NOT_IMPLEMENTED();
+    }
+
+    //! \brief Return the type of CI data stored in the file.
+    vertical_segment::ci_kind confidence_interval_kind() const
+    {
+        return _ci_kind;
+    }
+
+  private: // methods
+
+    //! \brief Make sure row I is within the window.
+    void load_window(int i) const;
+
+  private: // data
+
+    mutable std::ifstream _input;
+
+    // Offset of the first row in the file, and number of columns of each
+    // row, confidence interval data included.
+    std::streamoff _offset;
+    int _columns;
+
+    vertical_segment::ci_kind _ci_kind;
+
+    // The rows [_window_first, _window_first + _window_rows) are in memory.
+    mutable RowMatrixXd _window;
+    mutable int _window_first, _window_rows;
+};
+}
@@ -64,7 +64,7 @@ static vec data_max(Ref<MatrixXd> data)
 // Return a matrix view of PTR showing only the 'dimX' first rows of that
 // matrix.
 static Ref<MatrixXd>
-x_view(double *ptr, size_t cols, const parameters& params,
+abscissa_view(double *ptr, size_t cols, const parameters& params,
        vertical_segment::ci_kind kind)
 {
     auto stride = params.dimX() + params.dimY()
@@ -79,12 +79,21 @@ vertical_segment::vertical_segment(const parameters& params,
                                    std::shared_ptr<double> input_data,
                                    ci_kind kind)
     : data(params, size,
-           data_min(x_view(input_data.get(), size, params, kind)),
-           data_max(x_view(input_data.get(), size, params, kind))),
+           data_min(abscissa_view(input_data.get(), size, params, kind)),
+           data_max(abscissa_view(input_data.get(), size, params, kind))),
       _data(input_data),
       _ci_kind(kind),
       _is_absolute(true), _dt(0.1)
 {
+    // Compute the bounds of Y once when they are not stored
+    if(_ci_kind != ASYMMETRICAL_CONFIDENCE_INTERVAL)
+    {
+        _bounds.resize(size, 2 * params.dimY());
+        for(int i = 0; i < int(size); ++i)
+        {
+            update_bounds(i);
+        }
+    }
 }
 
 // Work around the lack of array support in C++11's 'shared_ptr'.
@@ -105,33 +114,32 @@ vertical_segment::vertical_segment(const parameters& params, unsigned int rows):
 
 void vertical_segment::get(int i, vec& x, vec& yl, vec& yu) const
 {
-    // Make sure we have the lower and upper bounds of Y.
-    //assert(confidence_interval_kind() == ASYMMETRICAL_CONFIDENCE_INTERVAL);
+    x  = x_view().row(i);
+    yl = yl_view().row(i);
+    yu = yu_view().row(i);
+}
 
+void vertical_segment::update_bounds(int i)
+{
+    const int dimY = _parameters.dimY();
     auto row = matrix_view().row(i);
-
-    x = row.segment(0, _parameters.dimX());
-
-    auto y = row.segment(_parameters.dimX(), _parameters.dimY());
+    auto y = row.segment(_parameters.dimX(), dimY);
 
     switch(confidence_interval_kind()) {
-	case ASYMMETRICAL_CONFIDENCE_INTERVAL:
-	    yl = row.segment(_parameters.dimX() + _parameters.dimY(),
-			    _parameters.dimY());
-	    yu = row.segment(_parameters.dimX() + 2 * _parameters.dimY(),
-			    _parameters.dimY());
-	    break;
-
 	case SYMMETRICAL_CONFIDENCE_INTERVAL:
-	    yl = y - row.segment(_parameters.dimX() + _parameters.dimY(),
-			         _parameters.dimY());
-	    yu = y - row.segment(_parameters.dimX() + _parameters.dimY(),
-			         _parameters.dimY());
+	{
+	    auto ci = row.segment(_parameters.dimX() + dimY, dimY);
+	    _bounds.row(i).head(dimY) = y - ci;
+	    _bounds.row(i).tail(dimY) = y + ci;
 	    break;
-	
+	}
+
 	case NO_CONFIDENCE_INTERVAL:
-	    yl = y.array() - _dt;
-	    yu = y.array() + _dt;
+	    _bounds.row(i).head(dimY) = y.array() - _dt;
+	    _bounds.row(i).tail(dimY) = y.array() + _dt;
+	    break;
+
+	default:
 	    break;
     }
 }
@@ -147,6 +155,11 @@ vec vertical_segment::get(int i) const
     return data_view().row(i);
 }
 
+void vertical_segment::get_block(int first, Ref<RowMatrixXd> block) const
+{
+    block = data_view().middleRows(first, block.rows());
+}
+
 void vertical_segment::set(int i, const vec& x)
 {
    // Check if the input data 'x' has the size of a vertical segment (i.e. dimX+3*dimY),
@@ -156,6 +169,11 @@ void vertical_segment::set(int i, const vec& x)
    {
        auto row = matrix_view().row(i);
        row.head(x.size()) = x;
+
+       if(_ci_kind != ASYMMETRICAL_CONFIDENCE_INTERVAL)
+       {
+           update_bounds(i);
+       }
    } else {
       std::cerr << "<<ERROR>> Passing an incorrect element to vertical_segment::set" << std::endl;
       throw;
@@ -89,6 +89,11 @@ class vertical_segment : public data
       };
 
 
+      //! \brief Read-only view of some columns of all the samples.
+      typedef Eigen::Map<const RowMatrixXd, 0, Eigen::OuterStride<> >
+          column_view;
+
+
    public: // methods
 
       vertical_segment(const parameters& params,
@@ -105,6 +110,8 @@ class vertical_segment : public data
       // Acces to data
       virtual vec get(int i) const ;
 
+      virtual void get_block(int first, Eigen::Ref<RowMatrixXd> block) const;
+
       virtual vec value(const vec&) const {
          NOT_IMPLEMENTED();
       }
@@ -169,8 +176,65 @@ class vertical_segment : public data
           return Eigen::Map<RowMatrixXd>(_data.get(), size(), column_number());
       }
 
+      //! \brief Return a view of the abscissae of all the samples, with
+      //! SIZE rows and dimX columns.
+      column_view x_view() const
+      {
+          return column_view(_data.get(), _size, _parameters.dimX(),
+                             Eigen::OuterStride<>(column_number()));
+      }
+
+      //! \brief Return a view of the values of all the samples, with SIZE
+      //! rows and dimY columns.
+      column_view y_view() const
+      {
+          return column_view(_data.get() + _parameters.dimX(), _size,
+                             _parameters.dimY(),
+                             Eigen::OuterStride<>(column_number()));
+      }
+
+      //! \brief Return a view of the lower bounds of the values of all the
+      //! samples, with SIZE rows and dimY columns.
+      //!
+      //! \details
+      //! When the object stores asymmetrical confidence intervals, this
+      //! is a view of the stored data.  Otherwise the bounds are computed
+      //! once when the object is created and kept up to date by \a set;
+      //! modifications made through \a matrix_view are not reflected.
+      column_view yl_view() const
+      {
+          return bounds_view(0);
+      }
+
+      //! \brief Return a view of the upper bounds of the values of all the
+      //! samples, see \a yl_view.
+      column_view yu_view() const
+      {
+          return bounds_view(_parameters.dimY());
+      }
+
    private: // method
 
+      //! \brief Return a view of the dimY columns of bounds starting at
+      //! OFFSET: the lower bounds are at offset 0 and the upper bounds at
+      //! offset dimY.
+      column_view bounds_view(int offset) const
+      {
+          if (_ci_kind == ASYMMETRICAL_CONFIDENCE_INTERVAL)
+              return column_view(_data.get() + _parameters.dimX()
+                                 + _parameters.dimY() + offset,
+                                 _size, _parameters.dimY(),
+                                 Eigen::OuterStride<>(column_number()));
+          else
+              return column_view(_bounds.data() + offset,
+                                 _size, _parameters.dimY(),
+                                 Eigen::OuterStride<>(_bounds.cols()));
+      }
+
+      //! \brief Compute the lower and upper bounds of row I when they are
+      //! not stored in DATA.
+      void update_bounds(int i);
+
       //! \brief Return a matrix view of DATA that excludes confidence
       // interval data.  It has (dimX + dimY) columns and SIZE rows.
       Eigen::Map<RowMatrixXd, 0, Eigen::OuterStride<> > data_view() const
@@ -195,6 +259,10 @@ class vertical_segment : public data
       // Type of confidence interval data available.
       const ci_kind _ci_kind;
 
+      // Lower and upper bounds of Y, side by side, when they are not
+      // directly stored in _DATA.
+      RowMatrixXd _bounds;
+
       // Store the different arguments for the vertical segment: is it using
       // relative or absolute intervals? What is the dt used ?
       bool   _is_absolute;
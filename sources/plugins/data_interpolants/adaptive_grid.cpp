@@ -0,0 +1,608 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#include <core/data.h>
+#include <core/data_storage.h>
+
+#include "grid_domain.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+#ifdef __GLIBC__
+# include <endian.h>
+#endif
+
+using namespace alta;
+
+/*! \ingroup datas
+ *  \class data_adaptive_grid
+ *  \brief Data object storing BRDF values on a hierarchical grid, refined
+ *  where multilinear interpolation is not accurate enough.
+ *
+ *  \details
+ *  The grid is a k-d tree whose nodes split their cell in two halves along
+ *  one dimension. Its leaves store the values at the corners of their cell
+ *  and interpolate them multilinearly, so flat regions are covered by a few
+ *  large cells while peaks are finely sampled, and only along the
+ *  dimensions where they vary. Queries descend the tree, in
+ *  \f$ O(\log n) \f$. Outside of the domain, the grid is extended by
+ *  its boundary values.
+ *
+ *  The grid is filled like \ref data_grid "data_grid": its samples are the
+ *  nodes of the finest lattice, with \f$ 2^L + 1 \f$ nodes per dimension,
+ *  and are set by \a set, for instance by \a data2data. The tree is built
+ *  from them when the grid is first queried or saved: a cell is split as
+ *  long as the interpolation of its corners differs from one of the
+ *  samples it contains by more than \f$ t (|y| + f) \f$, along the
+ *  dimension where linear interpolation is the least accurate. The samples
+ *  are then released, so the lattice only needs to fit in memory while the
+ *  grid is filled. The following arguments control the construction:
+ *
+ *  + <strong>\-\-param</strong> <em>[NAME]</em> the parametrization of the
+ *    grid, by default the one of the data converted to the grid.
+ *
+ *  + <strong>\-\-grid-levels</strong> <em>[L]</em> the number of times a
+ *    dimension can be split (6 by default).
+ *
+ *  + <strong>\-\-grid-tolerance</strong> <em>[t]</em> the relative
+ *    interpolation error allowed (0.01 by default).
+ *
+ *  + <strong>\-\-grid-floor</strong> <em>[f]</em> the value below which the
+ *    error is absolute rather than relative (0.001 by default).
+ *
+ *  Grids are saved in a compact binary format: the header is followed by
+ *  the tree, the corners of the leaves and the values of the corners.
+ *
+ *  \author Laurent Belcour <laurent.belcour@umontreal.ca>
+ */
+class AdaptiveGrid : public data {
+   public:
+
+      // Maximum dimension of the abscissae
+      static const int max_dimX = 6;
+
+      // Create an empty grid, whose lattice samples are allocated when
+      // ALLOCATE is true.
+      AdaptiveGrid(const parameters& params, const arguments& args,
+                   bool allocate = true)
+         : _built(false)
+      {
+         params::input in_param = params.input_parametrization();
+         params::output out_param = params.output_parametrization();
+
+         if(args.is_defined("PARAM_IN")) {
+            in_param = params::parse_input(args["PARAM_IN"]);
+         } else if(args.is_defined("param")) {
+            in_param = params::parse_input(args["param"]);
+         }
+         if(args.is_defined("PARAM_OUT")) {
+            out_param = params::parse_output(args["PARAM_OUT"]);
+         }
+
+         const int nX = params::dimension(in_param);
+         int nY = params.dimY();
+         if(args.is_defined("DIM")) {
+            std::istringstream dims(args["DIM"]);
+            int dimX;
+            dims >> dimX >> nY;
+         } else if(nY <= 0) {
+            nY = params::dimension(out_param);
+         }
+         assert(nX > 0 && nX <= max_dimX);
+         _parameters = parameters(nX, nY, in_param, out_param);
+
+         _levels    = args.get_int("grid-levels", 6);
+         _tolerance = args.get_double("grid-tolerance", 0.01);
+         _floor     = args.get_double("grid-floor", 0.001);
+
+         // Strides of the finest lattice, the last dimension being
+         // contiguous.
+         const int n = (1 << _levels) + 1;
+         if(std::pow(double(n), nX) > double(std::numeric_limits<int>::max())) {
+            std::cerr << "<<ERROR>> " << _levels << " levels are too many "
+                      << "for a grid of dimension " << nX << std::endl;
+            throw;
+         }
+
+         _size = 1;
+         for(int i=nX-1; i>=0; --i) {
+            _stride[i] = _size;
+            _size *= n;
+         }
+
+         _min = get_min(in_param);
+         _max = get_max(in_param);
+
+         if(allocate) {
+            _samples.assign(size_t(_size) * nY, 0.0);
+         }
+      }
+
+      vec get(int i) const
+      {
+         vec x(parametrization().dimX() + parametrization().dimY());
+         get_abscissa(i, x.data());
+
+         if(_built) {
+            interpolate(x.data(), x.data() + parametrization().dimX());
+         } else {
+            const double* y = sample(i);
+            std::copy(y, y + parametrization().dimY(),
+                      x.data() + parametrization().dimX());
+         }
+         return x;
+      }
+
+      // Setting a sample after the tree is built goes back to the samples
+      // of the lattice, interpolated from the tree.  Distinct samples can
+      // be set concurrently.
+      void set(int i, const vec& x)
+      {
+         assert(x.size() == parametrization().dimX() + parametrization().dimY());
+
+         if(_built) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(_built) {
+               release_tree();
+            }
+         }
+
+         std::copy(x.data() + parametrization().dimX(), x.data() + x.size(),
+                   _samples.begin() + size_t(i) * parametrization().dimY());
+      }
+
+      vec value(const vec& x) const
+      {
+         build();
+
+         vec y(parametrization().dimY());
+         interpolate(x.data(), y.data());
+         return y;
+      }
+
+      // Interpolate the rows of X in parallel chunks
+      void values(const Eigen::Ref<const RowMatrixXd>& x,
+                  Eigen::Ref<RowMatrixXd> y) const
+      {
+         assert(x.rows() == y.rows());
+         assert(y.cols() == parametrization().dimY());
+
+         build();
+         parallel_for_chunks(x.rows(), chunk_size, [&](int, int first, int count)
+         {
+            for(int i=first; i<first+count; ++i) {
+               interpolate(x.data() + i * x.outerStride(), &y(i, 0));
+            }
+         });
+      }
+
+      void save(const std::string& filename) const
+      {
+         build();
+
+         std::ofstream file;
+         file.exceptions(std::ios_base::failbit);
+         file.open(filename.c_str(), std::ios_base::trunc | std::ios_base::binary);
+         file.exceptions(std::ios_base::goodbit);
+
+         file << "#ALTA HEADER BEGIN" << std::endl;
+         file << "#DIM " << parametrization().dimX() << " "
+              << parametrization().dimY() << std::endl;
+         file << "#PARAM_IN  "
+              << params::get_name(parametrization().input_parametrization())
+              << std::endl;
+         file << "#PARAM_OUT "
+              << params::get_name(parametrization().output_parametrization())
+              << std::endl;
+         file << "#grid-levels " << _levels << std::endl;
+         file << "#grid-tolerance " << _tolerance << std::endl;
+         file << "#grid-floor " << _floor << std::endl;
+         file << "#NODES " << _nodes.size() << std::endl;
+         file << "#LEAVES " << _corners.size() / corner_count() << std::endl;
+         file << "#VERTICES " << _values.size() / parametrization().dimY() << std::endl;
+         file << "#FORMAT binary" << std::endl;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+         file << "#ENDIAN little" << std::endl;
+#else
+         file << "#ENDIAN big" << std::endl;
+#endif
+         file << "#ALTA HEADER END" << std::endl;
+         file << "#BEGIN_STREAM" << std::endl;
+
+         file.write((const char*) _nodes.data(), _nodes.size() * sizeof(int32_t));
+         file.write((const char*) _corners.data(), _corners.size() * sizeof(int32_t));
+         file.write((const char*) _values.data(), _values.size() * sizeof(double));
+         file.close();
+      }
+
+      // Read the tree from INPUT, positioned after a header written by
+      // 'save'.
+      bool load(std::istream& input, const arguments& header)
+      {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+         const bool swapped = header["ENDIAN"] == "big";
+#else
+         const bool swapped = header["ENDIAN"] == "little";
+#endif
+         if(header["FORMAT"] != "binary" || swapped) {
+            std::cerr << "<<ERROR>> unsupported adaptive grid format" << std::endl;
+            return false;
+         }
+
+         const int nb_nodes    = header.get_int("NODES", 0);
+         const int nb_leaves   = header.get_int("LEAVES", 0);
+         const int nb_vertices = header.get_int("VERTICES", 0);
+         if(nb_nodes <= 0 || nb_leaves <= 0 || nb_vertices <= 0) {
+            std::cerr << "<<ERROR>> invalid adaptive grid sizes" << std::endl;
+            return false;
+         }
+
+         _nodes.resize(nb_nodes);
+         _corners.resize(size_t(nb_leaves) * corner_count());
+         _values.resize(size_t(nb_vertices) * parametrization().dimY());
+
+         input.read((char*) _nodes.data(), _nodes.size() * sizeof(int32_t));
+         input.read((char*) _corners.data(), _corners.size() * sizeof(int32_t));
+         input.read((char*) _values.data(), _values.size() * sizeof(double));
+         if(!input || !valid_tree(nb_leaves, nb_vertices)) {
+            std::cerr << "<<ERROR>> truncated or corrupted adaptive grid" << std::endl;
+            _nodes.clear();
+            _corners.clear();
+            _values.clear();
+            return false;
+         }
+
+         _built = true;
+         return true;
+      }
+
+   private:
+
+      // Number of rows interpolated at once by a thread
+      static const int chunk_size = 1024;
+
+      int corner_count() const { return 1 << parametrization().dimX(); }
+
+      // Internal nodes store the dimension they split in their lower bits
+      static const int split_bits = 3, split_mask = (1 << split_bits) - 1;
+
+      // Check that the tree read from a file only refers to its own nodes,
+      // NB_LEAVES leaves and NB_VERTICES vertices. Children are stored after
+      // their parent, which also rules out cycles.
+      bool valid_tree(int nb_leaves, int nb_vertices) const
+      {
+         const int nb_nodes = _nodes.size();
+         for(int node=0; node<nb_nodes; ++node) {
+            const int32_t n = _nodes[node];
+            if(n >= 0) {
+               const int first = n >> split_bits;
+               if((n & split_mask) >= parametrization().dimX()
+                  || first <= node || first >= nb_nodes - 1) {
+                  return false;
+               }
+            } else if(-1 - n >= nb_leaves) {
+               return false;
+            }
+         }
+
+         for(const int32_t corner : _corners) {
+            if(corner < 0 || corner >= nb_vertices) {
+               return false;
+            }
+         }
+         return true;
+      }
+
+      // Values of the I-th sample of the lattice
+      const double* sample(int i) const
+      {
+         return &_samples[size_t(i) * parametrization().dimY()];
+      }
+
+      // Abscissa of the N-th node of the lattice
+      void get_abscissa(int N, double* x) const
+      {
+         const int n = 1 << _levels;
+         for(int i=0; i<parametrization().dimX(); ++i) {
+            const int k = (N / _stride[i]) % (n + 1);
+            x[i] = _min[i] + (_max[i]-_min[i]) * k / n;
+         }
+      }
+
+      // Interpolate the value at X from the leaf containing it.
+      void interpolate(const double* x, double* y) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         // Coordinates of X in the finest lattice, and lower corner and
+         // extents of the current cell
+         const double n = double(1 << _levels);
+         double t[max_dimX], lo[max_dimX], extent[max_dimX];
+         for(int i=0; i<nX; ++i) {
+            t[i]      = clamp(n * (x[i]-_min[i]) / (_max[i]-_min[i]), 0.0, n);
+            lo[i]     = 0.0;
+            extent[i] = n;
+         }
+
+         int node = 0;
+         while(_nodes[node] >= 0) {
+            const int dim = _nodes[node] & split_mask;
+            node = _nodes[node] >> split_bits;
+
+            extent[dim] *= 0.5;
+            if(t[dim] >= lo[dim] + extent[dim]) {
+               lo[dim] += extent[dim];
+               ++node;
+            }
+         }
+
+         double alphas[max_dimX];
+         for(int i=0; i<nX; ++i) {
+            alphas[i] = std::min((t[i] - lo[i]) / extent[i], 1.0);
+         }
+
+         const int32_t* corners = &_corners[size_t(-1 - _nodes[node]) * corner_count()];
+         std::fill(y, y + nY, 0.0);
+         for(int d=0; d<corner_count(); ++d) {
+            double alpha = 1.0;
+            for(int i=0; i<nX; ++i) {
+               alpha *= (d & (1 << i)) ? alphas[i] : 1.0 - alphas[i];
+            }
+
+            if(alpha == 0.0) {
+               continue;
+            }
+
+            const double* v = &_values[size_t(corners[d]) * nY];
+            for(int j=0; j<nY; ++j) {
+               y[j] += alpha * v[j];
+            }
+         }
+      }
+
+      // Build the tree from the samples if they changed since the last
+      // build, and release them.
+      void build() const
+      {
+         if(_built) {
+            return;
+         }
+
+         std::lock_guard<std::mutex> lock(_mutex);
+         if(_built) {
+            return;
+         }
+
+         _nodes.assign(1, 0);
+         _corners.clear();
+         _values.clear();
+
+         std::unordered_map<int, int32_t> vertices;
+         int lo[max_dimX], extent[max_dimX];
+         for(int i=0; i<parametrization().dimX(); ++i) {
+            lo[i]     = 0;
+            extent[i] = 1 << _levels;
+         }
+         build_node(0, lo, extent, vertices);
+
+         const size_t leaves = _corners.size() / corner_count();
+         std::cout << "<<INFO>> adaptive grid with " << leaves << " leaves and "
+                   << vertices.size() << " vertices, "
+                   << 100.0 * vertices.size() / size() << "% of the lattice"
+                   << std::endl;
+
+         std::vector<double>().swap(_samples);
+         _built = true;
+      }
+
+      // Make NODE, whose cell has its lower corner at lattice coordinates
+      // LO and spans EXTENT lattice cells along each dimension, a leaf or
+      // split it in two.
+      void build_node(int node, int* lo, int* extent,
+                      std::unordered_map<int, int32_t>& vertices) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         // Lattice indices of the corners of the cell
+         std::vector<int> corners(corner_count());
+         for(int d=0; d<corner_count(); ++d) {
+            corners[d] = 0;
+            for(int i=0; i<nX; ++i) {
+               corners[d] += (lo[i] + ((d & (1 << i)) ? extent[i] : 0)) * _stride[i];
+            }
+         }
+
+         const int dim = split_dimension(lo, extent, corners);
+         if(dim >= 0) {
+            const int first = _nodes.size();
+            _nodes[node] = (first << split_bits) | dim;
+            _nodes.resize(first + 2, 0);
+
+            extent[dim] /= 2;
+            build_node(first, lo, extent, vertices);
+
+            lo[dim] += extent[dim];
+            build_node(first + 1, lo, extent, vertices);
+
+            lo[dim] -= extent[dim];
+            extent[dim] *= 2;
+            return;
+         }
+
+         // Make a leaf, sharing the values of the corners with the leaves
+         // already built.
+         _nodes[node] = -1 - int32_t(_corners.size() / corner_count());
+         for(int d=0; d<corner_count(); ++d) {
+            auto it = vertices.find(corners[d]);
+            if(it == vertices.end()) {
+               it = vertices.insert(std::make_pair(corners[d],
+                                                   int32_t(vertices.size()))).first;
+               const double* y = sample(corners[d]);
+               _values.insert(_values.end(), y, y + nY);
+            }
+            _corners.push_back(it->second);
+         }
+      }
+
+      // Return the dimension along which to split the cell at LO, with
+      // EXTENT and CORNERS, or -1 if interpolating its corners reproduces
+      // all its samples.  The cell is split along the dimension where
+      // linear interpolation between its faces is the least accurate.
+      int split_dimension(const int* lo, const int* extent,
+                          const std::vector<int>& corners) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         bool accurate = true;
+         double errors[max_dimX] = { 0.0 };
+
+         // Enumerate the samples of the cell with an odometer
+         int k[max_dimX] = { 0 };
+         while(true) {
+            int N = 0;
+            for(int i=0; i<nX; ++i) {
+               N += (lo[i] + k[i]) * _stride[i];
+            }
+
+            const double* y = sample(N);
+            for(int j=0; j<nY; ++j) {
+               const double scale = _tolerance * (std::abs(y[j]) + _floor);
+
+               // Multilinear interpolation of the corners
+               double p = 0.0;
+               for(int d=0; d<corner_count(); ++d) {
+                  double alpha = 1.0;
+                  for(int i=0; i<nX; ++i) {
+                     const double a = double(k[i]) / extent[i];
+                     alpha *= (d & (1 << i)) ? a : 1.0 - a;
+                  }
+                  p += alpha * sample(corners[d])[j];
+               }
+               accurate = accurate && std::abs(p - y[j]) <= scale;
+
+               // Linear interpolation along each dimension
+               for(int i=0; i<nX; ++i) {
+                  if(extent[i] < 2) {
+                     continue;
+                  }
+
+                  const double a = double(k[i]) / extent[i];
+                  const int N0 = N - k[i] * _stride[i];
+                  const int N1 = N0 + extent[i] * _stride[i];
+                  const double q = (1.0 - a) * sample(N0)[j] + a * sample(N1)[j];
+                  errors[i] = std::max(errors[i], std::abs(q - y[j]) / scale);
+               }
+            }
+
+            int i = nX - 1;
+            while(i >= 0 && k[i] == extent[i]) {
+               k[i] = 0;
+               --i;
+            }
+            if(i < 0) {
+               break;
+            }
+            ++k[i];
+         }
+
+         if(accurate) {
+            return -1;
+         }
+
+         // Cells that are only inaccurate across dimensions are split along
+         // their largest dimension.
+         int dim = -1;
+         for(int i=0; i<nX; ++i) {
+            if(extent[i] >= 2 && (dim < 0 || errors[i] > errors[dim]
+                                  || (errors[i] == errors[dim]
+                                      && extent[i] > extent[dim]))) {
+               dim = i;
+            }
+         }
+         return dim;
+      }
+
+      // Drop the tree and go back to the samples of the lattice
+      void release_tree()
+      {
+         const int nY = parametrization().dimY();
+         _samples.resize(size_t(size()) * nY);
+         parallel_for_chunks(size(), chunk_size, [&](int, int first, int count)
+         {
+            double x[max_dimX];
+            for(int i=first; i<first+count; ++i) {
+               get_abscissa(i, x);
+               interpolate(x, &_samples[size_t(i) * nY]);
+            }
+         });
+
+         _nodes.clear();
+         _corners.clear();
+         _values.clear();
+         _built = false;
+      }
+
+      // Maximum depth of the tree, and refinement criterion
+      int _levels;
+      double _tolerance, _floor;
+
+      // Strides of the finest lattice
+      int _stride[max_dimX];
+
+      // Samples of the lattice, until the tree is built
+      mutable std::vector<double> _samples;
+
+      // The tree: internal nodes store the index of their first child,
+      // their two children being contiguous, and the dimension they split.
+      // Leaves store -1 minus their index in _CORNERS, which lists the
+      // indices of their corners in _VALUES.
+      mutable std::vector<int32_t> _nodes, _corners;
+      mutable std::vector<double> _values;
+
+      mutable std::atomic<bool> _built;
+      mutable std::mutex _mutex;
+};
+
+ALTA_DLL_EXPORT data* provide_data(size_t size,
+                                   const parameters& params,
+                                   const arguments& args)
+{
+    return new AdaptiveGrid(params, args);
+}
+
+ALTA_DLL_EXPORT data* load_data(std::istream& input,
+                                const arguments& args)
+{
+    arguments header = arguments::parse_header(input);
+
+    AdaptiveGrid* result = new AdaptiveGrid(parameters(), header, false);
+    if(!result->load(input, header))
+    {
+        std::cerr << "<<ERROR>> unable to load the adaptive grid from '"
+                  << args["filename"] << "'" << std::endl;
+        delete result;
+        return NULL;
+    }
+
+    return result;
+}
@@ -10,7 +10,8 @@
 
 #include <core/data.h>
 #include <core/data_storage.h>
-#include <core/vertical_segment.h>
+
+#include "grid_domain.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -18,121 +19,15 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <limits>
+#include <vector>
 
-using namespace alta;
-
-static vec get_min(const params::input& param) {
-
-   vec res(params::dimension(param));
-   switch(param)
-   {
-      // 1D Parametrizations
-      case params::COS_TH:
-         res[0] = 0.0;
-         break;
-      case params::COS_TK:
-         res[0] = 0.0;
-         break;
-      case params::COS_TLV:
-         res[0] = -1.0;
-         break;
-      case params::COS_TLR:
-         res[0] = -1.0;
-         break;
-
-         // 2D Parametrizations
-      case params::COS_TH_TD:
-         res[0] = 0.0;
-         res[1] = 0.0;
-         break;
-      case params::RUSIN_TH_TD:
-         res[0] = 0.0;
-         res[1] = 0.0;
-         break;
-      case params::ISOTROPIC_TV_PROJ_DPHI:
-         res[0] = -0.5*M_PI;
-         res[1] = -0.5*M_PI;
-         break;
-      case params::STARK_2D:
-         res[0] = 0.0;
-         res[1] = 0.0;
-         break;
-
-      // 3D Params
-      case params::RUSIN_TH_TD_PD:
-         res[0] = 0.0;
-         res[1] = 0.0;
-         res[2] = 0.0;
-         break;
-      case params::STARK_3D:
-         res[0] = 0.0;
-         res[1] = 0.0;
-         res[2] = 0.0;
-         break;
-
-      default:
-         return res;
-         break;
-   }
-   return res;
-}
-
-static vec get_max(const params::input& param) {
-
-   vec res(params::dimension(param));
-   switch(param)
-   {
-      // 1D Parametrizations
-      case params::COS_TH:
-         res[0] = 1.0;
-         break;
-      case params::COS_TK:
-         res[0] = 1.0;
-         break;
-      case params::COS_TLV:
-         res[0] = 1.0;
-         break;
-      case params::COS_TLR:
-         res[0] = 1.0;
-         break;
-
-         // 2D Parametrizations
-      case params::COS_TH_TD:
-         res[0] = 1.0;
-         res[1] = 1.0;
-         break;
-      case params::RUSIN_TH_TD:
-         res[0] = 0.5*M_PI;
-         res[1] = 0.5*M_PI;
-         break;
-      case params::ISOTROPIC_TV_PROJ_DPHI:
-         res[0] = 0.5*M_PI;
-         res[1] = 0.5*M_PI;
-         break;
-      case params::STARK_2D:
-         res[0] = 1.0;
-         res[1] = 1.0;
-         break;
-
-      // 3D Params
-      case params::RUSIN_TH_TD_PD:
-         res[0] = 0.5*M_PI;
-         res[1] = 0.5*M_PI;
-         res[2] = 2.0*M_PI;
-         break;
-      case params::STARK_3D:
-         res[0] = 1.0;
-         res[1] = 1.0;
-         res[2] = 2.0*M_PI;
-         break;
-
-      default:
-         return res;
-         break;
-   }
-   return res;
-}
+#ifdef __GLIBC__
+# include <endian.h>
+#endif
 
+using namespace alta;
 
 /*! \ingroup datas
  *  \class data_grid
@@ -141,126 +36,116 @@ static vec get_max(const params::input& param) {
 
  *  \details
  *  It is possible to select the parametrization using the --param NAME
- *  argument when loading the BRDF. The default parametrization is
- *  \ref params::STARK_2D "STARK_2D"
+ *  argument when loading the BRDF. The default parametrization is the one
+ *  of the data converted to the grid. The number of cells along each
+ *  dimension is set with <b>--grid-size [n1, n2, ...]</b> (10 by default).
+ *
+ *  Only the values are stored, densely and in row-major order: abscissae
+ *  follow from the grid indices. Queries are multilinearly interpolated
+ *  between the \f$ 2^{dimX} \f$ nodes of their cell, and outside of the
+ *  domain the grid is extended by its boundary values.
+ *
+ *  Grids are saved in ALTA's text format, or in a binary format when
+ *  <b>--grid-binary</b> is given, where the header is followed by the raw
+ *  values. Both can be loaded back.
  *
  *  \author Laurent Belcour <laurent.belcour@umontreal.ca>
  *
  */
-class BrdfGrid : public vertical_segment {
+class BrdfGrid : public data {
    public:
 
-      std::vector<int> _size;
+      // Maximum dimension of the abscissae
+      static const int max_dimX = 8;
 
-      BrdfGrid(size_t size, const parameters& params, const arguments& args)
-        : vertical_segment(params, size)
+      BrdfGrid(const parameters& params, const arguments& args)
       {
-         initialize(args);
-      }
-
-      // FIXME: Move this to constructor.
-      void initialize(const arguments& args, bool preallocate = true) {
-
          // Allow to load a different parametrization depending on the
          // parameters provided.
-         params::input in_param;
-         params::output out_param;
-         int nX, nY;
+         params::input in_param = params.input_parametrization();
+         params::output out_param = params.output_parametrization();
 
          if(args.is_defined("PARAM_IN")) {
             in_param = params::parse_input(args["PARAM_IN"]);
          } else if(args.is_defined("param")) {
             in_param = params::parse_input(args["param"]);
          }
-         nX = params::dimension(in_param);
-
          if(args.is_defined("PARAM_OUT")) {
             out_param = params::parse_output(args["PARAM_OUT"]);
          }
-         nY = params::dimension(out_param);
+
+         const int nX = params::dimension(in_param);
+         int nY = params.dimY();
+         if(args.is_defined("DIM")) {
+            std::istringstream dims(args["DIM"]);
+            int dimX;
+            dims >> dimX >> nY;
+         } else if(nY <= 0) {
+            nY = params::dimension(out_param);
+         }
+         assert(nX > 0 && nX <= max_dimX);
+         _parameters = parameters(nX, nY, in_param, out_param);
 
          // Get the grid size, by default use an 10^dimX grid
-         int N = 1;
          if(args.is_defined("grid-size") && args.is_vec("grid-size")) {
-            _size = args.get_vec<int>("grid-size");
-            assert(_size.size() == nX);
-
-            for(int i=0; i<nX; ++i) {
-               N *= _size[i];
-            }
+            _grid_size = args.get_vec<int>("grid-size");
+            assert(_grid_size.size() == nX);
          } else {
-            for(int i=0; i<nX; ++i) {
-               _size.push_back(10);
-               N *= 10;
-            }
+            _grid_size.assign(nX, 10);
          }
-         _min = get_min(in_param);
-         _max = get_max(in_param);
 
-         // Preallocate the grid data
-         if(preallocate) {
-            // Set the abscissa data
-            vec x(parametrization().dimX() + parametrization().dimY());
-            for(int n=0; n<N; ++n) {
-               get_abscissa(n, x);
-               set(n, x);
-            }
+         // Strides of the indices, the last dimension being contiguous
+         _stride.resize(nX);
+         _size = 1;
+         for(int i=nX-1; i>=0; --i) {
+            assert(_grid_size[i] > 0);
+            _stride[i] = _size;
+            _size *= _grid_size[i];
          }
 
-         parameters p(nX, nY, in_param, out_param);
-         setParametrization(p);
-      }
-
-      inline int get_index(const vec& x) const {
+         _min = get_min(in_param);
+         _max = get_max(in_param);
+         _values.assign(size_t(_size) * nY, 0.0);
 
-         const auto k = get_indices(x);
-         return get_index(k);
+         _binary = args.is_defined("grid-binary")
+            || args["FORMAT"] == "binary";
       }
 
-      inline int get_index(const std::vector<int>& k) const {
-
-         int N = 0;
+      // Grid indices of the N-th node
+      inline void get_indices(int N, int* k) const {
          for(int i=0; i<parametrization().dimX(); ++i) {
-            N = N*_size[i] + k[i];
-         }
-         return N;
-      }
-
-      inline std::vector<int> get_indices(const vec& x) const {
-
-         std::vector<int> k(parametrization().dimX());
-         for(int i = 0; i < parametrization().dimX(); ++i) {
-            k[i] = floor((_size[i]-1)*(x[i]-_min[i]) / (_max[i]-_min[i]));
+            k[i] = (N / _stride[i]) % _grid_size[i];
          }
-         return k;
       }
 
-      inline std::vector<int> get_indices(int N) const {
+      // Obtain the X dimension of vector x from its index in the grid.
+      inline void get_abscissa(int N, double* x) const {
 
-         // Variables
-         std::vector<int> k(parametrization().dimX());
-         int K = N;
+         int k[max_dimX];
+         get_indices(N, k);
 
-         // Generate the k-th coordinate
-         k[parametrization().dimX()-1] = K % _size[parametrization().dimX()-1];
-         for(int i=parametrization().dimX()-2; i>=0; --i) {
-            K    = (K-k[i+1]) / _size[i+1];
-            k[i] = K % _size[i];
+         // Evaluate the abscissa from the vector indices and
+         // the min and max. The grid exactly map [0..1]
+         for(int i = 0; i < parametrization().dimX(); ++i) {
+            x[i] = _grid_size[i] > 1
+               ? _min[i] + (_max[i]-_min[i]) * k[i] / (_grid_size[i]-1)
+               : _min[i];
          }
-
-         return k;
       }
 
-      // Obtain the X dimension of vector x from its index in the grid.
-      inline void get_abscissa(int N, vec& x) const {
+      // Index of the node closest to X, or -1 if X is not in the grid
+      inline int get_index(const double* x) const {
 
-         const auto k = get_indices(N);
-
-         // Evaluate the abscissa from the vector indices and
-         // the min and max. The grid exactly map [0..1]
+         int N = 0;
          for(int i = 0; i < parametrization().dimX(); ++i) {
-            x[i] = _min[i] + (_max[i]-_min[i]) * k[i] / (_size[i]-1);
+            const double t = (_grid_size[i]-1) * (x[i]-_min[i]) / (_max[i]-_min[i]);
+            const int k = int(std::floor(t + 0.5));
+            if(!(k >= 0 && k < _grid_size[i])) {
+               return -1;
+            }
+            N += k * _stride[i];
          }
+         return N;
       }
 
       void save(const std::string& filename) const
@@ -268,20 +153,17 @@ class BrdfGrid : public vertical_segment {
          std::ofstream file;
 
          file.exceptions(std::ios_base::failbit);
-         file.open(filename.c_str(), std::ios_base::trunc);
+         file.open(filename.c_str(), std::ios_base::trunc | std::ios_base::binary);
          file.exceptions(std::ios_base::goodbit);
 
          save_header(file);
 
-         file << std::setprecision(std::numeric_limits<double>::digits10);
-         for(int i=0; i < size(); ++i)
-         {
-            vec x = get(i);
-            for(int j=0; j < parametrization().dimX() + parametrization().dimY(); ++j)
-            {
-               file << x[j] << "\t";
-            }
-            file << std::endl;
+         if(_binary) {
+            file << "#BEGIN_STREAM" << std::endl;
+            file.write((const char*) _values.data(),
+                       _values.size() * sizeof(double));
+         } else {
+            save_data_as_text_rows(file);
          }
 
          file.close();
@@ -297,10 +179,101 @@ class BrdfGrid : public vertical_segment {
          out << "#PARAM_OUT "
              << params::get_name(parametrization().output_parametrization())
              << std::endl;
-         out << "#grid-size " << _size << std::endl;
+         out << "#grid-size " << _grid_size << std::endl;
+         if(_binary) {
+            out << "#FORMAT binary" << std::endl;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            out << "#ENDIAN little" << std::endl;
+#else
+            out << "#ENDIAN big" << std::endl;
+#endif
+         }
          out << "#ALTA HEADER END" << std::endl;
       }
 
+      // Read the values of the grid from INPUT, positioned after a header
+      // written by 'save'.
+      bool load(std::istream& input, const arguments& header) {
+
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         if(_binary) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            const bool swapped = header["ENDIAN"] == "big";
+#else
+            const bool swapped = header["ENDIAN"] == "little";
+#endif
+            if(swapped) {
+               std::cerr << "<<ERROR>> the grid was saved with a different "
+                         << "byte order" << std::endl;
+               return false;
+            }
+
+            input.read((char*) _values.data(), _values.size() * sizeof(double));
+            return size_t(input.gcount()) == _values.size() * sizeof(double);
+         }
+
+         // Text rows may come in any order: place them at the node closest
+         // to their abscissa.
+         std::vector<double> row(nX + nY);
+         int count = 0;
+         std::string line;
+         while(std::getline(input, line)) {
+            if(line.empty() || line[0] == '#') {
+               continue;
+            }
+
+            std::istringstream linestream(line);
+            for(int j=0; j<nX+nY; ++j) {
+               linestream >> row[j];
+            }
+            if(!linestream) {
+               continue;
+            }
+
+            const int N = get_index(row.data());
+            if(N >= 0) {
+               std::copy(row.begin() + nX, row.end(),
+                         _values.begin() + size_t(N) * nY);
+               count++;
+            }
+         }
+
+         if(count != size()) {
+            std::cerr << "<<WARNING>> " << count << " samples read for a grid "
+                      << "of " << size() << " nodes" << std::endl;
+         }
+         return count > 0;
+      }
+
+      vec get(int i) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         vec x(nX + nY);
+         get_abscissa(i, x.data());
+         std::copy(_values.begin() + size_t(i) * nY,
+                   _values.begin() + size_t(i+1) * nY, x.data() + nX);
+         return x;
+      }
+
+      void get_block(int first, Eigen::Ref<RowMatrixXd> block) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+         assert(first >= 0 && first + block.rows() <= size());
+         assert(block.cols() == nX + nY);
+
+         for(int k=0; k<block.rows(); ++k) {
+            double* row = &block(k, 0);
+            get_abscissa(first + k, row);
+            std::copy(_values.begin() + size_t(first + k) * nY,
+                      _values.begin() + size_t(first + k + 1) * nY, row + nX);
+         }
+      }
+
       inline vec operator[](int i) const
       {
          return get(i) ;
@@ -308,58 +281,125 @@ class BrdfGrid : public vertical_segment {
 
       void set(int id, const vec& x)
       {
-         vertical_segment::set(id, x);
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+         assert(x.size() == nX + nY);
+
+         std::copy(x.data() + nX, x.data() + nX + nY,
+                   _values.begin() + size_t(id) * nY);
       }
 
       vec value(const vec& x) const
       {
-         // Get the base index
-         const auto k = get_indices(x);
-         const int id = get_index(k);
+         vec y(parametrization().dimY());
+         interpolate(x.data(), y.data());
+         return y;
+      }
+
+      // Interpolate the rows of X in parallel chunks
+      void values(const Eigen::Ref<const RowMatrixXd>& x,
+                  Eigen::Ref<RowMatrixXd> y) const
+      {
+         assert(x.rows() == y.rows());
+         assert(y.cols() == parametrization().dimY());
 
-         // Get the base configuration
-         const vec x0 = get(id);
+         parallel_for_chunks(x.rows(), chunk_size, [&](int, int first, int count)
+         {
+            for(int i=first; i<first+count; ++i) {
+               interpolate(x.data() + i * x.outerStride(), &y(i, 0));
+            }
+         });
+      }
 
-         // Compute the weights
-         vec alphas(parametrization().dimX());
-         for(int i = 0; i < parametrization().dimX(); ++i) {
-            const auto xdiff = (_size[i]-1) * (x[i]-x0[i]) / (_max[i]-_min[i]);
-            alphas[i] = clamp(xdiff, 0.0, 1.0);
-            assert(alphas[i] >= 0.0 && alphas[i] <= 1.0);
+   private:
+
+      // Number of rows interpolated at once by a thread
+      static const int chunk_size = 1024;
+
+      // Multilinear interpolation of the values of the nodes of the cell
+      // containing X, without allocation.
+      void interpolate(const double* x, double* y) const
+      {
+         const int nX = parametrization().dimX();
+         const int nY = parametrization().dimY();
+
+         // Base node of the cell, weights of its upper corner and offsets
+         // to its upper corner along each dimension
+         int    base = 0;
+         double alphas[max_dimX];
+         int    shifts[max_dimX];
+         for(int i = 0; i < nX; ++i) {
+            if(_grid_size[i] < 2) {
+               alphas[i] = 0.0;
+               shifts[i] = 0;
+               continue;
+            }
+
+            const double t = clamp((_grid_size[i]-1) * (x[i]-_min[i]) / (_max[i]-_min[i]),
+                                   0.0, double(_grid_size[i]-1));
+            const int k = std::min(int(t), _grid_size[i]-2);
+            alphas[i] = t - k;
+            shifts[i] = _stride[i];
+            base += k * _stride[i];
          }
 
-         // Result vector
-         vec y = vec::Zero(parametrization().dimY());
-         const unsigned int D = pow(2, parametrization().dimX());
-         for(unsigned int d=0; d<D; ++d) {
+         std::fill(y, y + nY, 0.0);
+         for(unsigned int d=0; d < (1u << nX); ++d) {
 
             double alpha = 1.0; // Global alpha
-            int    cid_s = 0;   // Id shift
+            int    id    = base;
+            for(int i=0; i<nX; ++i) {
+               if(d & (1u << i)) {
+                  alpha *= alphas[i];
+                  id    += shifts[i];
+               } else {
+                  alpha *= 1.0 - alphas[i];
+               }
+            }
 
-            for(int i=0; i<parametrization().dimX(); ++i) {
-               bool bitset = ((1 << i) & d);
-               auto calpha =  (bitset) ? alphas[i] : 1.0-alphas[i];
+            if(alpha == 0.0) {
+               continue;
+            }
 
-               alpha *= calpha;
-               cid_s = cid_s*_size[i] + ((bitset) ? 1 : 0);
+            const double* v = &_values[size_t(id) * nY];
+            for(int j=0; j<nY; ++j) {
+               y[j] += alpha * v[j];
             }
+         }
+      }
 
-            if(id+cid_s > size())
-               cid_s = 0;
+      // Write the nodes in ALTA's text format, block by block
+      void save_data_as_text_rows(std::ostream& out) const
+      {
+         out << std::setprecision(std::numeric_limits<double>::digits10);
 
-            y += alpha * get(id+cid_s).segment(parametrization().dimX(),
-                                               parametrization().dimY());
-         }
+         RowMatrixXd block(std::min(block_size(), size()),
+                           parametrization().dimX() + parametrization().dimY());
+         for(int first=0; first < size(); first += block.rows()) {
+            if(size() - first < block.rows()) {
+               block.conservativeResize(size() - first, Eigen::NoChange);
+            }
 
-         return y;
+            get_block(first, block);
+            save_text_rows(out, block);
+         }
       }
+
+      // Number of nodes and index strides along each dimension
+      std::vector<int> _grid_size, _stride;
+
+      // Values of the nodes, dimY per node
+      std::vector<double> _values;
+
+      // Whether 'save' uses the binary format
+      bool _binary;
 };
 
 ALTA_DLL_EXPORT data* provide_data(size_t size,
                                    const parameters& params,
                                    const arguments& args)
 {
-    return new BrdfGrid(size, params, args);
+    return new BrdfGrid(params, args);
 }
 
 ALTA_DLL_EXPORT data* load_data(std::istream& input,
@@ -367,19 +407,14 @@ ALTA_DLL_EXPORT data* load_data(std::istream& input,
 {
     arguments header = arguments::parse_header(input);
 
-#ifdef __GNUC__
-# warning FIXME we are not returning a "BrdfGrid"
-#endif
-    // We should probably rewrite this class as a transformation from 'data'
-    // to 'data'.
-
-    abort();
-#if 0
-    BrdfGrid* result = new BrdfGrid(args);
-
-    // XXX: Should be done in constructor.
-    result->initialize(header, false);
-#endif
+    BrdfGrid* result = new BrdfGrid(parameters(), header);
+    if(!result->load(input, header))
+    {
+        std::cerr << "<<ERROR>> unable to load the grid from '"
+                  << args["filename"] << "'" << std::endl;
+        delete result;
+        return NULL;
+    }
 
-    return load_data_from_text(input, header);
+    return result;
 }
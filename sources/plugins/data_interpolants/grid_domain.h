@@ -0,0 +1,133 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2013, 2014, 2016, 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#pragma once
+
+#include <core/common.h>
+#include <core/params.h>
+
+// Domain of the abscissae covered by the grid interpolants, for each
+// parametrization.  Unlisted parametrizations map to [0, 1].
+
+namespace alta {
+
+static inline vec get_min(const params::input& param) {
+
+   vec res = vec::Zero(params::dimension(param));
+   switch(param)
+   {
+      // 1D Parametrizations
+      case params::COS_TH:
+         res[0] = 0.0;
+         break;
+      case params::COS_TK:
+         res[0] = 0.0;
+         break;
+      case params::COS_TLV:
+         res[0] = -1.0;
+         break;
+      case params::COS_TLR:
+         res[0] = -1.0;
+         break;
+
+         // 2D Parametrizations
+      case params::COS_TH_TD:
+         res[0] = 0.0;
+         res[1] = 0.0;
+         break;
+      case params::RUSIN_TH_TD:
+         res[0] = 0.0;
+         res[1] = 0.0;
+         break;
+      case params::ISOTROPIC_TV_PROJ_DPHI:
+         res[0] = -0.5*M_PI;
+         res[1] = -0.5*M_PI;
+         break;
+      case params::STARK_2D:
+         res[0] = 0.0;
+         res[1] = 0.0;
+         break;
+
+      // 3D Params
+      case params::RUSIN_TH_TD_PD:
+         res[0] = 0.0;
+         res[1] = 0.0;
+         res[2] = 0.0;
+         break;
+      case params::STARK_3D:
+         res[0] = 0.0;
+         res[1] = 0.0;
+         res[2] = 0.0;
+         break;
+
+      default:
+         return res;
+         break;
+   }
+   return res;
+}
+
+static inline vec get_max(const params::input& param) {
+
+   vec res = vec::Ones(params::dimension(param));
+   switch(param)
+   {
+      // 1D Parametrizations
+      case params::COS_TH:
+         res[0] = 1.0;
+         break;
+      case params::COS_TK:
+         res[0] = 1.0;
+         break;
+      case params::COS_TLV:
+         res[0] = 1.0;
+         break;
+      case params::COS_TLR:
+         res[0] = 1.0;
+         break;
+
+         // 2D Parametrizations
+      case params::COS_TH_TD:
+         res[0] = 1.0;
+         res[1] = 1.0;
+         break;
+      case params::RUSIN_TH_TD:
+         res[0] = 0.5*M_PI;
+         res[1] = 0.5*M_PI;
+         break;
+      case params::ISOTROPIC_TV_PROJ_DPHI:
+         res[0] = 0.5*M_PI;
+         res[1] = 0.5*M_PI;
+         break;
+      case params::STARK_2D:
+         res[0] = 1.0;
+         res[1] = 1.0;
+         break;
+
+      // 3D Params
+      case params::RUSIN_TH_TD_PD:
+         res[0] = 0.5*M_PI;
+         res[1] = 0.5*M_PI;
+         res[2] = 2.0*M_PI;
+         break;
+      case params::STARK_3D:
+         res[0] = 1.0;
+         res[1] = 1.0;
+         res[2] = 2.0*M_PI;
+         break;
+
+      default:
+         return res;
+         break;
+   }
+   return res;
+}
+
+}
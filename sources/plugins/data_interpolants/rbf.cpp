@@ -14,6 +14,27 @@
 #include <core/args.h>
 #include <core/plugins_manager.h>
 
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+
+#include <atomic>
+#include <fcntl.h>
+
+#ifdef _WIN32
+# include <io.h>
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
 //#define USE_DELAUNAY
 #ifdef USE_DELAUNAY
 #include <CGAL/Cartesian_d.h>
@@ -50,7 +71,26 @@ using namespace alta;
  *     \in \mathcal{B}(\mathbf{x})} k(\mathbf{x} - \mathbf{x}_i)}\f$
  *  </center>
  *
- *  The kernel is set as \f$ k(\mathbf{d}) = {1 \over \epsilon + ||d||^2} \f$.
+ *  where \f$ \mathcal{B}(\mathbf{x}) \f$ holds the <b>--knn</b> nearest
+ *  neighbours of \f$ \mathbf{x} \f$ (3 by default), restricted to the
+ *  ball of radius <b>--radius</b> when it is set.
+ *
+ *  The kernel is selected with <b>--kernel</b>:
+ *   + `inverse` (default): \f$ k(\mathbf{d}) = {1 \over \epsilon +
+ *     ||d||^2} \f$;
+ *   + `gaussian`: \f$ k(\mathbf{d}) = \exp(-||d||^2 / r^2) \f$, where
+ *     \f$ r \f$ is the radius if set, and the distance to the farthest
+ *     neighbour otherwise.
+ *
+ *  The queries of a block of points (see \a values) are processed by a single
+ *  search in the k-d tree. The search is multi-threaded, unless the block is
+ *  evaluated from a parallel region, such as the chunks of `data2data`, whose
+ *  threads already share the cores.
+ *
+ *  The k-d tree is saved next to the data file, in a file named after the
+ *  data file and a hash of its abscissae, and loaded instead of being built
+ *  again by the next runs on the same data. Use <b>--no-index-cache</b> to
+ *  neither load nor save it.
  *
  *  ### Requirements
  *  This plugin requires the FLANN library to compile. On linux plateforms
@@ -67,17 +107,25 @@ class rbf_interpolant : public data
 
 		// Interpolation
 #ifndef USE_DELAUNAY
+		// Abscissae indexed by the k-d tree, and values of the data
+		RowMatrixXd _x, _y;
 		flann::Index< flann::L2<double> >* _kdtree;
 #endif
 		int _knn;
 
+		// Kernel and radius of the neighbourhood, 0 if not bounded
+		enum kernel_type { INVERSE, GAUSSIAN } _kernel;
+		double _radius;
+
 	public:
 
-		rbf_interpolant(ptr<data> proxied_data)
+		rbf_interpolant(ptr<data> proxied_data, const arguments& args)
         : data(proxied_data->parametrization(),
                proxied_data->size()),
           _data(proxied_data),
-          _knn(3)
+          _knn(args.get_int("knn", 3)),
+          _kernel(args["kernel"] == "gaussian" ? GAUSSIAN : INVERSE),
+          _radius(args.get_float("radius", 0.0f))
 		{
         _min = _data->min();
         _max = _data->max();
@@ -96,16 +144,30 @@ class rbf_interpolant : public data
         std::cout << "<<DEBUG>> number of points in the Delaunay triangulation: " << D->all_points().size() << std::endl;
         std::cout << "<<DEBUG>> number of points in input: " << _data->size() << std::endl;
 #else
-        // Update the KDtreee by inserting all points
-        double* _d = new double[parametrization().dimX()*_data->size()];
-        flann::Matrix<double> pts(_d, _data->size(), parametrization().dimX());
-        for(int i=0; i<_data->size(); ++i)
+        // Copy the abscissae and the values of the data, block by block
+        const int dimX = parametrization().dimX();
+        const int dimY = parametrization().dimY();
+        _x.resize(_data->size(), dimX);
+        _y.resize(_data->size(), dimY);
+        for_each_block(*_data, [&](int first, const RowMatrixXd& block)
         {
-            vec x = _data->get(i);
-            memcpy(pts[i], &x[0], parametrization().dimX()*sizeof(double));
+            _x.middleRows(first, block.rows()) = block.leftCols(dimX);
+            _y.middleRows(first, block.rows()) = block.rightCols(dimY);
+        });
+
+        // Update the KDtreee by inserting all points, or load the index
+        // built by a previous run on the same data. The index refers to the
+        // rows of _x, which must outlive it.
+        flann::Matrix<double> pts(_x.data(), _x.rows(), dimX);
+        const std::string cache = args.is_defined("no-index-cache")
+                                ? std::string() : index_filename(args["filename"]);
+        _kdtree = load_index(pts, cache);
+        if(_kdtree == NULL)
+        {
+            _kdtree = new flann::Index< flann::L2<double> >(pts, flann::KDTreeIndexParams(nb_trees));
+            _kdtree->buildIndex();
+            save_index(cache);
         }
-        _kdtree = new flann::Index< flann::L2<double> >(pts, flann::KDTreeIndexParams(4));
-        _kdtree->buildIndex();
 #endif
     }
 
@@ -124,6 +186,119 @@ class rbf_interpolant : public data
 		{
 		}
 
+	private: // methods
+#ifndef USE_DELAUNAY
+		// Number of randomized k-d trees of the index
+		static const int nb_trees = 4;
+
+		// Return the name of the file storing the index of the data loaded
+		// from FILENAME, or an empty string if FILENAME is empty. The name
+		// contains a hash of the abscissae and of the index parameters, so
+		// that an index is never loaded for other data.
+		std::string index_filename(const std::string& filename) const
+		{
+			if(filename.empty()) { return std::string(); }
+
+			// 64-bit FNV-1a hash
+			uint64_t hash = 14695981039346656037ULL;
+			auto combine = [&hash](const void* bytes, size_t n)
+			{
+				const unsigned char* b = static_cast<const unsigned char*>(bytes);
+				for(size_t i=0; i<n; ++i)
+				{
+					hash = (hash ^ b[i]) * 1099511628211ULL;
+				}
+			};
+
+			const int key[] = { int(_x.rows()), int(_x.cols()), nb_trees };
+			combine(key, sizeof(key));
+			combine(_x.data(), _x.size() * sizeof(double));
+
+			std::ostringstream name;
+			name << filename << "." << std::hex << std::setw(16)
+			     << std::setfill('0') << hash << ".flann";
+			return name.str();
+		}
+
+		// Load the index of PTS saved in FILENAME, if any. Return NULL if
+		// there is no such file or if it cannot be read.
+		flann::Index< flann::L2<double> >* load_index(const flann::Matrix<double>& pts,
+		                                               const std::string& filename) const
+		{
+			if(filename.empty() || !std::ifstream(filename.c_str()).good())
+			{
+				return NULL;
+			}
+
+			try
+			{
+				flann::Index< flann::L2<double> >* index =
+					new flann::Index< flann::L2<double> >(pts, flann::SavedIndexParams(filename));
+				std::cout << "<<INFO>> loaded the k-d tree from '" << filename << "'" << std::endl;
+				return index;
+			}
+			catch(std::exception& e)
+			{
+				std::cerr << "<<WARNING>> unable to load the k-d tree from '"
+				          << filename << "': " << e.what() << std::endl;
+				return NULL;
+			}
+		}
+
+		// Save the index to FILENAME, if not empty. The file is written
+		// under a temporary name unique to this run, in the same directory,
+		// and renamed, so that concurrent runs never read a partial index.
+		void save_index(const std::string& filename) const
+		{
+			if(filename.empty()) { return; }
+
+			// The name contains the process id and a counter of this
+			// process. It is created exclusively, with the permissions of
+			// any other file, subject to the umask.
+			static std::atomic<unsigned> counter(0);
+			std::string temporary;
+			for(int attempt=0; temporary.empty() && attempt<16; ++attempt)
+			{
+				const std::string name = filename + "."
+					+ std::to_string(getpid()) + "."
+					+ std::to_string(counter++) + ".tmp";
+				const int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+				if(fd >= 0)
+				{
+					close(fd);
+					temporary = name;
+				}
+				else if(errno != EEXIST)
+				{
+					break;
+				}
+			}
+			if(temporary.empty())
+			{
+				std::cerr << "<<WARNING>> unable to save the k-d tree to '"
+				          << filename << "': " << std::strerror(errno) << std::endl;
+				return;
+			}
+
+			try
+			{
+				_kdtree->save(temporary);
+				if(std::rename(temporary.c_str(), filename.c_str()) != 0)
+				{
+					std::remove(temporary.c_str());
+				}
+			}
+			catch(std::exception& e)
+			{
+				std::cerr << "<<WARNING>> unable to save the k-d tree to '"
+				          << filename << "': " << e.what() << std::endl;
+				std::remove(temporary.c_str());
+			}
+		}
+#endif
+
+	public: // methods
+
 		// Acces to data
 		virtual vec get(int id) const
 		{
@@ -145,30 +320,9 @@ class rbf_interpolant : public data
 			vec res = vec::Zero(parametrization().dimY());
 
 		#ifndef USE_DELAUNAY
-			// Query point
-			vec xc(x);
-			flann::Matrix<double> pts(&xc[0], 1, parametrization().dimX());
-			std::vector< std::vector<int> >    indices;
-			std::vector< std::vector<double> > dists;
-
-			_kdtree->knnSearch(pts, indices, dists, _knn, flann::SearchParams());
-
-			// Interpolate the value using the indices
-			double cum_dist = 0.0;
-			for(int i=0; i<indices[0].size(); ++i)
-			{
-				const int indice = indices[0][i];
-				vec y = _data->get(indice);
-
-		      const double kernel = 1.0/(1.0E-10 + dists[0][i]);
-
-        res      += kernel * y.tail(parametrization().dimY());
-				cum_dist += kernel;
-			}
-			if(cum_dist > 0.0)
-			{
-				res /= cum_dist;
-			}
+			RowMatrixXd y(1, parametrization().dimY());
+			values(x.head(parametrization().dimX()).transpose(), y);
+			res = y.row(0).transpose();
 		#else
 
 			Point pt_x(dD);
@@ -212,6 +366,74 @@ class rbf_interpolant : public data
 
 		   return res;
 		}
+
+#ifndef USE_DELAUNAY
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const
+		{
+			const int dimX = parametrization().dimX();
+			const int n = x.rows();
+			assert(y.rows() == n && y.cols() == _y.cols());
+			if(n == 0) { return; }
+
+			// Query all the points at once, with preallocated results
+			RowMatrixXd queries = x.leftCols(dimX);
+			std::vector<int>    indices(n * _knn);
+			std::vector<double> dists(n * _knn);
+			flann::Matrix<double> q(queries.data(), n, dimX);
+			flann::Matrix<int>    id(indices.data(), n, _knn);
+			flann::Matrix<double> d(dists.data(), n, _knn);
+
+			// FLANN marks the end of the neighbours of a query with -1
+			std::fill(indices.begin(), indices.end(), -1);
+
+			// Use all the cores, unless the caller already runs one block
+			// per thread: FLANN's threads would then oversubscribe them.
+			flann::SearchParams params;
+			params.cores = 0;
+		#ifdef _OPENMP
+			if(omp_in_parallel()) { params.cores = 1; }
+		#endif
+			if(_radius > 0.0)
+			{
+				// FLANN compares squared distances
+				params.max_neighbors = _knn;
+				_kdtree->radiusSearch(q, id, d, float(_radius*_radius), params);
+			}
+			else
+			{
+				_kdtree->knnSearch(q, id, d, _knn, params);
+			}
+
+			// Interpolate the value using the indices
+			for(int j=0; j<n; ++j)
+			{
+				// Number of neighbours, and squared width of the Gaussian
+				int count = 0;
+				double width = _radius * _radius;
+				for(; count<_knn && id[j][count] >= 0; ++count)
+				{
+					if(_radius <= 0.0) { width = std::max(width, d[j][count]); }
+				}
+
+				y.row(j).setZero();
+				double cum_dist = 0.0;
+				for(int i=0; i<count; ++i)
+				{
+					const double kernel = _kernel == GAUSSIAN && width > 0.0
+					                    ? std::exp(-d[j][i] / width)
+					                    : 1.0/(1.0E-10 + d[j][i]);
+
+					y.row(j) += kernel * _y.row(id[j][i]);
+					cum_dist += kernel;
+				}
+				if(cum_dist > 0.0)
+				{
+					y.row(j) /= cum_dist;
+				}
+			}
+		}
+#endif
 };
 
 ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args)
@@ -220,7 +442,7 @@ ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args)
     ptr<data> proxied = plugins_manager::load_data("vertical_segment",
                                                    input, args);
 
-    return new rbf_interpolant(proxied);
+    return new rbf_interpolant(proxied, args);
 }
 
 
@@ -12,47 +12,88 @@
 // STL includes
 #include <stdexcept>
 #include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ALTA includes
+#include <core/common.h>
+#include <core/data_storage.h>
+
+#include "EXR_writer.h"
 
 // TinyEXR includes
 #define TINYEXR_IMPLEMENTATION
 #include <tinyexr/tinyexr.h>
 
 
-/*! \class EXR_IO
+/*! \class EXR_image
  *
  * \details
- * EXR_IO provides static method to either load an RGB EXR file into a floatting
- * point array or save a RGB floatting point array to disk._data
- *
- * \author Laurent Belcour
+ * EXR_image decodes an EXR file with TinyEXR, in single precision, and copies
+ * its R, G and B channels to arrays of any layout and precision. The file is
+ * mapped in memory rather than read when possible, and the encoded file is
+ * released as soon as it is decoded.
  */
-template<typename FType>
-class t_EXR_IO
+class EXR_image
 {
 	public:
-		/*! \brief Load an EXR file from an input file stream.
+		EXR_image() : _loaded(false)
+		{
+			InitEXRHeader(&_header);
+			InitEXRImage(&_image);
+		}
+
+		~EXR_image()
+		{
+			if(_loaded) {
+				FreeEXRImage(&_image);
+			}
+			FreeEXRHeader(&_header);
+		}
+
+		/*! \brief Load the EXR file FILENAME that INPUT reads from its
+		 *  current position. The file is mapped in memory, or read in one
+		 *  pass if it cannot be mapped.
 		 */
-		static bool LoadEXR(std::istream& input, int& W,int& H, FType *& pix,int nC=3)
+		bool load(const std::string& filename, std::istream& input)
 		{
-			/* Convert the input std::istream into an unsigned char array */
-			std::vector<unsigned char> _memory;
-			size_t _n = 0, _m = 0;
-			while(input.good()) {
-				if(_n == _m) {
-					_m += 256;
-					_memory.resize(_m);
+			const std::streampos start = input.tellg();
+			if(!filename.empty() && start != std::streampos(-1)) {
+				input.seekg(0, std::ios::end);
+				const std::streamoff length = input.tellg() - start;
+				input.seekg(start);
+
+				auto mapped = alta::map_file(filename, size_t(start), size_t(length));
+				if(mapped) {
+					return load((const unsigned char*) mapped.get(), size_t(length));
 				}
-
-				_memory[_n++] = (unsigned char)input.get();
 			}
 
+			return load(input);
+		}
+
+		//! \brief Load an EXR file from an input stream, reading it in one pass.
+		bool load(std::istream& input)
+		{
+			const std::vector<unsigned char> memory((std::istreambuf_iterator<char>(input)),
+			                                        std::istreambuf_iterator<char>());
+			return load(memory.data(), memory.size());
+		}
+
+		//! \brief Load an EXR file from the SIZE bytes at MEMORY.
+		bool load(const unsigned char* memory, size_t size)
+		{
 			/* Check the different part of loading */
 			int _r = -1;
 			const char* _err;
 
 			/* Load the EXR version using TinyEXR */
 			EXRVersion _version;
-			_r = ParseEXRVersionFromMemory(&_version, &_memory[0], _memory.size());
+			_r = ParseEXRVersionFromMemory(&_version, memory, size);
 			if(_r != TINYEXR_SUCCESS) {
 				std::cerr << "<<ERROR>> Could not load EXR version from stream" << std::endl;
 				return false;
@@ -61,9 +102,7 @@ class t_EXR_IO
 			}
 
 			/* Load the EXR header */
-			EXRHeader _header;
-  			InitEXRHeader(&_header);
-			_r = ParseEXRHeaderFromMemory(&_header, &_version, &_memory[0], _memory.size(), &_err);
+			_r = ParseEXRHeaderFromMemory(&_header, &_version, memory, size, &_err);
 			if(_r != TINYEXR_SUCCESS) {
 				std::cerr << "<<ERROR>> Could not load EXR header from stream" << std::endl;
 				std::cerr << "<<ERROR>> " << _err << std::endl;
@@ -78,113 +117,139 @@ class t_EXR_IO
 			}
 
 			/* Load the EXR image */
-			EXRImage _image;
-  			InitEXRImage(&_image);
-
-			_r = LoadEXRImageFromMemory(&_image, &_header, &_memory[0], _memory.size(), &_err);
+			_r = LoadEXRImageFromMemory(&_image, &_header, memory, size, &_err);
 			if (_r != TINYEXR_SUCCESS) {
 				std::cerr << "<<ERROR>> Could not load EXR image from stream" << std::endl;
 				std::cerr << "<<ERROR>> " << _err << std::endl;
 				return false;
-			} else {
-				std::cout << "<<DEBUG>> Loading a " << _image.width << "x" << _image.height << " EXR file" << std::endl;
 			}
+			_loaded = true;
 
-			/*! \todo Check the different channels if they match RGB */
+			if(_image.images == NULL) {
+				std::cerr << "<<ERROR>> Tiled EXR files are not supported" << std::endl;
+				return false;
+			}
 
-			/*! \todo  handle VS data using multi-channel */
+			std::cout << "<<DEBUG>> Loading a " << _image.width << "x" << _image.height << " EXR file" << std::endl;
+			return true;
+		}
 
-			/* Recopy the image into the provided pixel array */
-			W = _image.width;
-			H = _image.height;
-			pix = new FType[W*H*3];
+		int width()  const { return _image.width;  }
+		int height() const { return _image.height; }
+
+		/*! \brief Copy the R, G and B channels to the pixels at R, G and B,
+		 *  which are STRIDE elements apart. Missing channels are set to zero.
+		 *  The pixels are converted in parallel.
+		 */
+		template<typename T>
+		void copy(T* r, T* g, T* b, size_t stride) const
+		{
+			/*! \todo  handle VS data using multi-channel */
+			const float* channels[3] = { NULL, NULL, NULL };
 			for(int k=0; k<_image.num_channels; ++k) {
-				for(int i=0; i<W*H; ++i) {
-					const FType val = (FType)(reinterpret_cast<float **>(_image.images)[k][i]);
-					switch(_header.channels[k].name[0]) {
-						case 'R':
-							pix[3*i + 0] = val;
-							break;
-						case 'G':
-							pix[3*i + 1] = val;
-							break;
-						case 'B':
-							pix[3*i + 2] = val;
-							break;
-						default:
-							std::cout << "<<DEBUG>> Unknow EXR channel \'" << _header.channels[k].name[0] << "\'" << std::endl;
-					}
+				const float* channel = reinterpret_cast<float **>(_image.images)[k];
+				switch(_header.channels[k].name[0]) {
+					case 'R':
+						channels[0] = channel;
+						break;
+					case 'G':
+						channels[1] = channel;
+						break;
+					case 'B':
+						channels[2] = channel;
+						break;
+					default:
+						std::cout << "<<DEBUG>> Unknow EXR channel \'" << _header.channels[k].name << "\'" << std::endl;
 				}
 			}
 
-			/* Free TinyEXR memory */
-			_r = FreeEXRHeader(&_header);
-			_r = FreeEXRImage(&_image);
-			return true ;
+			T* pixels[3] = { r, g, b };
+			alta::parallel_for_chunks(_image.width * _image.height, 16384,
+			                          [&](int, int first, int count)
+			{
+				for(int c=0; c<3; ++c) {
+					T* out = pixels[c] + first*stride;
+					if(channels[c] == NULL) {
+						for(int i=0; i<count; ++i, out += stride) {
+							*out = T(0);
+						}
+					} else {
+						const float* in = channels[c] + first;
+						for(int i=0; i<count; ++i, out += stride) {
+							*out = T(in[i]);
+						}
+					}
+				}
+			});
 		}
 
-		/*! \brief Save a RGB image into and OpenEXR file using TinyEXR.
-		 *  This code uses TinyEXR's reference implementation of saving a file as
-		 *  we do not manipulate streams here.
-		 */
-		static bool SaveEXR(const char *filename,int W,int H, const FType *pix,int nC=3)
-		{
-			EXRHeader header;
-			InitEXRHeader(&header);
-
-			EXRImage image;
-			InitEXRImage(&image);
+	private:
+		EXRHeader _header;
+		EXRImage  _image;
+		bool      _loaded;
+};
 
-			image.num_channels = 3;
 
-			std::vector<float> images[3];
-			images[0].resize(W*H);
-			images[1].resize(W*H);
-			images[2].resize(W*H);
+/*! \class EXR_IO
+ *
+ * \details
+ * EXR_IO provides static method to either load an RGB EXR file into a floatting
+ * point array or save a RGB floatting point array to disk._data
+ *
+ * \author Laurent Belcour
+ */
+template<typename FType>
+class t_EXR_IO
+{
+	public:
+		/*! \brief Load an EXR file from an input file stream.
+		 */
+		static bool LoadEXR(std::istream& input, int& W,int& H, FType *& pix,int nC=3)
+		{
+			EXR_image image;
+			return image.load(input) && Copy(image, W, H, pix);
+		}
 
-			// Split RGBRGBRGB... into R, G and B layer
-			for (int i = 0; i < W*H; i++) {
-				images[0][i] = (float)pix[3*i+0];
-				images[1][i] = (float)pix[3*i+1];
-				images[2][i] = (float)pix[3*i+2];
-			}
+		/*! \brief Load the EXR file FILENAME, read by INPUT, mapping it in
+		 *  memory rather than reading it when possible.
+		 */
+		static bool LoadEXR(const std::string& filename, std::istream& input,
+		                    int& W,int& H, FType *& pix,int nC=3)
+		{
+			EXR_image image;
+			return image.load(filename, input) && Copy(image, W, H, pix);
+		}
 
-			float* image_ptr[3];
-			image_ptr[0] = &(images[2].at(0)); // B
-			image_ptr[1] = &(images[1].at(0)); // G
-			image_ptr[2] = &(images[0].at(0)); // R
-
-			image.images = (unsigned char**)image_ptr;
-			image.width  = W;
-			image.height = H;
-
-			header.num_channels = 3;
-			header.channels = (EXRChannelInfo *)malloc(sizeof(EXRChannelInfo) * header.num_channels);
-			// Must be (A)BGR order, since most of EXR viewers expect this channel order.
-			strncpy(header.channels[0].name, "B", 255); header.channels[0].name[strlen("B")] = '\0';
-			strncpy(header.channels[1].name, "G", 255); header.channels[1].name[strlen("G")] = '\0';
-			strncpy(header.channels[2].name, "R", 255); header.channels[2].name[strlen("R")] = '\0';
-
-			header.pixel_types = (int *)malloc(sizeof(int) * header.num_channels);
-			header.requested_pixel_types = (int *)malloc(sizeof(int) * header.num_channels);
-			for (int i = 0; i < header.num_channels; i++) {
-				header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT; // pixel type of input image
-				header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT; // pixel type of output image to be stored in .EXR
+		/*! \brief Save a RGB image into an uncompressed OpenEXR file, one
+		 *  scanline at a time. The channels are stored as half precision
+		 *  floats when HALF is true, and as single precision floats otherwise.
+		 */
+		static bool SaveEXR(const char *filename,int W,int H, const FType *pix,int nC=3,
+		                    bool half=false)
+		{
+			EXR_writer writer(filename, W, H, half);
+			for(int y=0; y<H && writer.good(); ++y) {
+				const FType* line = pix + 3*size_t(W)*y;
+				writer.write_line(line, line+1, line+2, 3);
 			}
 
-			const char* err;
-			int ret = SaveEXRImageToFile(&image, &header, filename, &err);
-			if (ret != TINYEXR_SUCCESS) {
+			if(!writer.close()) {
 				std::cerr << "<<ERROR>> Unable to save to EXR file" << std::endl;
-				std::cerr << "<<ERROR>> " << err << std::endl;
-				return ret;
+				return false;
 			}
-
-			free(header.channels);
-			free(header.pixel_types);
-			free(header.requested_pixel_types);
 			return true ;
 		}
+
+	private:
+		static bool Copy(const EXR_image& image, int& W,int& H, FType *& pix)
+		{
+			/* Recopy the image into the provided pixel array */
+			W = image.width();
+			H = image.height();
+			pix = new FType[W*H*3];
+			image.copy(pix, pix+1, pix+2, 3);
+			return true;
+		}
 };
 
 typedef t_EXR_IO<float> EXR_IO ;
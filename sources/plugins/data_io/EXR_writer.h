@@ -0,0 +1,213 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+#pragma once
+
+// STL includes
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+/*! \brief Convert VALUE to the nearest half precision float, rounding ties
+ *  to even. Values beyond the half range become infinite.
+ */
+inline uint16_t float_to_half(float value)
+{
+	uint32_t f;
+	std::memcpy(&f, &value, sizeof(f));
+
+	const uint16_t sign = (f >> 16) & 0x8000;
+	f &= 0x7fffffff;
+
+	// Infinity and NaN
+	if(f >= 0x7f800000) {
+		return sign | 0x7c00 | (f > 0x7f800000 ? 0x200 : 0);
+	}
+
+	// Overflow: 65520 and above round to infinity
+	if(f >= 0x477ff000) {
+		return sign | 0x7c00;
+	}
+
+	// Subnormal half: below 2^-14
+	if(f < 0x38800000) {
+		if(f < 0x33000000) {
+			return sign;
+		}
+
+		const uint32_t m = (f & 0x7fffff) | 0x800000;
+		const int shift  = 126 - int(f >> 23);
+		const uint32_t rem = m & ((1u << shift) - 1), halfway = 1u << (shift-1);
+		uint32_t h = m >> shift;
+		if(rem > halfway || (rem == halfway && (h & 1))) {
+			++h;
+		}
+		return sign | uint16_t(h);
+	}
+
+	// Normal half: rebias the exponent, then round the mantissa. A carry
+	// correctly moves to the next exponent.
+	uint32_t h = (f - 0x38000000) >> 13;
+	const uint32_t rem = f & 0x1fff;
+	if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+		++h;
+	}
+	return sign | uint16_t(h);
+}
+
+
+/*! \class EXR_writer
+ *
+ * \details
+ * EXR_writer writes an uncompressed, scanline RGB OpenEXR file one line at a
+ * time, so that images can be exported without a copy of the whole image.
+ * The channels are stored in single or half precision.
+ */
+class EXR_writer
+{
+	public:
+		EXR_writer(const char* filename, int W, int H, bool half = false)
+			: _file(filename, std::ios_base::out | std::ios_base::binary),
+			  _width(W), _height(H), _y(0), _bytes(half ? 2 : 4),
+			  _line(8 + size_t(W)*3*_bytes)
+		{
+			// Channels must be sorted by name: B, G and R.
+			std::string channels;
+			for(const char* name : { "B", "G", "R" }) {
+				channels += std::string(name) + '\0';
+				put(channels, uint32_t(half ? 1 : 2)); // HALF or FLOAT
+				channels += std::string(4, '\0');      // pLinear, reserved
+				put(channels, uint32_t(1));            // xSampling
+				put(channels, uint32_t(1));            // ySampling
+			}
+			channels += '\0';
+
+			std::string window;
+			put(window, uint32_t(0));
+			put(window, uint32_t(0));
+			put(window, uint32_t(W-1));
+			put(window, uint32_t(H-1));
+
+			std::string header;
+			put(header, uint32_t(20000630));          // magic number
+			put(header, uint32_t(2));                 // single part, scanlines
+			attribute(header, "channels", "chlist", channels);
+			attribute(header, "compression", "compression", std::string(1, '\0'));
+			attribute(header, "dataWindow", "box2i", window);
+			attribute(header, "displayWindow", "box2i", window);
+			attribute(header, "lineOrder", "lineOrder", std::string(1, '\0'));
+			attribute(header, "pixelAspectRatio", "float", as_string(1.0f));
+			attribute(header, "screenWindowCenter", "v2f", as_string(0.0f) + as_string(0.0f));
+			attribute(header, "screenWindowWidth", "float", as_string(1.0f));
+			header += '\0';
+
+			// Every line has the same size, hence the offset table is known
+			// before the lines are written.
+			const uint64_t first = header.size() + 8*uint64_t(H);
+			for(int y=0; y<H; ++y) {
+				put(header, uint64_t(first + y*uint64_t(_line.size())));
+			}
+
+			_file.write(header.data(), header.size());
+		}
+
+		bool good() const
+		{
+			return _file.good();
+		}
+
+		/*! \brief Write the next scanline, whose pixels have their R, G and B
+		 *  components at R, G and B, STRIDE elements apart.
+		 */
+		template<typename T>
+		bool write_line(const T* r, const T* g, const T* b, size_t stride)
+		{
+			unsigned char* out = _line.data();
+			put(out, uint32_t(_y));
+			put(out, uint32_t(_line.size() - 8));
+
+			for(const T* in : { b, g, r }) {
+				for(int x=0; x<_width; ++x, in += stride) {
+					if(_bytes == 2) {
+						const uint16_t h = float_to_half(float(*in));
+						*out++ = h & 0xff;
+						*out++ = h >> 8;
+					} else {
+						put(out, as_uint(float(*in)));
+					}
+				}
+			}
+
+			_file.write((const char*) _line.data(), _line.size());
+			++_y;
+			return _file.good();
+		}
+
+		//! \brief Close the file, checking that all lines were written.
+		bool close()
+		{
+			_file.close();
+			if(_y != _height) {
+				std::cerr << "<<ERROR>> Only " << _y << " of " << _height
+				          << " EXR scanlines were written" << std::endl;
+				return false;
+			}
+			return !_file.fail();
+		}
+
+	private:
+		static uint32_t as_uint(float value)
+		{
+			uint32_t result;
+			std::memcpy(&result, &value, sizeof(result));
+			return result;
+		}
+
+		static std::string as_string(float value)
+		{
+			std::string result;
+			put(result, as_uint(value));
+			return result;
+		}
+
+		// Little endian encoding, as required by OpenEXR.
+		template<typename U>
+		static void put(std::string& out, U value)
+		{
+			for(size_t i=0; i<sizeof(U); ++i) {
+				out += char((value >> (8*i)) & 0xff);
+			}
+		}
+
+		template<typename U>
+		static void put(unsigned char*& out, U value)
+		{
+			for(size_t i=0; i<sizeof(U); ++i) {
+				*out++ = (value >> (8*i)) & 0xff;
+			}
+		}
+
+		static void attribute(std::string& header, const char* name,
+		                      const char* type, const std::string& value)
+		{
+			header += std::string(name) + '\0' + type + '\0';
+			put(header, uint32_t(value.size()));
+			header += value;
+		}
+
+		std::ofstream _file;
+		const int _width, _height;
+		int _y;
+		const size_t _bytes;
+		std::vector<unsigned char> _line;
+};
@@ -28,11 +28,14 @@
 #include <core/data.h>
 #include <core/common.h>
 #include <core/args.h>
+#include <core/data_storage.h>
 
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <vector>
 
 #define BRDF_SAMPLING_RES_THETA_H  90
 #define BRDF_SAMPLING_RES_THETA_D  90
@@ -64,6 +67,14 @@ using namespace alta;
  *  Note that this plugin is not compatible with the anisotropic measurments
  *  of [Ngan et al. [2005]][ngan].
  *
+ *  The table is stored in double precision unless <b>--merl-float</b> is
+ *  given, in which case it is stored in single precision, which halves its
+ *  memory footprint. Otherwise, the table of a MERL file is mapped in
+ *  memory rather than read: loading is immediate, and the processes working
+ *  on the same material share its pages. The mapping is read-only and the
+ *  RGB scaling is applied when the table is accessed. Blocks of directions
+ *  (see \ref data::values) are looked up in parallel.
+ *
  *  \author Laurent Belcour <laurent.belcour@umontreal.ca>
  *  \author Original code from Mitsubishi Electric Research Laboratories
  *
@@ -77,22 +88,39 @@ ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args);
     (BRDF_SAMPLING_RES_THETA_H * BRDF_SAMPLING_RES_THETA_D  \
      * BRDF_SAMPLING_RES_PHI_D / 2)
 
+// Number of directions looked up at once by a thread.
+static const int chunk_size = 1024;
+
+class MERL;
+static bool read_brdf(std::istream& input, MERL& merl);
+static MERL* map_brdf(std::istream& input, const std::string& filename);
+
 class MERL : public data
 {
 private: // data
-	double *brdf ;
+	// The table, in double or single precision, or mapped from a MERL
+	// file: only one of them is set.
+	std::vector<double> _brdf;
+	std::vector<float>  _brdf_float;
+	std::shared_ptr<const char> _mapped;
 	const int _nSlice;
 
-    MERL()
-        : MERL(parameters(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR))
+    MERL(bool single_precision = false,
+         const std::shared_ptr<const char>& mapped = std::shared_ptr<const char>())
+        : MERL(parameters(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR),
+               single_precision, mapped)
     { }
 
 public: // methods
 
-    MERL(const parameters& params) :
-      data(parameters(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR), MERL_SIZE), _nSlice(MERL_SIZE) {
-		brdf = new double[3*_nSlice];
-		std::fill(brdf, brdf + 3*_nSlice, 0.0);
+    MERL(const parameters& params, bool single_precision = false,
+         const std::shared_ptr<const char>& mapped = std::shared_ptr<const char>()) :
+      data(parameters(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR), MERL_SIZE),
+      _mapped(mapped), _nSlice(MERL_SIZE) {
+		if(!_mapped && single_precision)
+			_brdf_float.assign(3*_nSlice, 0.0f);
+		else if(!_mapped)
+			_brdf.assign(3*_nSlice, 0.0);
 
     _min.resize(3);
     _min[0] = 0.0;
@@ -106,7 +134,6 @@ public: // methods
     }
 
     ~MERL() {
-    	delete[] brdf;
     }
 
 
@@ -122,7 +149,19 @@ public: // methods
 		const int n = dims[0]*dims[1]*dims[2];
 
 		fwrite(dims, sizeof(int), 3, f);
-		fwrite(brdf, sizeof(double), 3*n, f);
+		if(_mapped)
+		{
+			fwrite(_mapped.get(), sizeof(double), 3*n, f);
+		}
+		else if(_brdf_float.empty())
+		{
+			fwrite(_brdf.data(), sizeof(double), 3*n, f);
+		}
+		else
+		{
+			const std::vector<double> table(_brdf_float.begin(), _brdf_float.end());
+			fwrite(table.data(), sizeof(double), 3*n, f);
+		}
 
 		fclose(f);
 	}
@@ -144,52 +183,125 @@ public: // methods
 		std::cout << "get -> " << i << " (" << theh_ind << ", " << thed_ind << ", " << phid_ind << ")" << std::endl;
 		std::cout << "       " << res[0] << ", " << res[1]  << ", " << res[2] << std::endl;
 	#endif
-		res[3] = brdf[i] * RED_SCALE;
-		res[4] = brdf[i + BRDF_SAMPLING_RES_THETA_H*BRDF_SAMPLING_RES_THETA_D*BRDF_SAMPLING_RES_PHI_D/2] * GREEN_SCALE;
-		res[5] = brdf[i + BRDF_SAMPLING_RES_THETA_H*BRDF_SAMPLING_RES_THETA_D*BRDF_SAMPLING_RES_PHI_D] * BLUE_SCALE;
+		rgb(i, &res[3]);
 		return res ;
 	}
 
+	// Fill the rows of BLOCK without allocating a vector per sample
+	void get_block(int first, Eigen::Ref<RowMatrixXd> block) const
+	{
+		assert(first >= 0 && first + block.rows() <= size());
+		assert(block.cols() == 6);
+
+		for(int k=0; k<block.rows(); ++k)
+		{
+			const int i = first + k;
+			int phid_ind = i % (BRDF_SAMPLING_RES_PHI_D / 2);
+			int thed_ind = (i / (BRDF_SAMPLING_RES_PHI_D / 2)) % BRDF_SAMPLING_RES_THETA_D ;
+			int theh_ind = (i / ((BRDF_SAMPLING_RES_PHI_D / 2) * BRDF_SAMPLING_RES_THETA_D))
+				            % BRDF_SAMPLING_RES_THETA_H ;
+
+			block(k, 0) = theta_half_from_index(theh_ind);
+			block(k, 1) = theta_diff_from_index(thed_ind);
+			block(k, 2) = phi_diff_from_index(phid_ind);
+			rgb(i, &block(k, 3));
+		}
+	}
+
 	void set(int i, const vec& x) {
     	assert(x.size() == (parametrization().dimX() + parametrization().dimY()));
 		int iR = i;
 		int iG = iR + _nSlice;
 		int iB = iG + _nSlice;
-		brdf[iR] = x[parametrization().dimX()+0] / RED_SCALE;
-		brdf[iG] = x[parametrization().dimX()+1] / GREEN_SCALE;
-		brdf[iB] = x[parametrization().dimX()+2] / BLUE_SCALE;
+		store(iR, x[parametrization().dimX()+0] / RED_SCALE);
+		store(iG, x[parametrization().dimX()+1] / GREEN_SCALE);
+		store(iB, x[parametrization().dimX()+2] / BLUE_SCALE);
 	}
 
 	vec value(const vec& in) const {
-	    double r, g, b;
+	    vec res(3);
+	    lookup(in[0], in[1], in[2], &res[0]);
+	    return res;
+	}
+
+	// Look up the rows of X in parallel chunks
+	void values(const Eigen::Ref<const RowMatrixXd>& x,
+	            Eigen::Ref<RowMatrixXd> y) const
+	{
+	    assert(x.rows() == y.rows() && y.cols() == 3);
 
-	    lookup_brdf_val(brdf, in[0], in[1], in[2], r, g, b) ;
+	    parallel_for_chunks(x.rows(), chunk_size, [&](int, int first, int count)
+	    {
+	        for(int i=first; i<first+count; ++i)
+	        {
+	            lookup(x(i, 0), x(i, 1), x(i, 2), &y(i, 0));
+	        }
+	    });
+	}
 
-	    vec res(3);
-	    res[0] = r ;
-	    res[1] = g ;
-	    res[2] = b ;
+
+private: //methods
+
+	// I-th element of the table
+	inline double at(int i) const
+	{
+		if(_mapped)
+		{
+			// The table follows the 12-byte header of the file, so its
+			// elements are not aligned.
+			double value;
+			std::memcpy(&value, _mapped.get() + i*sizeof(double), sizeof(double));
+			return value;
+		}
+
+		return _brdf_float.empty() ? _brdf[i] : double(_brdf_float[i]);
+	}
+
+	// Set the I-th element of the table.  A mapped table is copied first.
+	inline void store(int i, double value)
+	{
+		if(_mapped)
+		{
+			_brdf.resize(3*_nSlice);
+			std::memcpy(_brdf.data(), _mapped.get(), _brdf.size()*sizeof(double));
+			_mapped.reset();
+		}
+
+		if(_brdf_float.empty())
+			_brdf[i] = value;
+		else
+			_brdf_float[i] = float(value);
+	}
+
+	// Scaled RGB value of the I-th sample
+	inline void rgb(int i, double* res) const
+	{
+		res[0] = at(i) * RED_SCALE;
+		res[1] = at(i + _nSlice) * GREEN_SCALE;
+		res[2] = at(i + 2*_nSlice) * BLUE_SCALE;
+	}
+
+	// Look up the RGB value at (theta_half, theta_diff, phi_diff), and set
+	// negative values to zero.
+	inline void lookup(double theta_half, double theta_diff, double fi_diff,
+	                   double* res) const
+	{
+	    lookup_brdf_val(theta_half, theta_diff, fi_diff, res[0], res[1], res[2]) ;
 
 	    if( res[0] < 0.0 || res[1] < 0.0 || res[2] < 0.0 )
 	    {
 
 #ifdef DEBUG
-	    	std::cout << __FILE__ << " " << __LINE__ << " in[0] = " << in[0]
-	    						<< " in[1] = " << in[1] << " in[2] = " << in[2] << std::endl;
-	    	std::cout <<  "res = " << res << std::endl;
+	    	std::cout << __FILE__ << " " << __LINE__ << " in[0] = " << theta_half
+	    						<< " in[1] = " << theta_diff << " in[2] = " << fi_diff << std::endl;
+	    	std::cout <<  "res = " << res[0] << ", " << res[1] << ", " << res[2] << std::endl;
 #endif
 	    	res[0] = 0.0;
 	    	res[1] = 0.0;
 	    	res[2] = 0.0;
-
-	    	//assert(0);
 	    }
-	    return res;
 	}
 
-
-private: //methods
-
 	// cross product of two vectors
 	void cross_product (double* v1, double* v2, double* out) const
 	{
@@ -370,7 +482,7 @@ private: //methods
 
 
 	// Given a pair of incoming/outgoing angles, look up the BRDF.
-	void lookup_brdf_val(double* brdf, double theta_half,
+	void lookup_brdf_val(double theta_half,
 				  double theta_diff, double fi_diff,
 				  double& red_val,double& green_val,double& blue_val) const
 	{
@@ -404,9 +516,9 @@ private: //methods
 			  theta_half_index(theta_half) * BRDF_SAMPLING_RES_PHI_D / 2 *
 						         BRDF_SAMPLING_RES_THETA_D;
 
-		red_val = brdf[ind] * RED_SCALE;
-		green_val = brdf[ind + BRDF_SAMPLING_RES_THETA_H*BRDF_SAMPLING_RES_THETA_D*BRDF_SAMPLING_RES_PHI_D/2] * GREEN_SCALE;
-		blue_val = brdf[ind + BRDF_SAMPLING_RES_THETA_H*BRDF_SAMPLING_RES_THETA_D*BRDF_SAMPLING_RES_PHI_D] * BLUE_SCALE;
+		red_val   = at(ind) * RED_SCALE;
+		green_val = at(ind + _nSlice) * GREEN_SCALE;
+		blue_val  = at(ind + 2*_nSlice) * BLUE_SCALE;
 
 	#ifdef DEBUG
 		if (red_val < 0.0 || green_val < 0.0 || blue_val < 0.0)
@@ -421,9 +533,11 @@ private: //methods
 
 	// Read BRDF data
   friend data* load_data(std::istream&, const arguments&);
+  friend bool read_brdf(std::istream&, MERL&);
+  friend MERL* map_brdf(std::istream&, const std::string&);
 };
 
-static bool read_brdf(std::istream& input, double* &brdf)
+static bool read_brdf(std::istream& input, MERL& merl)
 {
 		int dims[3];
     input.read((char *) &dims, sizeof dims);
@@ -436,7 +550,20 @@ static bool read_brdf(std::istream& input, double* &brdf)
         return false;
 		}
 
-    input.read((char *) brdf, 3 * n * sizeof(double));
+    if (merl._brdf_float.empty())
+    {
+        input.read((char *) merl._brdf.data(), 3 * n * sizeof(double));
+    }
+    else
+    {
+        // Convert the table slice by slice
+        std::vector<double> slice(n);
+        for (int c = 0; c < 3; ++c)
+        {
+            input.read((char *) slice.data(), n * sizeof(double));
+            std::copy(slice.begin(), slice.end(), merl._brdf_float.begin() + c*n);
+        }
+    }
 
 		return true;
 }
@@ -445,18 +572,49 @@ static bool read_brdf(std::istream& input, double* &brdf)
 ALTA_DLL_EXPORT data* provide_data(size_t size, const parameters& params,
                                    const arguments& args)
 {
-    return new MERL(params);
+    return new MERL(params, args.is_defined("merl-float"));
+}
+
+// Map the table of the MERL file FILENAME, whose header has been read from
+// INPUT, in memory.  Return NULL when the file cannot be mapped.
+static MERL* map_brdf(std::istream& input, const std::string& filename)
+{
+    int dims[3];
+    input.read((char *) &dims, sizeof dims);
+    const size_t n = size_t(dims[0]) * dims[1] * dims[2];
+    if (!input || n != MERL_SIZE)
+        return NULL;
+
+    auto mapped = map_file(filename, sizeof dims, 3 * n * sizeof(double));
+    if (!mapped)
+        return NULL;
+
+    return new MERL(false, mapped);
 }
 
 ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args)
 {
-    MERL* result = new MERL();
+    MERL* result = NULL;
+    if(!args.is_defined("merl-float") && args.is_defined("filename"))
+    {
+        const std::streampos start = input.tellg();
+        result = map_brdf(input, args["filename"]);
+        if(!result)
+        {
+            input.clear();
+            input.seekg(start);
+        }
+    }
 
-    if(!read_brdf(input, result->brdf))
-		{
-        std::cerr << "<<ERROR>> unable to load the data as a MERL file" << std::endl ;
-        throw;
-		}
+    if(!result)
+    {
+        result = new MERL(args.is_defined("merl-float"));
+        if(!read_brdf(input, *result))
+        {
+            std::cerr << "<<ERROR>> unable to load the data as a MERL file" << std::endl ;
+            throw;
+        }
+    }
 
     return result;
 }
@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <vector>
 
 #include "EXR_IO.h"
 
@@ -68,6 +69,13 @@ ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args);
  *  argument when loading the BRDF. The default parametrization is
  *  \ref params::STARK_2D "STARK_2D"
  *
+ *  The pixels are stored in double precision unless <b>--slice-float</b> is
+ *  provided, in which case they are kept in single precision, as in the EXR
+ *  file, which halves the memory used by large slices. Slices are saved as
+ *  uncompressed EXR files with single precision channels, or half precision
+ *  channels when <b>--exr-half</b> is provided. Files are mapped in memory
+ *  when loaded and written one scanline at a time.
+ *
  *  \author Laurent Belcour <laurent.belcour@umontreal.ca>
  *
  */
@@ -76,20 +84,30 @@ class BrdfSlice : public data {
 		const int _width, _height, _slice;
 		vec _max, _min;
 		double _phi;
-		double* _data;
 		bool _reverse;
 
+		// Interleaved RGB pixels, in single precision when _DATA_FLOAT is
+		// not empty.
+		std::vector<double> _data;
+		std::vector<float>  _data_float;
+		bool _half;
+
   public:
 
 		BrdfSlice(const arguments& args,
-              int width, int height, int slice,
-              double* content)
+              int width, int height, int slice)
         : data(brdf_slice_parameters(args),
                width * height * slice),
           _width(width), _height(height), _slice(slice),
-          _data(content)
+          _half(args.is_defined("exr-half"))
 		{
 			// Allocate data
+      const size_t n = 3 * size_t(width) * height * slice;
+      if (args.is_defined("slice-float"))
+          _data_float.assign(n, 0.0f);
+      else
+          _data.assign(n, 0.0);
+
       if (args.is_defined("param") && parametrization().dimX() == 3)
           _phi = (M_PI / 180.0) * args.get_float("phi", 90);
       else
@@ -108,19 +126,16 @@ class BrdfSlice : public data {
 		}
 
 		BrdfSlice(const arguments& args)
-        : BrdfSlice(args, 512, 512, 1,
-                    new double[3 * 512 * 512])
+        : BrdfSlice(args, 512, 512, 1)
     {
     }
 
-		~BrdfSlice()
-		{
-			delete[] _data;
-		}
-
 		void save(const std::string& filename) const
 		{
-			if(!t_EXR_IO<double>::SaveEXR(filename.c_str(), _width, _slice*_height, _data))
+			const bool saved = _data_float.empty()
+				? t_EXR_IO<double>::SaveEXR(filename.c_str(), _width, _slice*_height, _data.data(), 3, _half)
+				: t_EXR_IO<float>::SaveEXR(filename.c_str(), _width, _slice*_height, _data_float.data(), 3, _half);
+			if(!saved)
 			{
 				std::cerr << "<<ERROR>> unable to save image file" << std::endl;
 			}
@@ -145,9 +160,9 @@ class BrdfSlice : public data {
 				res.segment(0, parametrization().dimX()).reverseInPlace();
 			}
 
-			res[parametrization().dimX()+0] = _data[3*id + 0];
-			res[parametrization().dimX()+1] = _data[3*id + 1];
-			res[parametrization().dimX()+2] = _data[3*id + 2];
+			res[parametrization().dimX()+0] = at(3*id + 0);
+			res[parametrization().dimX()+1] = at(3*id + 1);
+			res[parametrization().dimX()+2] = at(3*id + 2);
 
 			return res ;
 		}
@@ -156,9 +171,9 @@ class BrdfSlice : public data {
 		{
 			assert(x.size() == parametrization().dimX() + parametrization().dimY());
 
-			_data[3*id + 0] = x[parametrization().dimX()+0];
-			_data[3*id + 1] = x[parametrization().dimX()+1];
-			_data[3*id + 2] = x[parametrization().dimX()+2];
+			store(3*id + 0, x[parametrization().dimX()+0]);
+			store(3*id + 1, x[parametrization().dimX()+1]);
+			store(3*id + 2, x[parametrization().dimX()+2]);
 		}
 
 		vec value(const vec& x) const
@@ -192,14 +207,28 @@ class BrdfSlice : public data {
 			if(j < 0 || j >= _height) { std::cerr << "<<ERROR>> out of bounds: " << x << std::endl; }
 
 			vec res(3);
-			res[0] = _data[3*id + 0];
-			res[1] = _data[3*id + 1];
-			res[2] = _data[3*id + 2];
+			res[0] = at(3*id + 0);
+			res[1] = at(3*id + 1);
+			res[2] = at(3*id + 2);
 			return res;
 		}
 
   private:
 
+		// Pixel component I, whatever the precision of the storage
+		inline double at(size_t i) const
+		{
+			return _data_float.empty() ? _data[i] : double(_data_float[i]);
+		}
+
+		inline void store(size_t i, double value)
+		{
+			if(_data_float.empty())
+				_data[i] = value;
+			else
+				_data_float[i] = float(value);
+		}
+
 		// Get min and max input space values
 		vec min() const
 		{
@@ -271,11 +300,29 @@ ALTA_DLL_EXPORT data* provide_data(size_t size, const parameters& params,
 
 ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args)
 {
-    int width, height, slice = 1;
-    double *data;
-    t_EXR_IO<double>::LoadEXR(input, width, height, data);
+    const int slice = 1;
+
+    // Decode the file, mapped in memory if possible, then convert its
+    // channels directly into the storage of the slice.
+    EXR_image image;
+    if (!image.load(args["filename"], input))
+    {
+        std::cerr << "<<ERROR>> unable to load image file" << std::endl;
+        return NULL;
+    }
 
-    BrdfSlice* result = new BrdfSlice(args, width, height, slice, data);
+    BrdfSlice* result = new BrdfSlice(args, image.width(), image.height(),
+                                      slice);
+    if (result->_data_float.empty())
+    {
+        double* pix = result->_data.data();
+        image.copy(pix, pix + 1, pix + 2, 3);
+    }
+    else
+    {
+        float* pix = result->_data_float.data();
+        image.copy(pix, pix + 1, pix + 2, 3);
+    }
 
     return result;
 }
@@ -19,12 +19,14 @@
 
 #include <core/common.h>
 #include <core/data.h>
+#include <core/data_storage.h>
 
 #include <iostream>
 #include <fstream>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <vector>
 
 #include "EXR_IO.h"
 
@@ -65,13 +67,19 @@ ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args);
  *
  *  Note that the plugin automatically detect if the file is EXR or binary
  *  using the filename extension. Do not change the extension's name in case
- *  of an OpenEXR file.
+ *  of an OpenEXR file. Binary files are mapped read-only in memory rather
+ *  than read, so that the processes loading the same material share its
+ *  pages. OpenEXR files are mapped as well, and decoded directly into the
+ *  table.
  *
  *  Also, this plugin can be used to export to UTIA file format from ALTA's
  *  internal file format. This can be done using the following command:
  *
  *      data2data --input [file] --in-data [interpolant] --output [file] --out-data data_utia
  *
+ *  The OpenEXR file is written one line at a time, with single precision
+ *  channels, or half precision channels when <b>--exr-half</b> is provided.
+ *
  *  Note that you will have to use an interpolant plugin to fill all the
  *  datapoints of this file format, or use splatting with a dense dataset.
  *  Otherwise, you will have blank data.
@@ -88,12 +96,20 @@ private:
 	int     nti, ntv, npi, npv, planes;
 	int     nPerPlane;
 
-	// Database values
-	double* Bd;
+	// Database values: BD points either to _TABLE or to the mapping of a
+	// binary file.
+	const double* Bd;
+	std::vector<double> _table;
+	std::shared_ptr<const char> _mapped;
+
+	// Export EXR files in half precision
+	bool _half;
 
 public:
-	UTIA(const parameters& params)
-      : data(params, N_PER_PLANE)
+	UTIA(const parameters& params,
+	     const std::shared_ptr<const char>& mapped = std::shared_ptr<const char>(),
+	     bool half = false)
+      : data(params, N_PER_PLANE), _mapped(mapped), _half(half)
   {
 		this->step_t = STEP_T;
 		this->step_p = STEP_P;
@@ -103,7 +119,12 @@ public:
 		this->npv = NPV;
 		this->planes = 3;
 		this->nPerPlane = N_PER_PLANE;
-		this->Bd = new double[planes*nti*npi*ntv*npv];
+		if(_mapped) {
+			this->Bd = (const double*) _mapped.get();
+		} else {
+			_table.assign(planes*nti*npi*ntv*npv, 0.0);
+			this->Bd = _table.data();
+		}
 
 		_min = vec(4);
 	    _min[0] = 0.0;
@@ -118,26 +139,31 @@ public:
 	}
 
 	virtual ~UTIA() {
-		delete[] this->Bd;
+	}
+
+	// Writable table, copied from the mapping first if needed
+	double* table() {
+		if(_mapped) {
+			_table.assign(Bd, Bd + planes*nPerPlane);
+			_mapped.reset();
+			Bd = _table.data();
+		}
+		return _table.data();
 	}
 
 	virtual void save(const std::string& filename) const {
-		/* If the file is an OpenEXR image */
+		/* If the file is an OpenEXR image, write it line by line from the
+		 * planes of the table */
 		if(filename.substr(filename.find_last_of(".") + 1) == "exr") {
 			int W = npi*nti, H = npv*ntv;
-			double* temp = new double[W*H*3];
-
-			/* Data copy */
-			for(int i=0; i<H; ++i)
-				for(int j=0; j<W; ++j){
-					int indexUTIA = i*W+j;
-					int indexEXR  = i*W+j;
-	    			temp[3*indexEXR + 0] = Bd[indexUTIA + 0*nPerPlane];
-	    			temp[3*indexEXR + 1] = Bd[indexUTIA + 1*nPerPlane];
-	    			temp[3*indexEXR + 2] = Bd[indexUTIA + 2*nPerPlane];
-	  			}
-	  		t_EXR_IO<double>::SaveEXR(filename.c_str(), W, H, temp, 3);
-			delete[] temp;
+			EXR_writer writer(filename.c_str(), W, H, _half);
+			for(int i=0; i<H && writer.good(); ++i) {
+				const double* line = Bd + i*W;
+				writer.write_line(line, line + nPerPlane, line + 2*nPerPlane, 1);
+			}
+			if(!writer.close()) {
+				std::cerr << "<<ERROR>> Unable to save to EXR file" << std::endl;
+			}
 		} else {
 			std::ofstream stream(filename.c_str(), std::ios_base::out | std::ios_base::binary);
 			int count = 0;
@@ -298,8 +324,9 @@ public:
 	virtual void set(int i, const vec& x) {
       assert(x.size() == (parametrization().dimX() + parametrization().dimY()));
       const vec& y = x.tail(parametrization().dimY());
+		double* values = table();
 		for(int isp=0; isp<planes; ++isp) {
-			Bd[isp*nPerPlane + i] = y[isp];
+			values[isp*nPerPlane + i] = y[isp];
 		}
 	}
 
@@ -307,44 +334,54 @@ public:
 };
 
 ALTA_DLL_EXPORT data* provide_data(size_t size, const parameters& params,
-                                   const arguments&)
+                                   const arguments& args)
 {
    return new UTIA(alta::parameters(4, 3,
                                     params::SPHERICAL_TL_PL_TV_PV,
-                                    params::RGB_COLOR));
+                                    params::RGB_COLOR),
+                   std::shared_ptr<const char>(),
+                   args.is_defined("exr-half"));
 }
 
 ALTA_DLL_EXPORT data* load_data(std::istream& input, const arguments& args)
 {
-	UTIA* result = new UTIA(alta::parameters(4, 3,
-                                             params::SPHERICAL_TL_PL_TV_PV,
-                                             params::RGB_COLOR));
+	const alta::parameters params(4, 3,
+	                              params::SPHERICAL_TL_PL_TV_PV,
+	                              params::RGB_COLOR);
+	UTIA* result = NULL;
 
 	// Check the filename extension and perform the adequate loading depending
 	// if it is an EXR file or a binary file.
 	std::string filename = args["filename"];
 	if(filename.substr(filename.find_last_of(".") + 1) == "exr") {
-		// EXR data reading
-		double *temp; int W, H;
-    	t_EXR_IO<double>::LoadEXR(input, W, H, temp);
-
-		// Data copy
-		for(int i=0; i<H; ++i)
-			for(int j=0; j<W; ++j){
-				int indexUTIA = i*W+j;
-				int indexEXR  = i*W+j;
-				result->Bd[indexUTIA + 0*N_PER_PLANE] = temp[3*indexEXR + 0];
-				result->Bd[indexUTIA + 1*N_PER_PLANE] = temp[3*indexEXR + 1];
-				result->Bd[indexUTIA + 2*N_PER_PLANE] = temp[3*indexEXR + 2];
-			}
-		delete[] temp;
+		// EXR data reading, from a mapping of the file when possible
+		EXR_image image;
+		if(!image.load(filename, input)) {
+			return NULL;
+		}
+		if(image.width()*image.height() != N_PER_PLANE) {
+			std::cerr << "<<ERROR>> Unexpected EXR image size "
+			          << image.width() << "x" << image.height() << std::endl;
+			return NULL;
+		}
+
+		// The image lines are the lines of the table planes
+		result = new UTIA(params);
+		double* values = result->table();
+		image.copy(values, values + N_PER_PLANE, values + 2*N_PER_PLANE, 1);
 		std::cout << "<<INFO>> Successfully read EXR BRDF file" << std::endl;
 
 	} else {
-		int count = result->planes * result->nti * result->npi
-                                   * result->ntv * result->npv;
-		input.read((char*)result->Bd, count*sizeof(double));
-		std::cout << "<<INFO>> Successfully read binary BRDF file" << std::endl;
+		const size_t count = 3 * size_t(N_PER_PLANE);
+		auto mapped = map_file(filename, 0, count*sizeof(double));
+		if(mapped) {
+			result = new UTIA(params, mapped);
+			std::cout << "<<INFO>> Successfully mapped binary BRDF file" << std::endl;
+		} else {
+			result = new UTIA(params);
+			input.read((char*)result->table(), count*sizeof(double));
+			std::cout << "<<INFO>> Successfully read binary BRDF file" << std::endl;
+		}
 	}
 
     return result;
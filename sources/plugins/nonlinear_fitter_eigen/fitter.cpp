@@ -21,8 +21,12 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <core/common.h>
+#include <core/parametrization_cache.h>
 
 using namespace alta;
 
@@ -31,12 +35,44 @@ ALTA_DLL_EXPORT fitter* provide_fitter()
     return new nonlinear_fitter_eigen();
 }
 
+// Number of rows evaluated at once by a thread.
+static const int chunk_size = 1024;
+
+// Return the cosine factors of the rows of X, given in the D_PARAM
+// parametrization.
+static vec cosines(const Eigen::Ref<const RowMatrixXd>& x, params::input d_param)
+{
+	RowMatrixXd cart(x.rows(), 6);
+	params::convert(x.data(), d_param, params::CARTESIAN, cart.data(),
+	                x.rows(), x.outerStride(), 6);
+	return cart.col(5);
+}
+
+// Return the rows of X, given in the D_PARAM parametrization, in the input
+// space of F.
+static RowMatrixXd abscissae(const Eigen::Ref<const RowMatrixXd>& x,
+                             params::input d_param, const function& f)
+{
+	const params::input f_param = f.parametrization().input_parametrization();
+	if(f_param == d_param)
+	{
+		return x.leftCols(f.parametrization().dimX());
+	}
+
+	RowMatrixXd fx(x.rows(), f.parametrization().dimX());
+	params::convert(x.data(), d_param, f_param, fx.data(),
+	                x.rows(), x.outerStride(), fx.cols());
+	return fx;
+}
+
 struct EigenFunctor: Eigen::DenseFunctor<double>
 {
-	EigenFunctor(const ptr<nonlinear_function>& f, const ptr<data> d, bool use_cosine) :
+	EigenFunctor(const ptr<nonlinear_function>& f, const ptr<data> d, bool use_cosine,
+	             int nb_threads = 0) :
 		Eigen::DenseFunctor<double>(f->nbParameters(),
                                 d->parametrization().dimY()*d->size()),
-      _f(f), _d(d), _cosine(use_cosine)
+      _f(f), _d(d), _cosine(use_cosine), _nb_threads(nb_threads),
+      _cache(*d, f->parametrization(), use_cosine)
 	{
 #ifndef DEBUG
 		std::cout << "<<DEBUG>> constructing an EigenFunctor for n=" << inputs() << " parameters and m=" << values() << " points" << std::endl ;
@@ -66,42 +102,30 @@ struct EigenFunctor: Eigen::DenseFunctor<double>
 		for(int i=0; i<inputs(); ++i) { _p[i] = x(i); }
 		_f->setParameters(_p);
 
-		const int nx = _f->parametrization().dimX();
 		const int ny = _f->parametrization().dimY();
+		const int dX = _d->parametrization().dimX();
 
-		for(int s=0; s<_d->size(); ++s)
+		// Read the data block by block so that it need not be resident, and
+		// evaluate the function on chunks of the block in parallel.  Each
+		// chunk fills its own rows of Y.
+		for_each_block(*_d, [&](int first, const RowMatrixXd& block)
 		{
-			vec _x  = _d->get(s);
-		
-			// Convert the sample point into the function space
-			vec x(nx);
-			params::convert(&_x[0],
-                      _d->parametrization().input_parametrization(),
-                      _f->parametrization().input_parametrization(),
-                      &x[0]);
-
-			// Compute the cosine factor. Only update the constant if the flag
-			// is set in the object.
-			double cos = 1.0;
-			if(_cosine)
+			parallel_for_chunks(block.rows(), chunk_size,
+			                    [&](int, int from, int rows)
 			{
-				double cart[6];
-        params::convert(&_x[0],
-                        _d->parametrization().input_parametrization(),
-                        params::CARTESIAN, cart);
-				cos = cart[5];
-			}
-
-			vec _di = vec(ny);
-			for(int i=0; i<ny; ++i)
-				_di[i] = _x[_d->parametrization().dimX() + i];
+				const auto cos = _cache.cosines().segment(first + from, rows);
 
-			// Should add the resulting vector completely
-			vec _y = _di - cos*_f->value(x);
-			for(int i=0; i<ny; ++i)
-				y(i*_d->size() + s) = _y[i];
+				RowMatrixXd fy(rows, ny);
+				_f->values(_cache.abscissae().middleRows(first + from, rows), fy);
 
-		}
+				for(int i=0; i<ny; ++i)
+				{
+					y.segment(i*_d->size() + first + from, rows) =
+						block.col(dX + i).segment(from, rows)
+						- cos.cwiseProduct(fy.col(i));
+				}
+			}, _nb_threads);
+		});
 #ifdef DEBUG
 		std::cout << "diff vector:" << std::endl << y << std::endl << std::endl ;
 #endif
@@ -116,64 +140,51 @@ struct EigenFunctor: Eigen::DenseFunctor<double>
 		for(int i=0; i<inputs(); ++i) { _p[i] = x(i); }
 		_f->setParameters(_p);
 
-		// For each element to fit, fill the rows of the matrix
-		for(int s=0; s<_d->size(); ++s)
+		const int np = _f->nbParameters();
+		const int ny = _f->parametrization().dimY();
+
+		// Evaluate the Jacobians on chunks of the abscissae in parallel and
+		// fill the rows of the matrix
+		parallel_for_chunks(_d->size(), chunk_size, [&](int, int first, int rows)
 		{
-			// Get the position
-			vec xi = _d->get(s);
-			
-			// Convert the sample point into the function space
-			vec x(_f->parametrization().dimX());
-			params::convert(&xi[0],
-                      _d->parametrization().input_parametrization(),
-                      _f->parametrization().input_parametrization(),
-                      &x[0]);
-
-			// Compute the cosine factor. Only update the constant if the flag
-			// is set in the object.
-			double cos = 1.0;
-			if(_cosine)
-			{
-				double cart[6]; params::convert(&xi[0],
-                                        _d->parametrization().input_parametrization(),
-                                        params::CARTESIAN,
-                                        cart);
-				cos = cart[5];
-			}
+			const auto cos = _cache.cosines().segment(first, rows);
 
-			// Get the associated jacobian
-			vec _jac = _f->parametersJacobian(x);
+			RowMatrixXd jac(rows, ny*np);
+			_f->parametersJacobians(_cache.abscissae().middleRows(first, rows), jac);
 
-			// Fill the columns of the matrix
-			for(int j=0; j<_f->nbParameters(); ++j)
+			// For each output channel, update the subpart of the matrix
+			for(int i=0; i<ny; ++i)
 			{
-				// For each output channel, update the subpart of the
-				// vector row
-				for(int i=0; i<_f->parametrization().dimY(); ++i)
-				{
-					fjac(i*_d->size() + s, j) = - cos * _jac[i*_f->nbParameters() + j];
-				}
+				fjac.block(i*_d->size() + first, 0, rows, np) =
+					-(jac.middleCols(i*np, np).array().colwise() * cos.array());
 			}
-		}
+		}, _nb_threads);
 		return 0;
 	}
 
-
 	const ptr<nonlinear_function>& _f;
 	const ptr<data> _d;
 
 	// Flags
 	bool _cosine;
+
+	// Threads evaluating the chunks, the OpenMP default if zero
+	int _nb_threads;
+
+	// Abscissae of the data in the function space
+	const parametrization_cache _cache;
 };
 
 struct CompoundFunctor: Eigen::DenseFunctor<double>
 {
-	CompoundFunctor(compound_function* f, int index, const ptr<data> d, bool use_cosine) :
+	CompoundFunctor(compound_function* f, int index, const ptr<data> d, bool use_cosine,
+	                int nb_threads = 0) :
 		Eigen::DenseFunctor<double>((*f)[index]->nbParameters(), d->parametrization().dimY()*d->size()), 
 		_f(f), 
 		_d(d), 
 		_cosine(use_cosine),
-		_index(index)
+		_index(index),
+		_nb_threads(nb_threads)
 	{
 #ifndef DEBUG
 		std::cout << "<<DEBUG>> constructing an EigenFunctor for n=" << inputs() << " parameters and m=" << values() << " points" << std::endl ;
@@ -192,53 +203,37 @@ struct CompoundFunctor: Eigen::DenseFunctor<double>
 		nonlinear_function* f = (*_f)[_index];
 		f->setParameters(_p);
 
-		for(int s=0; s<_d->size(); ++s)
-		{
-			vec _x  = _d->get(s);
+		const int ny = f->parametrization().dimY();
+		const int dX = _d->parametrization().dimX();
+		const params::input d_param = _d->parametrization().input_parametrization();
 
-			// Compute the cosine factor. Only update the constant if the flag
-			// is set in the object.
-			double cos = 1.0;
-			if(_cosine)
+		for_each_block(*_d, [&](int first, const RowMatrixXd& block)
+		{
+			parallel_for_chunks(block.rows(), chunk_size,
+			                    [&](int, int from, int rows)
 			{
-				double cart[6]; params::convert(&_x[0],
-                                        _d->parametrization().input_parametrization(),
-                                        params::CARTESIAN,
-                                        cart);
-				cos = cart[5];
-			}
+				const auto x = block.middleRows(from, rows);
 
-			vec _di = vec(f->parametrization().dimY());
-			for(int i=0; i<f->parametrization().dimY(); ++i)
-				_di[i] = _x[f->parametrization().dimX() + i];
+				// Compute the cosine factor. Only update the constant if the
+				// flag is set in the object.
+				const vec cos = _cosine ? cosines(x, d_param) : vec(vec::Ones(rows));
 
-			// Compute the value of the preceding functions
-			vec _fy = vec::Zero(f->parametrization().dimY());
-			for(int i=0; i<_index+1; ++i)
-			{
-                const nonlinear_function* f = (*_f)[i];
-                if(f->parametrization().input_parametrization() != _d->parametrization().input_parametrization())
-                {
-                    vec x(f->parametrization().dimX());
-                    params::convert(&_x[0],
-                                    _d->parametrization().input_parametrization(),
-                                    f->parametrization().input_parametrization(),
-                                    &x[0]);
-
-                    _fy += (*f)(x);
-                }
-                else
-                {
-                    _fy += (*f)(_x);
-                }
-			}
-
-			// Should add the resulting vector completely
-			vec _y = _di - cos*_fy;
-			for(int i=0; i<f->parametrization().dimY(); ++i)
-				y(i*_d->size() + s) = _y[i];
+				// Compute the value of the preceding functions
+				RowMatrixXd fy = RowMatrixXd::Zero(rows, ny), fi(rows, ny);
+				for(int k=0; k<_index+1; ++k)
+				{
+					const nonlinear_function* g = (*_f)[k];
+					g->values(abscissae(x, d_param, *g), fi);
+					fy += fi;
+				}
 
-		}
+				for(int i=0; i<ny; ++i)
+				{
+					y.segment(i*_d->size() + first + from, rows) =
+						x.col(dX + i) - cos.cwiseProduct(fy.col(i));
+				}
+			}, _nb_threads);
+		});
 #ifdef DEBUG
 		std::cout << "diff vector:" << std::endl << y << std::endl << std::endl ;
 #endif
@@ -255,53 +250,34 @@ struct CompoundFunctor: Eigen::DenseFunctor<double>
 		nonlinear_function* f = (*_f)[_index];
 		f->setParameters(_p);
 
-		// For each element to fit, fill the rows of the matrix
-		for(int s=0; s<_d->size(); ++s)
-		{
-			// Get the position
-			vec xi = _d->get(s);
+		const int np = f->nbParameters();
+		const int ny = _f->parametrization().dimY();
+		const params::input d_param = _d->parametrization().input_parametrization();
 
-			// Compute the cosine factor. Only update the constant if the flag
-			// is set in the object.
-			double cos = 1.0;
-			if(_cosine)
+		// For each chunk of elements to fit, evaluate the Jacobians at once
+		// and fill the rows of the matrix
+		for_each_block(*_d, [&](int first, const RowMatrixXd& block)
+		{
+			parallel_for_chunks(block.rows(), chunk_size,
+			                    [&](int, int from, int rows)
 			{
-				double cart[6]; params::convert(&xi[0],
-                                        _d->parametrization().input_parametrization(),
-                                        params::CARTESIAN,
-                                        cart);
-				cos = cart[5];
-			}
+				const auto x = block.middleRows(from, rows);
 
-			// Get the associated jacobian
-            vec _jac;
-            if(f->parametrization().input_parametrization() != _d->parametrization().input_parametrization())
-            {
-                vec x(f->parametrization().dimX());
-                params::convert(&xi[0],
-                                _d->parametrization().input_parametrization(),
-                                f->parametrization().input_parametrization(),
-                                &x[0]);
-
-                _jac = f->parametersJacobian(x);
-            }
-            else
-            {
-                _jac = f->parametersJacobian(xi);
-            }
-
-
-			// Fill the columns of the matrix
-			for(int j=0; j<f->nbParameters(); ++j)
-			{
-				// For each output channel, update the subpart of the
-				// vector row
-				for(int i=0; i<_f->parametrization().dimY(); ++i)
+				// Compute the cosine factor. Only update the constant if the
+				// flag is set in the object.
+				const vec cos = _cosine ? cosines(x, d_param) : vec(vec::Ones(rows));
+
+				RowMatrixXd jac(rows, ny*np);
+				f->parametersJacobians(abscissae(x, d_param, *f), jac);
+
+				// For each output channel, update the subpart of the matrix
+				for(int i=0; i<ny; ++i)
 				{
-					fjac(i*_d->size() + s, j) = - cos * _jac[i*f->nbParameters() + j];
+					fjac.block(i*_d->size() + first + from, 0, rows, np) =
+						-(jac.middleCols(i*np, np).array().colwise() * cos.array());
 				}
-			}
-		}
+			}, _nb_threads);
+		});
 		return 0;
 	}
 
@@ -312,6 +288,9 @@ struct CompoundFunctor: Eigen::DenseFunctor<double>
 	// Flags
 	bool _cosine;
 	int _index;
+
+	// Threads evaluating the chunks, the OpenMP default if zero
+	int _nb_threads;
 };
 
 nonlinear_fitter_eigen::nonlinear_fitter_eigen() 
@@ -345,6 +324,12 @@ bool nonlinear_fitter_eigen::fit_data(const ptr<data>& d, ptr<function>& fit, co
 		 return true;
 	 }
 
+#ifdef _OPENMP
+    const int nb_cores = args.get_int("nb-cores", omp_get_num_procs());
+#else
+    const int nb_cores = 1;
+#endif
+
     /* the following starting values provide a rough fit. */
     vec nf_x = nf->parameters();
 
@@ -356,7 +341,7 @@ bool nonlinear_fitter_eigen::fit_data(const ptr<data>& d, ptr<function>& fit, co
 			 x[i] = nf_x[i];
 		 }
 
-		 EigenFunctor functor(nf, d, args.is_defined("fit-with-cosine"));
+		 EigenFunctor functor(nf, d, args.is_defined("fit-with-cosine"), nb_cores);
 		 Eigen::LevenbergMarquardt<EigenFunctor> lm(functor);
 
 		 info = lm.minimize(x);
@@ -36,6 +36,10 @@ using namespace alta;
  *	 + `--fit-compound` to control how the fitting procedure is done. If this
  *	 flag is set, any compound function will be decomposed during the fit. The
  *	 fitting will be done incrementally. *in progress*
+ *	 + `--nb-cores` *[int]* number of threads used to evaluate the residuals
+ *	 and their Jacobian (all the available cores by default). The function
+ *	 is evaluated concurrently on distinct samples, and the results do not
+ *	 depend on the number of threads.
  */
 class nonlinear_fitter_eigen: public fitter
 {
@@ -22,8 +22,12 @@
 #include <limits>
 #include <algorithm>
 #include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <core/common.h>
+#include <core/parametrization_cache.h>
 
 using namespace alta;
 
@@ -32,10 +36,15 @@ ALTA_DLL_EXPORT fitter* provide_fitter()
     return new nonlinear_fitter_ipopt();
 }
 
+// Number of rows evaluated at once by a thread.
+static const int chunk_size = 1024;
+
 class altaNLP : public Ipopt::TNLP
 {
 	public:
-		altaNLP(const ptr<nonlinear_function>& f, const ptr<data>& d) : TNLP(), _f(f), _d(d)
+		altaNLP(const ptr<nonlinear_function>& f, const ptr<data>& d,
+		        int nb_threads = 0) : TNLP(), _d(d), _f(f),
+			_cache(*d, f->parametrization()), _nb_threads(nb_threads)
 		{
 		}
 
@@ -104,36 +113,27 @@ class altaNLP : public Ipopt::TNLP
 			for(int i=0; i<n; ++i) { _p[i] = x[i]; }
 			_f->setParameters(_p);
 
+			// This plugin can for the moment only account for function and data
+			// of the same output size. TODO: Add conversion between spaces.
+			assert(_d->parametrization().dimY() == _f->parametrization().dimY());
+			const int dDimX = _d->parametrization().dimX();
+			const int ny = _f->parametrization().dimY();
+
+			// Evaluate the function on chunks of data in parallel, and sum the
+			// per-chunk errors in a fixed order
 			obj_value = 0.0;
-			for(int s=0; s<_d->size(); ++s)
+			for_each_block(*_d, [&](int first, const RowMatrixXd& block)
 			{
-				vec _x = _d->get(s);
-
-				// This plugin can for the moment only account for function and data
-				// of the same output size. TODO: Add conversion between spaces.
-				assert(_d->parametrization().dimY() == _f->parametrization().dimY());
-				const int dDimX = _d->parametrization().dimX();
-
-				// Extract the objective from the current vector
-				vec _di = vec(_f->parametrization().dimY());
-				for(int i=0; i<_f->parametrization().dimY(); ++i)
-				{
-					_di[i] = _x[dDimX + i];
-				}
-
-				// Convert the sample point into the function space
-				vec x(_f->parametrization().dimX());
-				params::convert(&_x[0], _d->parametrization().input_parametrization(),
-                        _f->parametrization().input_parametrization(), &x[0]);
-
 				// Compute the difference vector and add its
 				// components to the obj_value
-				vec _y = _di - _f->value(x);
-				for(int i=0; i<_f->parametrization().dimY(); ++i)
+				obj_value += parallel_sum_chunks(block.rows(), chunk_size, 0.0,
+				                                 [&](int from, int rows)
 				{
-					obj_value += pow(_y[i], 2);
-				}
-			}
+					RowMatrixXd fy(rows, ny);
+					_f->values(_cache.abscissae().middleRows(first + from, rows), fy);
+					return (block.block(from, dDimX, rows, ny) - fy).squaredNorm();
+				}, _nb_threads);
+			});
 
 			return true;
 		}
@@ -146,47 +146,41 @@ class altaNLP : public Ipopt::TNLP
 			for(int i=0; i<n; ++i) { _p[i] = x[i]; }
 			_f->setParameters(_p);
 
+			const int dDimX = _d->parametrization().dimX();
+			const int ny = _f->parametrization().dimY();
+
 			// Clean the value
-			for(int i=0; i<n; ++i) { grad_f[i] = 0.0; }
+			Eigen::Map<vec> grad(grad_f, n);
+			grad.setZero();
 
-			// Add all the gradients
-			for(int s=0; s<_d->size(); ++s)
+			// Add all the gradients, evaluating the function and its
+			// Jacobian on chunks of data in parallel, and summing the
+			// per-chunk gradients in a fixed order
+			for_each_block(*_d, [&](int first, const RowMatrixXd& block)
 			{
-				vec _x = _d->get(s);
-
-				const int dDimX = _d->parametrization().dimX();
-
-				// Extract the objective from the current vector
-				vec _di = vec(_f->parametrization().dimY());
-				for(int i=0; i<_f->parametrization().dimY(); ++i)
+				grad += parallel_sum_chunks(block.rows(), chunk_size,
+				                            vec(vec::Zero(n)),
+				                            [&](int from, int rows)
 				{
-					_di[i] = _x[dDimX + i];
-				}
-				
-				// Convert the sample point into the function space
-				vec x(_f->parametrization().dimX());
-				params::convert(&_x[0], _d->parametrization().input_parametrization(),
-                        _f->parametrization().input_parametrization(), &x[0]);
+					const auto abscissae =
+						_cache.abscissae().middleRows(first + from, rows);
 
-				// Compute the difference vector and add its
-				// components to the obj_value
-				vec _y = _f->value(x) - _di;
+					RowMatrixXd fy(rows, ny), jac(rows, ny*n);
+					_f->values(abscissae, fy);
+					_f->parametersJacobians(abscissae, jac);
 
-				// Get the jacobian of the function at position x_i for the current
-				// set of parameters (set prior to function call)
-				vec _jac = _f->parametersJacobian(x);
+					// Compute the difference vector
+					fy -= block.block(from, dDimX, rows, ny);
 
-				// Fill the columns of the matrix
-				for(int j=0; j<_f->nbParameters(); ++j)
-				{
-					// For each output channel, update the subpart of the
-					// vector row
-					for(int i=0; i<_f->parametrization().dimY(); ++i)
+					// For each output channel, update the gradient
+					vec g = vec::Zero(n);
+					for(int i=0; i<ny; ++i)
 					{
-						grad_f[j] += 2 * _y[i] * _jac[i*_f->nbParameters() + j];
+						g += 2 * jac.middleCols(i*n, n).transpose() * fy.col(i);
 					}
-				}
-			}
+					return g;
+				}, _nb_threads);
+			});
 
 			return true;
 		}
@@ -232,6 +226,12 @@ class altaNLP : public Ipopt::TNLP
 
 		const ptr<data>& _d;
 		const ptr<nonlinear_function>& _f;
+
+		// Abscissae of the data in the function space
+		const parametrization_cache _cache;
+
+		// Threads evaluating the chunks, the OpenMP default if zero
+		const int _nb_threads;
 };
 
 nonlinear_fitter_ipopt::nonlinear_fitter_ipopt() 
@@ -265,11 +265,17 @@ bool nonlinear_fitter_ipopt::fit_data(const ptr<data>& d, ptr<function>& fit, co
 		return true;
 	}
 
+#ifdef _OPENMP
+	const int nb_cores = args.get_int("nb-cores", omp_get_num_procs());
+#else
+	const int nb_cores = 1;
+#endif
+
 	/* the following starting values provide a rough fit. */
 	vec p = nf->parameters();
 
 	// Create the problem
-	Ipopt::SmartPtr<Ipopt::TNLP> nlp = new altaNLP(nf, d);
+	Ipopt::SmartPtr<Ipopt::TNLP> nlp = new altaNLP(nf, d, nb_cores);
 	Ipopt::SmartPtr<Ipopt::IpoptApplication> app = IpoptApplicationFactory();
 
 
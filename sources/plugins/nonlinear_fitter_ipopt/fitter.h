@@ -45,6 +45,9 @@ using namespace alta;
  *		linear solver that will be used during matrix operations. See
  *		<a href="http://www.coin-or.org/Ipopt/documentation/node50.html">
  *		here</a> for the list of possible choices.</li>
+ *		<li><b>--nb-cores</b> <em>[int]</em> number of threads used to
+ *		evaluate the objective and its gradient. The result does not depend
+ *		on the number of threads.</li>
  *  </ul>
  *
  */
@@ -19,8 +19,12 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <core/common.h>
+#include <core/parametrization_cache.h>
 
 using namespace alta;
 
@@ -29,6 +33,9 @@ ALTA_DLL_EXPORT fitter* provide_fitter()
 	return new nonlinear_fitter_nlopt();
 }
 
+// Number of rows evaluated at once by a thread.
+static const int chunk_size = 1024;
+
 void print_nlopt_error(nlopt_result res, const std::string& string)
 {
 	if(res == NLOPT_FAILURE)
@@ -47,53 +54,52 @@ void print_nlopt_error(nlopt_result res, const std::string& string)
 
 // The parameter of the function _f should be set prior to this function
 // call. If not it will produce undesirable results.
-void df(double* fjac, const nonlinear_function* f, const data* d)
+void df(double* fjac, const nonlinear_function* f, const data* d,
+        const parametrization_cache& cache, int nb_threads)
 {
+	const int np = f->nbParameters();
+	const int ny = f->parametrization().dimY();
+	const int dX = d->parametrization().dimX();
+
 	// Clean memory
-	memset(fjac, 0.0, f->nbParameters()*sizeof(double));
+	Eigen::Map<vec> grad(fjac, np);
+	grad.setZero();
 
-	// Each constraint is of the form data point * color channel
-	for(int s=0; s<d->size(); ++s)
+	// Each constraint is of the form data point * color channel. Evaluate
+	// the function and its Jacobian on chunks of data in parallel, and sum
+	// the per-chunk gradients in a fixed order.
+	for_each_block(*d, [&](int first, const RowMatrixXd& block)
 	{
-		// Get the data sample and extract the value part
-		vec xi = d->get(s);
-		vec _di = vec(d->parametrization().dimY());
-		for(int i=0; i<d->parametrization().dimY(); ++i)
-		{
-			_di[i] = xi[d->parametrization().dimX() + i];
-		}
-		
-		// Convert the sample point into the function space
-		vec x(f->parametrization().dimX());
-		params::convert(&xi[0],
-                    d->parametrization().input_parametrization(),
-                    f->parametrization().input_parametrization(),
-                    &x[0]);
- 
-		// Get the jacobian of the function at position x_i for the current
-		// set of parameters (set prior to function call)
-		vec _jac = f->parametersJacobian(x);
-
-		// Should add the resulting vector completely
-		vec _y = (*f)(x) - _di;
-
-		// Fill the columns of the matrix
-		for(int j=0; j<f->nbParameters(); ++j)
+		grad += parallel_sum_chunks(block.rows(), chunk_size, vec(vec::Zero(np)),
+		                            [&](int from, int rows)
 		{
-			// For each output channel, update the subpart of the
-			// vector row
-			for(int i=0; i<f->parametrization().dimY(); ++i)
+			const auto x = cache.abscissae().middleRows(first + from, rows);
+
+			RowMatrixXd fy(rows, ny), jac(rows, ny*np);
+			f->values(x, fy);
+			f->parametersJacobians(x, jac);
+
+			// Should add the resulting vector completely
+			fy -= block.block(from, dX, rows, ny);
+
+			// For each output channel, update the gradient
+			vec g = vec::Zero(np);
+			for(int i=0; i<ny; ++i)
 			{
-				fjac[j] += 2 * _y[i] * _jac[i*f->nbParameters() + j];
+				g += 2 * jac.middleCols(i*np, np).transpose() * fy.col(i);
 			}
-		}
-	}
+			return g;
+		}, nb_threads);
+	});
 }
 
 double f(unsigned n, const double* x, double* dy, void* dat)
 {
 	nonlinear_function* _f = (nonlinear_function*)(((void**)dat)[0]);
 	const data* _d = (const data*)(((void**)dat)[1]);
+	const parametrization_cache* _cache =
+		(const parametrization_cache*)(((void**)dat)[2]);
+	const int nb_threads = *(const int*)(((void**)dat)[3]);
 
 	// Update the parameters vector
 	vec _p(_f->nbParameters());
@@ -103,35 +109,26 @@ double f(unsigned n, const double* x, double* dy, void* dat)
 	// Create the result vector
 	double y = 0.0;
 
-	// Each constraint is of the form data point * color channel
-	for(int s=0; s<_d->size(); ++s)
+	const int ny = _f->parametrization().dimY();
+	const int dX = _d->parametrization().dimX();
+
+	// Each constraint is of the form data point * color channel. Evaluate
+	// the function on chunks of data in parallel, and sum the per-chunk
+	// errors in a fixed order.
+	for_each_block(*_d, [&](int first, const RowMatrixXd& block)
 	{
-		// Get the data sample and extract the value part
-		vec xi = _d->get(s);
-		vec _di = vec(_d->parametrization().dimY());
-		for(int i=0; i<_d->parametrization().dimY(); ++i)
-		{
-			_di[i] = xi[_d->parametrization().dimX() + i];
-		}
-
-		// Convert the sample point into the function space
-		vec x(_f->parametrization().dimX());
-		params::convert(&xi[0],
-                    _d->parametrization().input_parametrization(),
-                    _f->parametrization().input_parametrization(),
-                    &x[0]);
-
-		// Should add the resulting vector completely
-		vec _y = (*_f)(x) - _di;
-		for(int i=0; i<_f->parametrization().dimY(); ++i)
+		y += parallel_sum_chunks(block.rows(), chunk_size, 0.0,
+		                         [&](int from, int rows)
 		{
-			y += pow(_y[i], 2);
-		}
-	}
+			RowMatrixXd fy(rows, ny);
+			_f->values(_cache->abscissae().middleRows(first + from, rows), fy);
+			return (fy - block.block(from, dX, rows, ny)).squaredNorm();
+		}, nb_threads);
+	});
 
 	if(dy != NULL)
 	{
-		df(dy, _f, _d);
+		df(dy, _f, _d, *_cache, nb_threads);
 	}
 
 	return y;
@@ -169,6 +166,12 @@ bool nonlinear_fitter_nlopt::fit_data(const ptr<data>& d, ptr<function>& fit, co
 		return true;
 	}
 
+#ifdef _OPENMP
+	const int nb_cores = args.get_int("nb-cores", omp_get_num_procs());
+#else
+	const int nb_cores = 1;
+#endif
+
 	// the following starting values provide a rough fit is the bootstrap flag is
 	// enabled
 	vec p = nf->parameters();
@@ -274,10 +277,15 @@ bool nonlinear_fitter_nlopt::fit_data(const ptr<data>& d, ptr<function>& fit, co
 	}
 
 
+	// Convert the abscissae of the data once for the whole fit
+	const parametrization_cache cache(*d, nf->parametrization());
+
 	// Create the problem
-	void* dat[2];
+	void* dat[4];
 	dat[0] = (void*)nf.get();
 	dat[1] = (void*)d.get();
+	dat[2] = (void*)&cache;
+	dat[3] = (void*)&nb_cores;
 	res = nlopt_set_min_objective(opt, f, dat);
 	if(res < 0)
 	{
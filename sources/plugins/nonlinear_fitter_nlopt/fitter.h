@@ -50,6 +50,9 @@ using namespace alta;
  *     `10`.
  *   + '--nlop-relative-function-tolerance [float]'. Default value is 1e-4.
  *   + '--nlop-abs-function-tolerance [float]'. Default valie is 1e-6.
+ *   + `--nb-cores [int]` number of threads used to evaluate the objective
+ *     and its gradient (all the available cores by default). The result
+ *     does not depend on the number of threads.
  *
  *  [nlopt]: http://ab-initio.mit.edu/wiki/index.php/NLopt
  *  [optimizers]: http://ab-initio.mit.edu/wiki/index.php/NLopt
@@ -69,29 +69,39 @@ vec beckmann_function::operator()(const vec& x) const
 }
 vec beckmann_function::value(const vec& x) const 
 {
-	double h[3];
-	params::convert(&x[0], params::CARTESIAN, params::RUSIN_VH, &h[0]);
-
-	// Compute the Shadow term to init res
-	vec res = vec::Zero(_parameters.dimY()); //G(x);
+	vec res(_parameters.dimY());
+	values(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+	       Eigen::Map<RowMatrixXd>(&res[0], 1, res.size()));
+	return res;
+}
 
-	for(int i=0; i<_parameters.dimY(); ++i)
+void beckmann_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                               Eigen::Ref<RowMatrixXd> y) const
+{
+	for(int n=0; n<x.rows(); ++n)
 	{
-		const double a    = _a[i];
-		const double a2   = a*a;
-		const double dh2  = h[2]*h[2];
-		const double expo = exp((dh2 - 1.0) / (a2 * dh2));
+		const double* xn = x.row(n).data();
 
-		if(h[2] > 0.0 && x[2]*x[5]>0.0)
-		{
-			res[i] = _ks[i] / (4.0 /* x[2]*x[5] */* M_PI * a2 * dh2*dh2) * expo;
-		}
-		else
+		double h[3];
+		params::convert(xn, params::CARTESIAN, params::RUSIN_VH, &h[0]);
+
+		const double dh2 = h[2]*h[2];
+		const bool visible = h[2] > 0.0 && xn[2]*xn[5] > 0.0;
+
+		for(int i=0; i<_parameters.dimY(); ++i)
 		{
-			res[i] = 0.0; 
+			if(visible)
+			{
+				const double a2   = _a[i]*_a[i];
+				const double expo = exp((dh2 - 1.0) / (a2 * dh2));
+				y(n, i) = _ks[i] / (4.0 /* x[2]*x[5] */* M_PI * a2 * dh2*dh2) * expo;
+			}
+			else
+			{
+				y(n, i) = 0.0;
+			}
 		}
 	}
-	return res;
 }
 
 //! Number of parameters to this non-linear function
@@ -140,40 +150,45 @@ void beckmann_function::setParameters(const vec& p)
 //! \todo finish. 
 vec beckmann_function::parametersJacobian(const vec& x) const 
 {
-	double h[3];
-	params::convert(&x[0], params::CARTESIAN, params::RUSIN_VH, h);
+	vec jac(_parameters.dimY()*nbParameters());
+	parametersJacobians(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+	                    Eigen::Map<RowMatrixXd>(&jac[0], 1, jac.size()));
+	return jac;
+}
+
+void beckmann_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                            Eigen::Ref<RowMatrixXd> jac) const
+{
+	const int nY = _parameters.dimY();
+	const int nbParams = nbParameters();
 
-	// Get the geometry term
-	//vec g = G(x);
+	jac.setZero();
+	for(int n=0; n<x.rows(); ++n)
+	{
+		const double* xn = x.row(n).data();
+		double* jn = jac.row(n).data();
 
-    vec jac(_parameters.dimY()*nbParameters());
-	 for(int i=0; i<_parameters.dimY(); ++i)
-	 {
-		 for(int j=0; j<_parameters.dimY(); ++j)
-		 {
-			 if(i == j && h[2]>0.0 && x[2]*x[5]>0.0)
-			 {
-				 const double a    = _a[i];
-				 const double a2   = a*a;
-				 const double dh2  = h[2]*h[2];
-				 const double expo = exp((dh2 - 1.0) / (a2 * dh2));
-				 const double fac  = (4.0 /* x[2]*x[5] */* M_PI * a2 * dh2*dh2);
-
-				 // df / dk_s
-				 jac[i*nbParameters() + j*2+0] = /*g[i] */ expo / fac;
-
-				 // df / da_x
-				 jac[i*nbParameters() + j*2+1] = -/* g[i] */ _ks[i] * (expo/(4.0/*x[2]*x[5]*/)) * ((2* a * h[2])/(M_PI*a2*a2*dh2)) * (1 + (dh2 - 1.0)*h[2]/(a2*dh2*h[2]));
-			 }
-			 else
-			 {
-				 jac[i*nbParameters() + j*2+0] = 0.0;
-				 jac[i*nbParameters() + j*2+1] = 0.0;
-			 }
-		 }
-	 }
+		double h[3];
+		params::convert(xn, params::CARTESIAN, params::RUSIN_VH, h);
 
-    return jac;
+		if(!(h[2]>0.0 && xn[2]*xn[5]>0.0))
+			continue;
+
+		const double dh2 = h[2]*h[2];
+		for(int i=0; i<nY; ++i)
+		{
+			const double a    = _a[i];
+			const double a2   = a*a;
+			const double expo = exp((dh2 - 1.0) / (a2 * dh2));
+			const double fac  = (4.0 /* x[2]*x[5] */* M_PI * a2 * dh2*dh2);
+
+			// df / dk_s
+			jn[i*nbParams + i*2+0] = /*g[i] */ expo / fac;
+
+			// df / da_x
+			jn[i*nbParams + i*2+1] = -/* g[i] */ 2.0 * _ks[i] * (expo / (fac * a)) * (1 + (dh2 - 1.0)/(a2*dh2));
+		}
+	}
 }
 		
 void beckmann_function::bootstrap(const ptr<data> d, const arguments& args)
@@ -43,6 +43,8 @@ class beckmann_function : public nonlinear_function
 		// Overload the function operator
 		virtual vec operator()(const vec& x) const ;
 		virtual vec value(const vec& x) const ;
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
 
 		// Geometrical term of the microfacets
 		virtual vec G(const vec& x) const;
@@ -74,6 +76,8 @@ class beckmann_function : public nonlinear_function
 		//! \brief Obtain the derivatives of the function with respect to the
 		//! parameters. 
 		virtual vec parametersJacobian(const vec& x) const ;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 	private: // data
 
@@ -43,20 +43,23 @@ vec blinn_function::operator()(const vec& x) const
 vec blinn_function::value(const vec& x) const 
 {
     vec res(_parameters.dimY());
-    for(int i=0; i<_parameters.dimY(); ++i)
+    values(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+           Eigen::Map<RowMatrixXd>(&res[0], 1, res.size()));
+    return res;
+}
+
+void blinn_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                            Eigen::Ref<RowMatrixXd> y) const
+{
+    for(int n=0; n<x.rows(); ++n)
     {
-		 // Check if the cosine is below the hoziron
-		 if(x[0] > 0.0)
-		 {
-			 res[i] = _ks[i] * std::pow(x[0], _N[i]);
-		 }
-		 else
-		 {
-			 res[i] = 0.0;
-		 }
+        const double cosine = x(n, 0);
+        for(int i=0; i<_parameters.dimY(); ++i)
+        {
+            // Check if the cosine is below the hoziron
+            y(n, i) = cosine > 0.0 ? _ks[i] * std::pow(cosine, _N[i]) : 0.0;
+        }
     }
-
-    return res;
 }
 
 //! Load function specific files
@@ -143,35 +146,37 @@ void blinn_function::setParameters(const vec& p)
 //! parameters. 
 vec blinn_function::parametersJacobian(const vec& x) const 
 {
-    vec jac(_parameters.dimY()*nbParameters());
-	 for(int i=0; i<_parameters.dimY(); ++i)
-		 for(int j=0; j<_parameters.dimY(); ++j)
-		 {
-			 if(i == j)
-			 {
-				 // Test if the configuration is below the horizon
-				 if(x[0] <= 0.0)
-				 {
-					jac[i*nbParameters() + j*2+0] = 0.0;
-					jac[i*nbParameters() + j*2+1] = 0.0;
-				 }
-				 else
-				 {
-					 // df / dk_s
-					 jac[i*nbParameters() + j*2+0] = std::pow(x[0], _N[j]);
-
-					 // df / dN
-					 jac[i*nbParameters() + j*2+1] = _ks[j] * log(x[0]) * std::pow(x[0], _N[j]);
-				 }
-			 }
-			 else
-			 {
-				 jac[i*nbParameters() + j*2+0] = 0.0;
-				 jac[i*nbParameters() + j*2+1] = 0.0;
-			 }
-		 }
+	vec jac(_parameters.dimY()*nbParameters());
+	parametersJacobians(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+	                    Eigen::Map<RowMatrixXd>(&jac[0], 1, jac.size()));
+	return jac;
+}
 
-    return jac;
+void blinn_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                         Eigen::Ref<RowMatrixXd> jac) const
+{
+	const int nbParams = nbParameters();
+
+	jac.setZero();
+	for(int n=0; n<x.rows(); ++n)
+	{
+		// Test if the configuration is below the horizon
+		const double cosine = x(n, 0);
+		if(cosine <= 0.0)
+			continue;
+
+		double* jn = jac.row(n).data();
+		for(int i=0; i<_parameters.dimY(); ++i)
+		{
+			const double p = std::pow(cosine, _N[i]);
+
+			// df / dk_s
+			jn[i*nbParams + i*2+0] = p;
+
+			// df / dN
+			jn[i*nbParams + i*2+1] = _ks[i] * log(cosine) * p;
+		}
+	}
 }
 
 
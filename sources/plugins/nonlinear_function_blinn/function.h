@@ -47,6 +47,8 @@ class blinn_function : public nonlinear_function
 		// Overload the function operator
 		virtual vec operator()(const vec& x) const ;
 		virtual vec value(const vec& x) const ;
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
 
 
 		//! \brief Boostrap the function by defining the diffuse term
@@ -75,6 +77,8 @@ class blinn_function : public nonlinear_function
 		//! \brief Obtain the derivatives of the function with respect to the
 		//! parameters. 
 		virtual vec parametersJacobian(const vec& x) const ;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 		void save_call(std::ostream& out, const arguments& args) const;
 		void save_body(std::ostream& out, const arguments& args) const;
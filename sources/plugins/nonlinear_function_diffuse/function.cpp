@@ -50,6 +50,12 @@ vec diffuse_function::value(const vec& x) const
     return res;
 }
 
+void diffuse_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                              Eigen::Ref<RowMatrixXd> y) const
+{
+    y = _kd.transpose().replicate(x.rows(), 1);
+}
+
 //! Load function specific files
 bool diffuse_function::load(std::istream &in)
 {
@@ -178,6 +184,20 @@ vec diffuse_function::parametersJacobian(const vec& x) const
     return jac;
 }
 
+void diffuse_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                           Eigen::Ref<RowMatrixXd> jac) const
+{
+	// The Jacobian does not depend on the position
+#ifdef FIT_DIFFUSE
+	jac.setZero();
+	for(int i=0; i<_parameters.dimY(); ++i)
+	{
+		// df / dk_d
+		jac.col(i*_parameters.dimY() + i).setOnes();
+	}
+#endif
+}
+
 
 void diffuse_function::bootstrap(const ptr<data> d, const arguments& args)
 {
@@ -48,6 +48,8 @@ class diffuse_function : public nonlinear_function
 		// Overload the function operator
 		virtual vec operator()(const vec& x) const ;
 		virtual vec value(const vec& x) const ;
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
 
 
 		//! \brief Boostrap the function by defining the diffuse term
@@ -69,6 +71,8 @@ class diffuse_function : public nonlinear_function
 		//! \brief Obtain the derivatives of the function with respect to the
 		//! parameters.
 		virtual vec parametersJacobian(const vec& x) const ;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 	private: // data
 
@@ -29,7 +29,7 @@ ALTA_DLL_EXPORT function* provide_function(const alta::parameters& params)
 }
 
 lafortune_function::lafortune_function(const alta::parameters& params) :
-    nonlinear_function(params)
+    nonlinear_function(params), _n(1), _isotropic(false)
 {
     auto nY = params.dimY();
 
@@ -52,45 +52,48 @@ vec lafortune_function::operator()(const vec& x) const
 }
 vec lafortune_function::value(const vec& x) const 
 {
-    const int nY = _parameters.dimY();
-    vec res(nY);
+    vec res(_parameters.dimY());
+    values(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+           Eigen::Map<RowMatrixXd>(&res[0], 1, res.size()));
+    return res;
+}
 
-#ifdef ADAPT_TO_PARAM
-	vec y(6);
-	params::convert(&x[0], _in_param, params::CARTESIAN, &y[0]);
-#endif
+void lafortune_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                                Eigen::Ref<RowMatrixXd> res) const
+{
+	const int nY = _parameters.dimY();
 
-	double dx, dy, dz;
+	for(int s=0; s<x.rows(); ++s)
+	{
 #ifdef ADAPT_TO_PARAM
-	dx = y[0]*y[3];
-	dy = y[1]*y[4];
-	dz = y[2]*y[5];
+		double y[6];
+		params::convert(x.row(s).data(), _in_param, params::CARTESIAN, &y[0]);
 #else
-	dx = x[0]*x[3];
-	dy = x[1]*x[4];
-	dz = x[2]*x[5];
+		const double* y = x.row(s).data();
 #endif
 
-	// For each color channel
-    for(int i=0; i<nY; ++i)
-	{
-		// Start with the diffuse term
-		res[i] = _kd[i];
+		const double dx = y[0]*y[3];
+		const double dy = y[1]*y[4];
+		const double dz = y[2]*y[5];
 
-		// For each lobe
-		for(int n=0; n<_n; ++n)
+		// For each color channel
+		for(int i=0; i<nY; ++i)
 		{
-			double Cx, Cy, Cz, N;
-			getCurrentLobe(n, i, Cx, Cy, Cz, N);
+			// Start with the diffuse term
+			res(s, i) = _kd[i];
 
-			const double d = Cx*dx + Cy*dy + Cz*dz;
-			if(d > 0.0)
-				res[i] += pow(d, N);
-		}
+			// For each lobe
+			for(int n=0; n<_n; ++n)
+			{
+				double Cx, Cy, Cz, N;
+				getCurrentLobe(n, i, Cx, Cy, Cz, N);
 
+				const double d = Cx*dx + Cy*dy + Cz*dz;
+				if(d > 0.0)
+					res(s, i) += pow(d, N);
+			}
+		}
 	}
-
-    return res;
 }
         
 vec lafortune_function::value(const vec& x, const vec& p)
@@ -233,76 +236,67 @@ void lafortune_function::setParameters(const vec& p)
 //! parameters. 
 vec lafortune_function::parametersJacobian(const vec& x) const 
 {
-    const int nY = _parameters.dimY();
+    vec jac(_parameters.dimY()*nbParameters());
+    parametersJacobians(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+                        Eigen::Map<RowMatrixXd>(&jac[0], 1, jac.size()));
+    return jac;
+}
 
-#ifdef ADAPT_TO_PARAM
-	vec y(6);
-	params::convert(&x[0], _in_param, params::CARTESIAN, &y[0]);
-#endif
+void lafortune_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                             Eigen::Ref<RowMatrixXd> jac) const
+{
+	const int nY = _parameters.dimY();
+	const int nbParams = nbParameters();
 
-	double dx, dy, dz;
+	jac.setZero();
+	for(int s=0; s<x.rows(); ++s)
+	{
 #ifdef ADAPT_TO_PARAM
-	dx = y[0]*y[3];
-	dy = y[1]*y[4];
-	dz = y[2]*y[5];
+		double y[6];
+		params::convert(x.row(s).data(), _in_param, params::CARTESIAN, &y[0]);
 #else
-	dx = x[0]*x[3];
-	dy = x[1]*x[4];
-	dz = x[2]*x[5];
+		const double* y = x.row(s).data();
 #endif
 
-    vec jac(nY*nbParameters());
-     for(int i=0; i<nY; ++i)
-	 {
-		 for(int n=0; n<_n; ++n)
-             for(int j=0; j<nY; ++j)
-			 {
-				 // index of the current monochromatic lobe
-                 int index = i*nbParameters() + 4*(n*nY + j);
-				 
-				 double Cx, Cy, Cz, N;
-				 getCurrentLobe(n, j, Cx, Cy, Cz, N);
-				 
-				 double d  = Cx*dx + Cy*dy + Cz*dz;
-
-				 if(i == j && d > 0.0)
-				 {
-					 // df / dCx
-					 jac[index+0] = dx * N * std::pow(d, N-1.0);
-
-					 // df / dCy
-					 jac[index+1] = dy * N * std::pow(d, N-1.0);
-					 
-					 // df / dCz
-					 jac[index+2] = dz * N * std::pow(d, N-1.0);
-
-					 // df / dN
-					 if(d <= 0.0)
-						 jac[index+3] = 0.0;
-					 else
-						 jac[index+3] = std::log(d) * std::pow(d, N);
-				 }
-				 else
-				 {
-					 jac[index+0] = 0.0;
-					 jac[index+1] = 0.0;
-					 jac[index+2] = 0.0;
-					 jac[index+3] = 0.0;
-				 }
-			 }
+		const double dx = y[0]*y[3];
+		const double dy = y[1]*y[4];
+		const double dz = y[2]*y[5];
 
-#ifdef FIT_DIFFUSE
-         for(int j=0; j<nY; ++j)
-		 {
-			 // index of the current monochromatic lobe
-             int index = i*nbParameters() + 4*_n*nY + j;
+		double* js = jac.row(s).data();
+		for(int i=0; i<nY; ++i)
+		{
+			for(int n=0; n<_n; ++n)
+			{
+				// index of the current monochromatic lobe
+				const int index = i*nbParams + 4*(n*nY + i);
 
-			 jac[index] = 1.0;
-		 }
-#endif
-	 }
+				double Cx, Cy, Cz, N;
+				getCurrentLobe(n, i, Cx, Cy, Cz, N);
 
-    return jac;
+				const double d = Cx*dx + Cy*dy + Cz*dz;
+				if(d > 0.0)
+				{
+					const double dN = N * std::pow(d, N-1.0);
+
+					// df / dCx, df / dCy, df / dCz
+					js[index+0] = dx * dN;
+					js[index+1] = dy * dN;
+					js[index+2] = dz * dN;
+
+					// df / dN
+					js[index+3] = std::log(d) * std::pow(d, N);
+				}
+			}
+
+#ifdef FIT_DIFFUSE
+			for(int j=0; j<nY; ++j)
+			{
+				// index of the current monochromatic lobe
+				js[i*nbParams + 4*_n*nY + j] = 1.0;
+			}
+#endif
+		}
+	}
 }
 		
 void lafortune_function::bootstrap(const ptr<data> d, const arguments& args)
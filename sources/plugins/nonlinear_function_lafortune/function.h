@@ -50,6 +50,8 @@ class lafortune_function : public nonlinear_function
         // Overload the function operator
 		virtual vec operator()(const vec& x) const ;
 		virtual vec value(const vec& x) const ;
+		virtual void values(const Eigen::Ref<const RowMatrixXd>& x,
+		                    Eigen::Ref<RowMatrixXd> y) const;
 		virtual vec value(const vec& x, const vec& p);
 
 		//! \brief Load function specific files
@@ -74,6 +76,8 @@ class lafortune_function : public nonlinear_function
 		//! \brief Obtain the derivatives of the function with respect to the
 		//! parameters. 
 		virtual vec parametersJacobian(const vec& x) const ;
+		virtual void parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+		                                 Eigen::Ref<RowMatrixXd> jac) const;
 
 		//! \brief Provide the parametrization of the input space of the function.
 		//! For this one, we fix that the parametrization is in THETAD_PHID
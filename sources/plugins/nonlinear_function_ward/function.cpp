@@ -45,31 +45,44 @@ vec ward_function::operator()(const vec& x) const
 vec ward_function::value(const vec& x) const 
 {
 	vec res(_parameters.dimY());
+	values(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+	       Eigen::Map<RowMatrixXd>(&res[0], 1, res.size()));
+	return res;
+}
 
-	double h[3];
-	params::convert(&x[0], params::CARTESIAN, params::RUSIN_VH, &h[0]);
-
-	for(int i=0; i<_parameters.dimY(); ++i)
+void ward_function::values(const Eigen::Ref<const RowMatrixXd>& x,
+                           Eigen::Ref<RowMatrixXd> y) const
+{
+	for(int n=0; n<x.rows(); ++n)
 	{
-		const double ax = _ax[i];
-		const double ay = _ay[i];
+		const double* xn = x.row(n).data();
 
-		const double hx_ax = h[0]/ax;
-		const double hy_ay = h[1]/ay;
+		double h[3];
+		params::convert(xn, params::CARTESIAN, params::RUSIN_VH, &h[0]);
 
-		const double exponent = (hx_ax*hx_ax + hy_ay*hy_ay) / (h[2]*h[2]);
+		const double cos2 = xn[2]*xn[5];
+		const double h2   = h[2]*h[2];
 
-		if(x[2]*x[5] > 0.0)
-		{
-			res[i] = (_ks[i] / (4.0 * M_PI * ax * ay * sqrt(x[2]*x[5]))) * std::exp(- exponent);
-		}
-		else
+		for(int i=0; i<_parameters.dimY(); ++i)
 		{
-			res[i] = 0.0;
+			const double ax = _ax[i];
+			const double ay = _ay[i];
+
+			const double hx_ax = h[0]/ax;
+			const double hy_ay = h[1]/ay;
+
+			const double exponent = (hx_ax*hx_ax + hy_ay*hy_ay) / h2;
+
+			if(cos2 > 0.0)
+			{
+				y(n, i) = (_ks[i] / (4.0 * M_PI * ax * ay * sqrt(cos2))) * std::exp(- exponent);
+			}
+			else
+			{
+				y(n, i) = 0.0;
+			}
 		}
 	}
-
-	return res;
 }
 
 //! Number of parameters to this non-linear function
@@ -121,43 +134,48 @@ void ward_function::setParameters(const vec& p)
 //! \todo finish. 
 vec ward_function::parametersJacobian(const vec& x) const 
 {
-	double h[3];
-	params::convert(&x[0], params::CARTESIAN, params::RUSIN_VH, h);
+	vec jac(_parameters.dimY()*nbParameters());
+	parametersJacobians(Eigen::Map<const RowMatrixXd>(&x[0], 1, x.size()),
+	                    Eigen::Map<RowMatrixXd>(&jac[0], 1, jac.size()));
+	return jac;
+}
 
-    vec jac(_parameters.dimY()*nbParameters());
-	 for(int i=0; i<_parameters.dimY(); ++i)
-	 {
-		 for(int j=0; j<_parameters.dimY(); ++j)
-		 {
-             if(i == j && x[2]*x[5]>0.0)
-			 {
-                 const double ax = _ax[i];
-                 const double ay = _ay[i];
-
-                 const double hx_ax = h[0]/ax;
-                 const double hy_ay = h[1]/ay;
-				 const double gauss = exp(-(hx_ax*hx_ax + hy_ay*hy_ay) / (h[2]*h[2]));
-                 const double fact  = 1.0 / (4.0*M_PI*ax*ay*sqrt(x[2]*x[5]));
-
-				 // df / dk_s
-				 jac[i*nbParameters() + j*3+0] = fact * gauss;
-
-				 // df / da_x
-                 jac[i*nbParameters() + j*3+1] = _ks[i] * fact * (1.0/ax) * (((2.0*h[0]*hx_ax) / h[2]) * gauss - 1);
-
-				 // df / da_y
-                 jac[i*nbParameters() + j*3+2] = _ks[i] * fact * (1.0/ay) * (((2.0*h[1]*hy_ay) / h[2]) * gauss - 1);
-			 }
-			 else
-			 {
-				 jac[i*nbParameters() + j*3+0] = 0.0;
-				 jac[i*nbParameters() + j*3+1] = 0.0;
-				 jac[i*nbParameters() + j*3+2] = 0.0;
-			 }
-		 }
-	 }
+void ward_function::parametersJacobians(const Eigen::Ref<const RowMatrixXd>& x,
+                                        Eigen::Ref<RowMatrixXd> jac) const
+{
+	const int nbParams = nbParameters();
+
+	jac.setZero();
+	for(int n=0; n<x.rows(); ++n)
+	{
+		const double* xn = x.row(n).data();
+		if(!(xn[2]*xn[5]>0.0))
+			continue;
+
+		double h[3];
+		params::convert(xn, params::CARTESIAN, params::RUSIN_VH, h);
+
+		double* jn = jac.row(n).data();
+		for(int i=0; i<_parameters.dimY(); ++i)
+		{
+			const double ax = _ax[i];
+			const double ay = _ay[i];
+
+			const double hx_ax = h[0]/ax;
+			const double hy_ay = h[1]/ay;
+			const double gauss = exp(-(hx_ax*hx_ax + hy_ay*hy_ay) / (h[2]*h[2]));
+			const double fact  = 1.0 / (4.0*M_PI*ax*ay*sqrt(xn[2]*xn[5]));
+
+			// df / dk_s
+			jn[i*nbParams + i*3+0] = fact * gauss;
 
-    return jac;
+			// df / da_x
+			jn[i*nbParams + i*3+1] = _ks[i] * fact * (1.0/ax) * ((2.0*hx_ax*hx_ax) / (h[2]*h[2]) - 1) * gauss;
+
+			// df / da_y
+			jn[i*nbParams + i*3+2] = _ks[i] * fact * (1.0/ay) * ((2.0*hy_ay*hy_ay) / (h[2]*h[2]) - 1) * gauss;
+		}
+	}
 }
 		
 void ward_function::bootstrap(const ptr<data> d, const arguments& args)
@@ -0,0 +1,310 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#include <core/common.h>
+
+/*! \brief An incremental active-set solver for the quadratic programs of
+ *  the rational fitters.
+ *
+ *  \details
+ *  Solves \f$ \min_x \frac{1}{2} x^T G x \f$ subject to inequality
+ *  constraints \f$ c_i^T x + c_{0,i} \geq 0 \f$ with the dual method of
+ *  Goldfarb and Idnani [1983], as QuadProg++ does.  Contrary to
+ *  QuadProg++, the solver keeps its state (solution, active set, and the
+ *  factorizations J and R) between calls to \a solve: constraints can be
+ *  added to an already solved program, and the next call to \a solve
+ *  starts from the previous optimum instead of the unconstrained one.
+ *  Since the dual method only ever adds violated constraints, the previous
+ *  optimum is a valid starting point, and solving the program again only
+ *  costs the iterations needed by the new constraints.
+ */
+class active_set_qp
+{
+   public:
+      //! \brief Create a program with N unknowns and \f$ G = I \f$.
+      active_set_qp(int n) :
+         _n(n), _m(0), _C(n, 16), _c0(16)
+      {
+         init(Eigen::MatrixXd::Identity(n, n));
+      }
+
+      //! \brief Create a program with the positive definite matrix G.
+      active_set_qp(const Eigen::MatrixXd& G) :
+         _n(G.rows()), _m(0), _C(G.rows(), 16), _c0(16)
+      {
+         Eigen::LLT<Eigen::MatrixXd> llt(G);
+         init(llt.matrixL().transpose().solve(
+                 Eigen::MatrixXd::Identity(_n, _n)));
+      }
+
+      //! \brief Add the constraint \f$ c^T x + c_0 \geq 0 \f$ and return
+      //! its index.  The current solution stays the starting point of the
+      //! next call to \a solve.
+      int add_constraint(const vec& c, double c0)
+      {
+         if(_m == _C.cols())
+         {
+            _C.conservativeResize(_n, 2*_m);
+            _c0.conservativeResize(2*_m);
+         }
+         _C.col(_m) = c;
+         _c0[_m]    = c0;
+         _active.push_back(false);
+         return _m++;
+      }
+
+      //! \brief Number of constraints of the program.
+      int nb_constraints() const { return _m; }
+
+      //! \brief Indices of the active constraints of the last solution.
+      std::vector<int> active_set() const
+      {
+         return std::vector<int>(_A.begin(), _A.begin() + _iq);
+      }
+
+      //! \brief Lagrange multipliers of the active constraints, in the
+      //! order of \a active_set.
+      vec multipliers() const { return _u.head(_iq); }
+
+      //! \brief Value of the objective at the last solution.
+      double cost() const { return _f; }
+
+      //! \brief Current solution.
+      const vec& solution() const { return _x; }
+
+      //! \brief Return the values \f$ c_i^T x + c_{0,i} \f$ of all the
+      //! constraints at the current solution.
+      vec slacks() const
+      {
+         return _C.leftCols(_m).transpose() * _x + _c0.head(_m);
+      }
+
+      //! \brief Update the solution so that it satisfies all the
+      //! constraints added so far.  Return false if the program is
+      //! infeasible, in which case the solver must be reset before
+      //! solving again.
+      bool solve(vec& x)
+      {
+         const double eps = std::numeric_limits<double>::epsilon();
+         const double inf = std::numeric_limits<double>::infinity();
+
+         for(int iter=0; iter <= 10*_m; ++iter)
+         {
+            // Step 1: choose the most violated constraint among the
+            // inactive ones.
+            const vec s = slacks();
+            double psi = 0.0, ss = 0.0;
+            int ip = -1;
+            for(int i=0; i<_m; ++i)
+            {
+               if(_active[i]) { continue; }
+
+               psi += std::min(0.0, s[i]);
+               if(s[i] < ss) { ss = s[i]; ip = i; }
+            }
+
+            if(ip < 0 || std::abs(psi) <= std::max(_m, _iq) * eps * _c1 * _c2 * 100.0)
+            {
+               x = _x;
+               return true;
+            }
+
+            // Step 2: project the solution onto constraint IP, dropping
+            // the active constraints that would get a negative multiplier.
+            const vec np = _C.col(ip);
+            double sp = s[ip];
+            _u[_iq] = 0.0;
+            while(true)
+            {
+               // Step 2a: step directions in the primal and dual spaces
+               vec d = _J.transpose() * np;
+               vec z = _J.rightCols(_n - _iq) * d.tail(_n - _iq);
+               vec r = _R.topLeftCorner(_iq, _iq).triangularView<Eigen::Upper>().solve(d.head(_iq));
+
+               // Step 2b: partial (dual) and full (primal) step lengths
+               int l = -1;
+               double t1 = inf;
+               for(int k=0; k<_iq; ++k)
+               {
+                  if(r[k] > 0.0 && _u[k] / r[k] < t1)
+                  {
+                     t1 = _u[k] / r[k];
+                     l  = k;
+                  }
+               }
+               const double t2 = z.squaredNorm() > eps ? -sp / z.dot(np) : inf;
+               const double t  = std::min(t1, t2);
+
+               // Step 2c: take the step
+               if(t >= inf)
+               {
+                  return false;
+               }
+
+               if(t2 < inf)
+               {
+                  _x += t * z;
+                  _f += t * z.dot(np) * (0.5 * t + _u[_iq]);
+               }
+               _u.head(_iq) -= t * r;
+               _u[_iq]      += t;
+
+               if(t2 < inf && std::abs(t - t2) < eps)
+               {
+                  // Full step: IP becomes active
+                  if(!add_active(d, ip))
+                  {
+                     return false;
+                  }
+                  break;
+               }
+
+               // Partial step: drop constraint L and try again
+               remove_active(l);
+               sp = np.dot(_x) + _c0[ip];
+            }
+         }
+
+         std::cerr << "<<ERROR>> too many iterations in the quadratic program" << std::endl;
+         return false;
+      }
+
+      //! \brief Restart from the unconstrained solution, keeping the
+      //! constraints.
+      void reset()
+      {
+         _J = _J0;
+         _R.setZero();
+         _x.setZero();
+         _u.setZero();
+         _f = 0.0;
+         _iq = 0;
+         _R_norm = 1.0;
+         std::fill(_active.begin(), _active.end(), false);
+      }
+
+   private:
+      //! \brief Set the initial factorization \f$ J = L^{-T} \f$ where
+      //! \f$ G = L L^T \f$.
+      void init(const Eigen::MatrixXd& J)
+      {
+         _J0 = J;
+         _R.resize(_n, _n);
+         _x.resize(_n);
+         _u.resize(_n + 1);
+         _A.resize(_n + 1);
+
+         // c1 * c2 is an estimate of the condition number of G
+         _c1 = J.diagonal().cwiseInverse().squaredNorm();
+         _c2 = J.trace();
+         reset();
+      }
+
+      //! \brief Rotate the vectors A and B in their plane, so that
+      //! \f$ (a, b) \leftarrow (c a + s b, c b - s a) \f$.
+      template<typename V1, typename V2>
+      static void rotate(V1&& a, V2&& b, double c, double s)
+      {
+         for(int i=0; i<a.size(); ++i)
+         {
+            const double ai = a[i], bi = b[i];
+            a[i] = c*ai + s*bi;
+            b[i] = c*bi - s*ai;
+         }
+      }
+
+      //! \brief Add constraint IP to the active set, given
+      //! \f$ d = J^T c_{ip} \f$.  Return false if it depends linearly on
+      //! the other active constraints.
+      bool add_active(vec& d, int ip)
+      {
+         // Zero the tail of d with Givens rotations applied to J
+         for(int j=_n-1; j>=_iq+1; --j)
+         {
+            double h = std::hypot(d[j-1], d[j]);
+            if(h < std::numeric_limits<double>::epsilon()) { continue; }
+            if(d[j-1] < 0.0) { h = -h; }
+
+            const double c = d[j-1] / h, s = d[j] / h;
+            d[j-1] = h;
+            d[j]   = 0.0;
+            rotate(_J.col(j-1), _J.col(j), c, s);
+         }
+
+         _R.col(_iq).head(_iq+1) = d.head(_iq+1);
+         _A[_iq] = ip;
+         _active[ip] = true;
+         ++_iq;
+
+         if(std::abs(d[_iq-1]) <= std::numeric_limits<double>::epsilon() * _R_norm)
+         {
+            return false;
+         }
+         _R_norm = std::max(_R_norm, std::abs(d[_iq-1]));
+         return true;
+      }
+
+      //! \brief Remove the L-th active constraint and restore the upper
+      //! triangular shape of R.
+      void remove_active(int l)
+      {
+         _active[_A[l]] = false;
+         for(int k=l; k<_iq-1; ++k)
+         {
+            _A[k] = _A[k+1];
+            _u[k] = _u[k+1];
+            _R.col(k) = _R.col(k+1);
+         }
+         _u[_iq-1] = _u[_iq];
+         _u[_iq]   = 0.0;
+         _R.col(_iq-1).setZero();
+         --_iq;
+
+         for(int j=l; j<_iq; ++j)
+         {
+            double h = std::hypot(_R(j,j), _R(j+1,j));
+            if(h < std::numeric_limits<double>::epsilon()) { continue; }
+            if(_R(j,j) < 0.0) { h = -h; }
+
+            const double c = _R(j,j) / h, s = _R(j+1,j) / h;
+            _R(j,j)   = h;
+            _R(j+1,j) = 0.0;
+            rotate(_R.row(j).segment(j+1, _iq-j-1).transpose(),
+                   _R.row(j+1).segment(j+1, _iq-j-1).transpose(), c, s);
+            rotate(_J.col(j), _J.col(j+1), c, s);
+         }
+      }
+
+   private:
+      int _n, _m;
+
+      // Constraints, stored column-wise with spare capacity
+      Eigen::MatrixXd _C;
+      vec _c0;
+      std::vector<bool> _active;
+
+      // Solution, objective value and multipliers of the active set
+      vec _x, _u;
+      double _f;
+
+      // Active set and its factorizations
+      std::vector<int> _A;
+      int _iq;
+      Eigen::MatrixXd _J0, _J, _R;
+      double _R_norm, _c1, _c2;
+};
@@ -14,6 +14,7 @@
 
 // STL
 #include <string>
+#include <sstream>
 #include <iostream>
 #include <fstream>
 #include <limits>
@@ -31,9 +32,18 @@
 
 using namespace alta;
 
+// Number of samples accumulated at once by a thread.
+static const int chunk_size = 1024;
+
 /*! \brief A least square fitter for rational function using the library Eigen
  *  \ingroup plugins
  *  \ingroup fitters
+ *
+ *  \details
+ *  The color channels are fitted concurrently on <b>--nb-cores</b> threads
+ *  (all the available ones by default). The \f$(n_p+n_q)^2\f$ system is
+ *  accumulated by chunks of samples, so the memory used does not depend on
+ *  the number of samples.
  *  \todo :  WRITE MORE
  */
 class rational_fitter_eigen : public fitter
@@ -43,9 +53,12 @@ class rational_fitter_eigen : public fitter
 		// min and Max usable np and nq values for the fitting
 		int _np, _nq;
 
+		// Number of channels fitted concurrently
+		int _nb_cores;
+
 	public: //methods
 
-		rational_fitter_eigen() 
+		rational_fitter_eigen() : _nb_cores(0)
 		{
 		}
 		~rational_fitter_eigen() 
@@ -99,6 +112,7 @@ class rational_fitter_eigen : public fitter
 		{
 			_np = args.get_float("np", 10) ;
 			_nq = args.get_float("nq", 10) ;
+			_nb_cores = args.get_int("nb-cores", 0) ;
 		}
 		
 	protected: // methods
@@ -107,16 +121,10 @@ class rational_fitter_eigen : public fitter
 		{
 			// For each output dimension (color channel for BRDFs) perform
 			// a separate fit on the y-1D rational function.
-			for(int j=0; j<d->parametrization().dimY(); ++j)
+			return fit_channels(*r, [&](int j, rational_function_1d* rs)
 			{
-				rational_function_1d* rs = r->get(j);
-				if(!fit_data(d, np, nq, j, rs))
-				{
-					return false ;
-				}
-			}
-
-			return true ;
+				return fit_data(d, np, nq, j, rs) ;
+			}, _nb_cores) ;
 		}
 
 		// dat is the data object, it contains all the points to fit
@@ -125,41 +133,30 @@ class rational_fitter_eigen : public fitter
 		// the function returns a rational BRDF function and a boolean
 		bool fit_data(const ptr<vertical_segment>& d, int np, int nq, int ny, rational_function_1d* r)
 		{
-			// Each constraint (fitting interval or point
-			// add another dimension to the constraint
-			// matrix
-			Eigen::MatrixXd CI(np+nq, d->size()) ;
-			for(int i=0; i<d->size(); ++i)	
-			{		
-				// A row of the constraint matrix has this 
-				// form: [p_{0}(x_i), .., p_{np}(x_i), -f(x_i) q_{0}(x_i), .., -f(x_i) q_{nq}(x_i)]
-				for(int j=0; j<np+nq; ++j)
-				{
-					// Filling the p part
-					if(j<np)
-					{
-						const double pi = r->p(d->get(i), j) ;
-						CI(j, i) =  pi ;
-					}
-					// Filling the q part
-					else
-					{
-						vec v = d->get(i) ;
-						const double y  = v[d->parametrization().dimX() + ny] ;
-						const double qi = r->q(d->get(i), j-np) ;
-						CI(j, i) = -y * qi ;
-					}
-				}
-			}
+			// Each constraint (fitting interval or point) adds a column
+			// c_i = [p_{0}(x_i), .., p_{np}(x_i), -f(x_i) q_{0}(x_i), .., -f(x_i) q_{nq}(x_i)]
+			// to the constraint matrix CI. Only M = CI CI' is needed, so it is
+			// accumulated over chunks of samples in parallel instead of storing
+			// the (np+nq) x size() matrix CI.
+			const auto X = d->x_view() ;
+			const auto Y = d->y_view().col(ny) ;
+			const Eigen::MatrixXd M = parallel_sum_chunks(d->size(), chunk_size,
+				Eigen::MatrixXd(Eigen::MatrixXd::Zero(np+nq, np+nq)),
+				[&](int first, int count)
+			{
+				RowMatrixXd P(count, np), Q(count, nq) ;
+				r->bases(X.middleRows(first, count), P, Q) ;
 
-		//	std::cout << CI << std::endl << std::endl ;
+				Eigen::MatrixXd CI(np+nq, count) ;
+				CI.topRows(np)    = P.transpose() ;
+				CI.bottomRows(nq) = -(Q.array().colwise() * Y.segment(first, count).array()).matrix().transpose() ;
+
+				Eigen::MatrixXd Mc(np+nq, np+nq) ;
+				Mc.noalias() = CI * CI.transpose() ;
+				return Mc ;
+			}) ;
 
 			// Perform the Eigen decomposition of CI CI'
-			Eigen::MatrixXd M(np+nq, np+nq) ;
-			M.noalias() = CI * CI.transpose();
-		// Faster alternative for large np+nq (only the lower triangular half gets computed):
-		// M.setZero();
-		// M.selfadjointView<Lower>().rankUpdate(CI.transpose());
 			Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(M) ;
 		/*
 			std::cout << M.size() << std::endl << std::endl ;
@@ -199,7 +196,11 @@ class rational_fitter_eigen : public fitter
 				Eigen::VectorXd::Map(&q[0], nq) = solver.eigenvectors().col(min_id).tail(nq);
 				
 				r->update(p, q) ;
-				std::cout << "<<INFO>> got solution " << *r << std::endl ;
+
+				// Print at once since channels are fitted concurrently
+				std::ostringstream out ;
+				out << "<<INFO>> got solution " << *r << std::endl ;
+				std::cout << out.str() ;
 				return true;
 			}
 			else
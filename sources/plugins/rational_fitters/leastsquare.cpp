@@ -11,6 +11,7 @@
 
 // Include STL
 #include <string>
+#include <sstream>
 #include <iostream>
 #include <fstream>
 #include <limits>
@@ -32,9 +33,88 @@
 
 using namespace alta;
 
+// Number of samples factored at once by a thread.
+static const int chunk_size = 1024;
+
+// Number of chunks processed between two reductions of their results.
+static const int batch_chunks = 64;
+
+// Call FN(FIRST, COUNT) on consecutive ranges of batch_chunks chunks, so
+// that per-chunk results are reduced batch by batch, in memory that does not
+// depend on SIZE.
+template<typename Function>
+static void for_each_batch(int size, Function fn)
+{
+   const int batch = batch_chunks * chunk_size;
+   for(int first = 0; first < size; first += batch)
+   {
+      fn(first, std::min(batch, size - first));
+   }
+}
+
+// Return the triangular factor R of the QR decomposition of the size x cols
+// matrix whose rows [FIRST, FIRST + BLOCK.rows()) are set by ROWS(FIRST,
+// BLOCK). The chunks of rows of a batch are factored in parallel, then their
+// factors are stacked below the factor of the previous batches and factored
+// again (TSQR), so neither the matrix nor all the chunk factors are ever
+// stored at once.
+template<typename Rows>
+static Eigen::MatrixXd tsqr_factor(int size, int cols, Rows rows)
+{
+   Eigen::MatrixXd R = Eigen::MatrixXd::Zero(cols, cols);
+   Eigen::MatrixXd stack((batch_chunks + 1) * cols, cols);
+   for_each_batch(size, [&](int start, int n)
+   {
+      stack.setZero();
+      stack.topRows(cols) = R;
+      parallel_for_chunks(n, chunk_size, [&](int c, int first, int count)
+      {
+         Eigen::MatrixXd block(count, cols);
+         rows(start + first, block);
+
+         const Eigen::HouseholderQR<Eigen::MatrixXd> qr(block);
+         const int k = std::min(count, cols);
+         stack.block((c + 1) * cols, 0, k, cols) =
+            qr.matrixQR().topRows(k).triangularView<Eigen::Upper>();
+      });
+
+      const Eigen::HouseholderQR<Eigen::MatrixXd> qr(stack);
+      R = qr.matrixQR().topRows(cols).triangularView<Eigen::Upper>();
+   });
+   return R;
+}
+
+// Sum of squares, sum and maximum of the absolute values of a residual.
+struct residual_norms
+{
+   double l2, l1, linf;
+
+   residual_norms& operator+=(const residual_norms& other)
+   {
+      l2 += other.l2;
+      l1 += other.l1;
+      linf = std::max(linf, other.linf);
+      return *this;
+   }
+};
+
+// Return the least-squares solution of A x = b, given the triangular
+// factor R of [A b].
+static Eigen::VectorXd solve_factor(const Eigen::MatrixXd& R)
+{
+   const int n = R.cols() - 1;
+   return R.topLeftCorner(n, n).colPivHouseholderQr().solve(R.col(n).head(n));
+}
+
 /*! \brief A least square fitter for rational function
  *  \ingroup plugins
  *  \ingroup fitters
+ *
+ *  \details
+ *  The color channels are fitted concurrently on <b>--nb-cores</b> threads
+ *  (all the available ones by default). The least-squares systems are
+ *  factored by chunks of samples, so the memory used does not depend on the
+ *  number of samples.
  *  \todo :  WRITE MORE
  */
 class rational_fitter_leastsquare : public fitter
@@ -43,10 +123,11 @@ class rational_fitter_leastsquare : public fitter
 		
       int _np, _nq ;
 		int _max_iter;
+      int _nb_cores;
 
    public: // methods
 
-      rational_fitter_leastsquare() : _np(10), _nq(10), _max_iter(1)
+      rational_fitter_leastsquare() : _np(10), _nq(10), _max_iter(1), _nb_cores(0)
       {
       }
       ~rational_fitter_leastsquare() 
@@ -98,23 +179,17 @@ class rational_fitter_leastsquare : public fitter
          _np = args.get_int("np", 10) ;
          _nq = args.get_int("nq", 10) ;
          _max_iter = args.get_int("max-iter", 1) ;
+         _nb_cores = args.get_int("nb-cores", 0) ;
       }
             
       bool fit_data(const ptr<vertical_segment>& d, int np, int nq, const ptr<rational_function>& r) 
       {
          // For each output dimension (color channel for BRDFs) perform
          // a separate fit on the y-1D rational function.
-         for(int j=0; j<d->parametrization().dimY(); ++j)
+         return fit_channels(*r, [&](int j, rational_function_1d* rs)
          {
-            rational_function_1d* rs = r->get(j);
-
-            if(!fit_data(d, np, nq, j, rs))
-            {
-                  return false ;
-            }
-         }
-
-         return true ;
+            return fit_data(d, np, nq, j, rs);
+         }, _nb_cores);
       }
 
       // dat is the data object, it contains all the points to fit
@@ -125,32 +200,20 @@ class rational_fitter_leastsquare : public fitter
       {
       using namespace Eigen;
       
-      double scale = 1;
-      
-      MatrixXd D(d->size(), np+nq);
-      VectorXd Y(d->size());
-      for(int i=0; i<d->size(); ++i) 
+      const auto X = d->x_view();
+      const auto Y = d->y_view().col(ny);
+      const int size = d->size();
+
+      // Evaluate the basis functions on the samples [first, first+count):
+      // a row of P and Q has the form [p_{0}(x_i), .., p_{np}(x_i)] and
+      // [q_{0}(x_i), .., q_{nq}(x_i)]. The rows are computed again at each
+      // step, chunk by chunk, instead of storing a size x (np+nq) matrix.
+      auto basis = [&](int first, int count, RowMatrixXd& P, RowMatrixXd& Q)
       {
-         const double y = d->get(i)[d->parametrization().dimX() + ny];
-         Y[i] = y;
-         vec x = d->get(i);
-         VectorXd::Map(&x[0], 1) /= scale;
-         // A row of the constraint matrix has this 
-         // form: [p_{0}(x_i), .., p_{np}(x_i), q_{0}(x_i), .., q_{nq}(x_i)]
-         for(int j=0; j<np+nq; ++j)
-         {
-            if(j<np)
-            {
-            const double pi = r->p(x, j) ;
-            D(i, j) =  pi ;
-            }
-            else
-            {
-            const double qi = r->q(x, j-np) ;
-            D(i,j) = qi ;
-            }
-         }
-      }
+         P.resize(count, np);
+         Q.resize(count, nq);
+         r->bases(X.middleRows(first, count), P, Q);
+      };
 
       VectorXd pq(np+nq);
       
@@ -165,50 +228,30 @@ class rational_fitter_leastsquare : public fitter
          // Step 1 fit 1/f_i using 1/q only
          {
             // Theoretically best weighting scheme to approcimate the true LS problem, which is: sum_i (1/q(x_i) - f_i)^2
-            MatrixXd A = Y.cwiseAbs2().asDiagonal() * D.rightCols(nq);
-            VectorXd b = Y.asDiagonal() * (D.leftCols(np) * pq.head(np));
-            VectorXd x = A.colPivHouseholderQr().solve(b);
-            
-            // Sometimes, this scheme works better:
-      //       MatrixXd A = Y.asDiagonal() * D.rightCols(nq);
-      //       VectorXd b = D.leftCols(np) * pq.head(np);
-      //       VectorXd x = A.colPivHouseholderQr().solve(b);
-            
-            pq.tail(nq) = x;
-            
-            // Statistics on the problem:
-      //       VectorXd sv = A.jacobiSvd().singularValues();
-      //       std::cout << "Singular values: " << sv.transpose() << std::endl;
-      //       std::cout << "Rcond: " << sv(0)/sv(nq-1) << std::endl;
-      //       std::cout << "<<INFO>> LS error " << (A*x-b).norm()/b.norm() << std::endl;
+            // The rows of [A b] are [f_i^2 q(x_i), f_i p(x_i)]
+            const MatrixXd R = tsqr_factor(size, nq+1, [&](int first, MatrixXd& Ab)
+            {
+               RowMatrixXd P, Q;
+               basis(first, Ab.rows(), P, Q);
+               const auto y = Y.segment(first, Ab.rows());
+               Ab.leftCols(nq) = y.cwiseAbs2().asDiagonal() * Q;
+               Ab.col(nq) = y.asDiagonal() * (P * pq.head(np));
+            });
+            pq.tail(nq) = solve_factor(R);
          }
          
-         VectorXd res = ((D.leftCols(np) * pq.head(np)).array() / (D.rightCols(nq) * pq.tail(nq)).array() - Y.array());
-      /*
-      std::cout << "<<INFO>> Real LS norm (1): "
-            << res.norm() / Y.norm()
-            << " ; inf " << res.lpNorm<Infinity>() / Y.lpNorm<Infinity>()
-            << " ; L1  " << res.lpNorm<1>() / Y.lpNorm<1>() << std::endl;
-      */
          // Step 2 fit f_i using p/q with q fix
          {
-            // This scheme gives more weights to small values: (not good)
-      //     VectorXd V = D.rightCols(nq) * pq.tail(nq);
-      //     MatrixXd A = Y.asDiagonal().inverse() * (V.asDiagonal().inverse() * D.leftCols(np));
-      //     VectorXd b = VectorXd::Ones(Y.size());
-      //     VectorXd x = A.colPivHouseholderQr().solve(b);
-            
-            VectorXd Q = D.rightCols(nq) * pq.tail(nq);
-            MatrixXd A = Q.asDiagonal().inverse() * D.leftCols(np);
-            VectorXd x = A.colPivHouseholderQr().solve(Y);
-            
-            pq.head(np) = x;
-
-            // Statistics on the problem:
-      //       VectorXd sv = A.jacobiSvd().singularValues();
-      //       std::cout << "Singular values: " << sv.transpose() << std::endl;
-      //       std::cout << "Rcond: " << sv(0)/sv(np-1) << std::endl;
-      //       std::cout << "<<INFO>> LS error " << (A*x-Y).norm()/Y.norm() << std::endl;
+            // The rows of [A b] are [p(x_i) / q(x_i), f_i]
+            const MatrixXd R = tsqr_factor(size, np+1, [&](int first, MatrixXd& Ab)
+            {
+               RowMatrixXd P, Q;
+               basis(first, Ab.rows(), P, Q);
+               const VectorXd q = Q * pq.tail(nq);
+               Ab.leftCols(np) = q.asDiagonal().inverse() * P;
+               Ab.col(np) = Y.segment(first, Ab.rows());
+            });
+            pq.head(np) = solve_factor(R);
          }
       } // iterations
       
@@ -216,28 +259,33 @@ class rational_fitter_leastsquare : public fitter
       Eigen::VectorXd::Map(&p[0], np) = pq.head(np);
       Eigen::VectorXd::Map(&q[0], nq) = pq.tail(nq);
       
-      double s = 1;
-      for(int i=0; i<np; ++i)
-      {
-         p[i] /= s;
-         s *= scale;
-      }
-      s = 1;
-      for(int i=0; i<nq; ++i)
+      // Evaluate true LS error: sum_i (p(x_i)/q(x_i) - f_i)^2, reducing the
+      // norms of the residual chunk by chunk
+      const residual_norms zero = { 0.0, 0.0, 0.0 };
+      residual_norms res = zero;
+      for_each_batch(size, [&](int start, int n)
       {
-         q[i] /= s;
-         s *= scale;
-      }
-      
-      // Evaluate true LS error: sum_i (p(x_i)/q(x_i) - f_i)^2
-      VectorXd res = ((D.leftCols(np) * pq.head(np)).array() / (D.rightCols(nq) * pq.tail(nq)).array() - Y.array());
-      std::cout << "<<INFO>> L_2 "
-         << res.norm() / Y.norm()
-         << " ; L_inf " << res.lpNorm<Infinity>() / Y.lpNorm<Infinity>()
-         << " ; L_1  " << res.lpNorm<1>() / Y.lpNorm<1>() << std::endl;
-
+         res += parallel_sum_chunks(n, chunk_size, zero, [&](int first, int count)
+         {
+            RowMatrixXd P, Q;
+            basis(start + first, count, P, Q);
+            const VectorXd e = (P * pq.head(np)).cwiseQuotient(Q * pq.tail(nq))
+                             - Y.segment(start + first, count);
+            const residual_norms chunk = { e.squaredNorm(), e.lpNorm<1>(),
+                                           e.lpNorm<Infinity>() };
+            return chunk;
+         });
+      });
       r->update(p, q) ;
-      std::cout << "<<INFO>> got solution " << *r << std::endl ;
+
+      // Print at once since channels are fitted concurrently
+      std::ostringstream out;
+      out << "<<INFO>> L_2 "
+         << std::sqrt(res.l2) / Y.norm()
+         << " ; L_inf " << res.linf / Y.lpNorm<Infinity>()
+         << " ; L_1  " << res.l1 / Y.lpNorm<1>() << std::endl;
+      out << "<<INFO>> got solution " << *r << std::endl ;
+      std::cout << out.str();
       return true;
 
       }
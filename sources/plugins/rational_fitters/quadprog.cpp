@@ -19,6 +19,12 @@
 #include <cmath>
 #include <iomanip>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <typeinfo>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // Interface
 #include <core/function.h>
@@ -27,6 +33,7 @@
 #include <core/vertical_segment.h>
 #include <core/fitter.h>
 #include <core/args.h>
+#include <core/plugins_manager.h>
 
 // Eigen
 #include <Eigen/Dense>
@@ -34,6 +41,8 @@
 // Quadprog++
 #include <QuadProg++.hh>
 
+#include "active_set_qp.h"
+
 // #ifdef WIN32
 // #define isnan(X) ((X != X))
 // #endif
@@ -47,10 +56,44 @@ using namespace alta;
  *  You can find the library here: http://quadprog.sourceforge.net/
  *  \ingroup plugins
  *  \ingroup fitters
+ *
+ *  \details
+ *  The <b>--scheduling-mode</b> argument selects the order in which the
+ *  solver processes the constraints: <em>SlidingWindows</em> (the default),
+ *  <em>WorstSetFirst</em>, <em>WorstFirst</em>, or <em>Incremental</em>.
+ *  The latter starts with <b>--scheduling-chunk-size</b> constraints (twice
+ *  the number of coefficients by default) and adds the most violated ones
+ *  by chunks of that size, keeping the active set of the solver between
+ *  solves.
+ *
+ *  The sizes of the rational function, from <b>--min-np</b>,
+ *  <b>--min-nq</b> up to <b>--np</b>, <b>--nq</b>, and the color channels
+ *  are fitted concurrently on <b>--nb-cores</b> threads (the number of
+ *  processors by default).  The smallest size that fits all channels is
+ *  kept, and the fits of larger sizes are cancelled as soon as it is found.
  *  \todo : WRITE MORE DOCUMENTATION
  */
 class rational_fitter_quadprog : public fitter
 {
+   protected: // types
+
+      // State of the search for one size of the rational function
+      struct configuration
+      {
+         configuration(int np, int nq) :
+            np(np), nq(nq), nb_fitted(0), failed(false)
+         { }
+         configuration(const configuration& c) :
+            np(c.np), nq(c.nq), r(c.r), nb_fitted(c.nb_fitted.load()),
+            failed(c.failed.load())
+         { }
+
+         int np, nq;
+         ptr<rational_function> r;
+         std::atomic<int> nb_fitted;
+         std::atomic<bool> failed;
+      };
+
    protected: // variables
 
       // min and Max usable np and nq values for the fitting
@@ -96,42 +139,163 @@ class rational_fitter_quadprog : public fitter
          std::cout << "<<INFO>> np in  [" << _min_np << ", " << _max_np
             << "] & nq in [" << _min_nq << ", " << _max_nq << "]" << std::endl ;
 
-         int temp_np = _min_np, temp_nq = _min_nq ;
-         while(temp_np <= _max_np || temp_nq <= _max_nq)
+         // Sizes of the rational functions to try, in order
+         std::vector<configuration> configs;
+         for(int temp_np = _min_np, temp_nq = _min_nq; ; )
          {
-            timer time ;
-            time.start() ;
+            configs.push_back(configuration(temp_np, temp_nq));
 
-            r->setSize(temp_np, temp_nq);
-            if(fit_data(d, temp_np, temp_nq, r))
+            if(temp_np == _max_np && temp_nq == _max_nq)
             {
-               time.stop() ;
-               std::cout << "<<INFO>> got a fit using np = " << temp_np << " & nq =  " << temp_nq << "      " << std::endl ;
-               std::cout << "<<INFO>> it took " << time << std::endl ;
+               break;
+            }
+            if(temp_np < _max_np) { ++temp_np ; }
+            if(temp_nq < _max_nq) { ++temp_nq ; }
+         }
+
+         const int nY = d->parametrization().dimY();
 
-               return true ;
+         // Each configuration is fitted on its own copy of the rational
+         // function so that they can be explored concurrently.  Copies are
+         // obtained from the plugins manager, as a last resort the search
+         // runs sequentially on R.
+         bool concurrent = !_export_qp;
+         for(configuration& c : configs)
+         {
+            if(concurrent)
+            {
+               c.r = dynamic_pointer_cast<rational_function>(
+                  ptr<function>(plugins_manager::get_function(args, r->parametrization())));
+               concurrent = c.r && typeid(*c.r) == typeid(*r);
             }
+            if(concurrent)
+            {
+               c.r->setMin(r->min()) ;
+               c.r->setMax(r->max()) ;
+               c.r->setSize(c.np, c.nq);
+               for(int j=0; j<nY; ++j)
+               {
+                  c.r->get(j)->resize(c.np, c.nq);
+               }
+            }
+         }
 
+#ifdef _OPENMP
+         // Only this search is restricted to NB_THREADS threads, the
+         // process-wide setting is left alone.
+         const int nb_threads = concurrent
+            ? args.get_int("nb-cores", omp_get_num_procs()) : 1;
+#endif
 
-            std::cout << "<<INFO>> fit using np = " << temp_np << " & nq =  " << temp_nq << " failed" << std::endl  ;
-            time.stop() ;
-            std::cout << "<<INFO>> it took " << time << std::endl ;
-            std::cout.flush() ;
+         timer time ;
+         time.start() ;
+
+         // Fit each channel of each configuration in a separate task.  Once
+         // a configuration succeeds, the tasks of the larger ones are
+         // cancelled; once a channel fails, so are the other channels of
+         // its configuration.  Without concurrency, tasks are run as they
+         // are created and this amounts to a sequential search.
+         const int nb_configs = configs.size();
+         std::atomic<int> best(nb_configs);
+         std::vector<double> start(nb_configs*nY, 0.0), stop(nb_configs*nY, 0.0);
+         const auto origin = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(nb_threads)
+#pragma omp single
+         for(int k=0; k<nb_configs && k<best; ++k)
+         {
+            for(int j=0; j<nY; ++j)
+            {
+#pragma omp task firstprivate(k, j) shared(configs, best, start, stop) if(concurrent)
+               {
+                  configuration& c = configs[k];
+                  if(k < best && !c.failed)
+                  {
+                     start[k*nY + j] = seconds_since(origin);
+
+                     rational_function_1d* rs;
+                     if(concurrent)
+                     {
+                        rs = c.r->get(j);
+                     }
+                     else
+                     {
+                        // Sequential search: size R before its first channel
+                        if(j == 0) { r->setSize(c.np, c.nq); }
+                        rs = r->get(j);
+                        rs->resize(c.np, c.nq);
+                     }
+
+                     if(fit_data(d, c.np, c.nq, j, rs))
+                     {
+                        // Record the smallest successful configuration
+                        if(++c.nb_fitted == nY)
+                        {
+                           int b = best;
+                           while(k < b && !best.compare_exchange_weak(b, k)) {}
+                        }
+                     }
+                     else
+                     {
+                        c.failed = true;
+                     }
+
+                     stop[k*nY + j] = seconds_since(origin);
+                  }
+               }
+            }
+         }
+         time.stop() ;
 
-            if(temp_np == _max_np && temp_nq == _max_nq)
+         // Report the outcome and the wall time of each configuration that
+         // was at least partly fitted
+         for(int k=0; k<nb_configs; ++k)
+         {
+            const configuration& c = configs[k];
+            double first = std::numeric_limits<double>::max(), last = 0.0;
+            for(int j=0; j<nY; ++j)
             {
-               return false;
+               if(stop[k*nY + j] > 0.0)
+               {
+                  first = std::min(first, start[k*nY + j]);
+                  last  = std::max(last,  stop[k*nY + j]);
+               }
+            }
+            if(last == 0.0)
+            {
+               continue;
             }
 
-            if(temp_np < _max_np)
+            std::cout << "<<INFO>> fit using np = " << c.np << " & nq =  " << c.nq;
+            if(c.nb_fitted == nY)
+            {
+               std::cout << " succeeded";
+            }
+            else if(c.failed)
             {
-               ++temp_np ;
+               std::cout << " failed";
             }
-            if(temp_nq < _max_nq)
+            else
+            {
+               std::cout << " cancelled";
+            }
+            std::cout << " in " << last - first << "s" << std::endl;
+         }
+
+         if(best < nb_configs)
+         {
+            const configuration& c = configs[best];
+            if(concurrent)
             {
-               ++temp_nq ;
+               r->setSize(c.np, c.nq);
+               r->update(c.r);
             }
+
+            std::cout << "<<INFO>> got a fit using np = " << c.np << " & nq =  " << c.nq << "      " << std::endl ;
+            std::cout << "<<INFO>> it took " << time << std::endl ;
+            return true ;
          }
+
+         std::cout << "<<INFO>> it took " << time << std::endl ;
          return false ;
       }
 
@@ -157,23 +321,6 @@ class rational_fitter_quadprog : public fitter
       }
 
 
-      bool fit_data(const ptr<vertical_segment>& d, int np, int nq, const ptr<rational_function>& r)
-      {
-         // For each output dimension (color channel for BRDFs) perform
-         // a separate fit on the y-1D rational function.
-         for(int j=0; j<d->parametrization().dimY(); ++j)
-         {
-            rational_function_1d* rs = r->get(j);
-            rs->resize(np, nq);
-
-            if(!fit_data(d, np, nq, j, rs))
-            {
-               return false ;
-            }
-         }
-         return true ;
-      }
-
       // dat is the data object, it contains all the points to fit
       // np and nq are the degree of the RP to fit to the data
       // y is the dimension to fit on the y-data (e.g. R, G or B for RGB signals)
@@ -202,7 +349,10 @@ class rational_fitter_quadprog : public fitter
          x.setZero();
          double cost = 0;
          G.setIdentity();
-         vec yl, yu, xi;
+         const auto X  = d->x_view();
+         const auto YL = d->yl_view().col(ny);
+         const auto YU = d->yu_view().col(ny);
+         vec xi(X.cols()), pi(np), qi(nq);
          // Each constraint (fitting interval or point
          // add another dimension to the constraint
          // matrix
@@ -212,7 +362,11 @@ class rational_fitter_quadprog : public fitter
             double a0_norm = 0.0 ;
             double a1_norm = 0.0 ;
 
-            xi = d->get(i) ;
+            xi = X.row(i) ;
+            const double yl = YL[i], yu = YU[i] ;
+
+            // Evaluate all the basis functions at once
+            r->basis(xi, pi, qi);
 
             int i0 = i;
             int i1 = i+M;
@@ -238,24 +392,20 @@ class rational_fitter_quadprog : public fitter
                // Filling the p part
                if(j<np)
                {
-                  const double pi = r->p(xi, j);
+                  CI(j,i0) =  pi[j];
+                  CI(j,i1) = -pi[j];
 
-                  CI(j,i0) =  pi;
-                  CI(j,i1) = -pi;
-
-                  Cls(j,i) = pi;
+                  Cls(j,i) = pi[j];
                }
                // Filling the q part
                else
                {
-                  d->get(i, yl, yu);
-
-                  const double qi = r->q(xi, j-np);
+                  const double q = qi[j-np];
 
-                  CI(j,i0) = -yu[ny] * qi;
-                  CI(j,i1) =  yl[ny] * qi;
+                  CI(j,i0) = -yu * q;
+                  CI(j,i1) =  yl * q;
 
-                  Cls(j,i) = -qi*(yu[ny]+yl[ny])/2.0;
+                  Cls(j,i) = -q*(yu+yl)/2.0;
                }
 
                // Update the norm of the row
@@ -354,14 +504,22 @@ class rational_fitter_quadprog : public fitter
          }
 
          VectorXi active_set;
-         //   BenchTimer t;
-         //   t.reset(); t.start();
-         QuadProgPP::init_qp(G);
-         //   t.stop(); std::cout << "init_qp: " << t.value() << "s\n";
-         //   t.reset(); t.start();
-         cost = QuadProgPP::solve_quadprog_with_guess(G, g, CE, ce, CI, ci, x, scheduling, &active_set);
-         //   t.stop(); std::cout << "solve: " << t.value() << "s\n";
-         //   std::cout << "active_set.size(): " << active_set.size() << "\n";
+         if(_scheduling_mode=="Incremental")
+         {
+            const int chunk = _scheduling_chunk_size > 0 ? _scheduling_chunk_size : 2*N;
+            cost = solve_incremental(G, CI, ci, chunk, x, active_set);
+         }
+         else
+         {
+            //   BenchTimer t;
+            //   t.reset(); t.start();
+            QuadProgPP::init_qp(G);
+            //   t.stop(); std::cout << "init_qp: " << t.value() << "s\n";
+            //   t.reset(); t.start();
+            cost = QuadProgPP::solve_quadprog_with_guess(G, g, CE, ce, CI, ci, x, scheduling, &active_set);
+            //   t.stop(); std::cout << "solve: " << t.value() << "s\n";
+            //   std::cout << "active_set.size(): " << active_set.size() << "\n";
+         }
 
          if(_export_qp)
          {
@@ -423,6 +581,78 @@ class rational_fitter_quadprog : public fitter
             return false;
          }
       }
+
+      // Return the time elapsed since START in seconds.
+      static double seconds_since(std::chrono::steady_clock::time_point start)
+      {
+         return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
+
+      // Solve the program with constraints CI^T x + ci >= 0 by adding its
+      // constraints to an incremental solver: start with the first CHUNK
+      // ones, then repeatedly add the CHUNK most violated ones by the
+      // current solution.  Each solve starts from the previous solution and
+      // active set.  Return the cost of the solution, or infinity if the
+      // program is infeasible.
+      static double solve_incremental(const Eigen::MatrixXd& G,
+                                      const Eigen::MatrixXd& CI,
+                                      const Eigen::VectorXd& ci,
+                                      int chunk,
+                                      Eigen::VectorXd& x,
+                                      Eigen::VectorXi& active_set)
+      {
+         const int m = CI.cols();
+         active_set_qp qp(G);
+
+         // Index in CI of each constraint of QP
+         std::vector<int> added;
+         std::vector<bool> is_added(m, false);
+         for(int i=0; i<std::min(chunk, m); ++i)
+         {
+            qp.add_constraint(CI.col(i), ci[i]);
+            added.push_back(i);
+            is_added[i] = true;
+         }
+
+         while(true)
+         {
+            vec sol;
+            if(!qp.solve(sol))
+            {
+               return std::numeric_limits<double>::infinity();
+            }
+
+            const Eigen::VectorXd s = CI.transpose() * sol + ci;
+            std::vector<int> violated;
+            for(int i=0; i<m; ++i)
+            {
+               if(!is_added[i] && s[i] < 0.0) { violated.push_back(i); }
+            }
+
+            if(violated.empty())
+            {
+               x = sol;
+               const std::vector<int> active = qp.active_set();
+               active_set.resize(active.size());
+               for(unsigned int k=0; k<active.size(); ++k)
+               {
+                  active_set[k] = added[active[k]];
+               }
+               return qp.cost();
+            }
+
+            const int nb = std::min<int>(chunk, violated.size());
+            std::partial_sort(violated.begin(), violated.begin() + nb, violated.end(),
+                              [&](int a, int b) { return s[a] < s[b]; });
+            for(int k=0; k<nb; ++k)
+            {
+               const int i = violated[k];
+               qp.add_constraint(CI.col(i), ci[i]);
+               added.push_back(i);
+               is_added[i] = true;
+            }
+         }
+      }
 };
 
 ALTA_DLL_EXPORT fitter* provide_fitter()
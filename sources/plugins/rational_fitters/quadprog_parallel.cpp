@@ -19,7 +19,6 @@
 #include <algorithm>
 #include <cmath>
 #include <string>
-#include <list>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -64,7 +63,14 @@ using namespace alta;
  *   <li><b>--np-step</b> <em>[int]</em> stepping for the number of coefficients
  *   of the rational function. By default, this number is 1.</li>
  *   <li><b>--nb-cores</b> <em>[int]</em> number of core allocated to perform
- *   the seach. By default, this is equal to the number of processors.</li>
+ *   the seach. By default, this is equal to the number of processors. The
+ *   configurations of a given number of coefficients are fitted
+ *   concurrently, so the constraint tests of each one run serially, unless
+ *   nested parallelism is enabled (e.g. OMP_MAX_ACTIVE_LEVELS=2), in which
+ *   case they share the cores left over by the configurations.</li>
+ *   <li><b>--nb-violators</b> <em>[int]</em> number of the most violated
+ *   constraints added to the quadratic program at each iteration. By default,
+ *   only the most violated one is added.</li>
  *   <li><b>--use_delta</b> use the strategy of Pacanowski et al. [2012] to
  *   modify the constraint vector by the condition number of the constraint
  *   matrix. We did not experience any benefit from using it.</li>
@@ -78,8 +84,13 @@ class rational_fitter_parallel : public fitter
       //! procedure. By default, this value is 100.
       int nb_starting_points;
 
+      //! Threads left to each configuration for its constraint tests, once
+      //! the configurations are spread over the cores. They are only used
+      //! when nested parallelism is enabled.
+      int nb_threads_per_fit;
+
    public: // methods
-      rational_fitter_parallel() : nb_starting_points(100)
+      rational_fitter_parallel() : nb_starting_points(100), nb_threads_per_fit(1)
       {
       }
       ~rational_fitter_parallel()
@@ -159,6 +170,7 @@ class rational_fitter_parallel : public fitter
 #endif
 
             omp_set_num_threads(nb_cores) ;
+            nb_threads_per_fit = std::max(1, nb_cores / std::max(1, std::min(nb_cores, i-1)));
 #endif
 
             double min_delta   = std::numeric_limits<double>::max();
@@ -264,20 +276,30 @@ class rational_fitter_parallel : public fitter
             const ptr<rational_function>& r, const arguments &args,
             double& delta, double& linf_dist, double& l2_dist)
       {
-         // Fit the different output dimension independantly
-         for(int j=0; j<d->parametrization().dimY(); ++j)
+         // Fit the different output dimension independantly.  This is
+         // called from parallel loops, so channels are fitted concurrently
+         // only when nested parallelism is enabled.
+         const int nY = d->parametrization().dimY();
+         std::vector<double> deltas(nY, delta);
+         const bool fitted = fit_channels(*r, [&](int j, rational_function_1d* rf)
          {
             vec p(np), q(nq);
-            rational_function_1d* rf = r->get(j);
             rf->resize(np, nq);
 
-            if(!fit_data(d, np, nq, j, rf, args, p, q, delta))
+            if(!fit_data(d, np, nq, j, rf, args, p, q, deltas[j]))
             {
                return false ;
             }
 
             rf->update(p, q);
+            return true ;
+         });
+
+         if(!fitted)
+         {
+            return false ;
          }
+         delta = deltas[nY-1];
 
          linf_dist = r->Linf_distance(dynamic_pointer_cast<data>(d));
          l2_dist   = r->L2_distance(dynamic_pointer_cast<data>(d));
@@ -296,10 +318,12 @@ class rational_fitter_parallel : public fitter
          const int m = d->size(); // 2*m = number of constraints
          const int n = np+nq;     // n = np+nq
 
-         quadratic_program qp(np, nq, args.is_defined("use_delta"));
+         quadratic_program qp(np, nq, args.is_defined("use_delta"),
+                              args.get_int("nb-violators", 1),
+                              nb_threads_per_fit);
 
          // Starting with only a nb_starting_points vertical segments
-         std::list<unsigned int> training_set;
+         std::vector<unsigned int> training_set;
          const int di = std::max((m-1) / (nb_starting_points-1), 1);
          for(int i=0; i<m; ++i)
          {
@@ -333,7 +357,14 @@ class rational_fitter_parallel : public fitter
 
             if(solves_qp)
             {
-               if(qp.test_constraints(ny, r, d))
+               const bool satisfied = qp.test_constraints(ny, r, d);
+#ifdef DEBUG
+               const quadratic_program::iteration_timing& t = qp.timings().back();
+               std::cout << "<<DEBUG>> solve: " << t.solve << "s, test: " << t.test
+                         << "s, " << t.violated << " violated, " << t.added
+                         << " added" << std::endl;
+#endif
+               if(satisfied)
                {
 #ifdef DEBUG
                   std::cout << "<<INFO>> got solution " << *r << std::endl ;
@@ -358,31 +389,19 @@ class rational_fitter_parallel : public fitter
             const rational_function_1d* func,
             vec& cu, vec& cl)
       {
-         const vec xi = data->get(i) ;
+         const vec xi = data->x_view().row(i) ;
+         const double yl = data->yl_view()(i, ny) ;
+         const double yu = data->yu_view()(i, ny) ;
          cu.resize(np+nq);
          cl.resize(np+nq);
 
-         // Create two vectors of constraints
-         for(int j=0; j<np+nq; ++j)
-         {
-            // Filling the p part
-            if(j<np)
-            {
-               const double pi = func->p(xi, j) ;
-               cu[j] =  pi ;
-               cl[j] = -pi ;
-            }
-            // Filling the q part
-            else
-            {
-               vec yl, yu ;
-               data->get(i, yl, yu) ;
-               const double qi = func->q(xi, j-np) ;
+         // Evaluate all the basis functions at once
+         func->basis(xi, cu.head(np), cu.tail(nq));
 
-               cu[j] = -yu[ny] * qi ;
-               cl[j] =  yl[ny] * qi ;
-            }
-         }
+         // Create two vectors of constraints
+         cl.head(np) = -cu.head(np);
+         cl.tail(nq) =  yl * cu.tail(nq);
+         cu.tail(nq) *= -yu;
       }
 };
 
@@ -13,23 +13,53 @@
 #include <Eigen/Dense>
 #include <QuadProg++.hh>
 
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <core/common.h>
 #include <core/rational_function.h>
 #include <core/vertical_segment.h>
 
+#include "active_set_qp.h"
+
 using namespace alta;
 
 class quadratic_program
 {
    public:
-      //! \brief Constructor need to specify the number of coefficients
-      quadratic_program(int np, int nq, bool compute_delta = false) :
-        _np(np), _nq(nq), _compute_delta(compute_delta), CI(_np+_nq, 0)
+      //! \brief Timings, in seconds, and statistics of one iteration of
+      //! the constraint-adding loop.
+      struct iteration_timing
+      {
+         double solve;  //!< Time spent solving the program
+         double test;   //!< Time spent searching for violated constraints
+         int violated;  //!< Number of violated constraints
+         int added;     //!< Number of constraints added to the program
+      };
+
+      //! \brief Constructor need to specify the number of coefficients.
+      //! At most NB_VIOLATORS of the most violated constraints are added
+      //! at each call to \a test_constraints, which evaluates the function
+      //! on at most NB_THREADS threads (the OpenMP default if zero).
+      //!
+      //! When the program is solved inside another parallel region, the
+      //! evaluation is a nested region: it only uses more than one thread if
+      //! nested parallelism is enabled, and otherwise runs serially on the
+      //! calling thread.
+      quadratic_program(int np, int nq, bool compute_delta = false,
+                        int nb_violators = 1, int nb_threads = 0) :
+        _np(np), _nq(nq), _compute_delta(compute_delta),
+        _nb_violators(std::max(nb_violators, 1)), _nb_threads(nb_threads),
+        _last_solve(0.0),
+        CI(_np+_nq, 0), _qp(_np+_nq), _qp_delta(0.0)
       { }
 
       //! \brief Remove the already defined constraints
       void clear_constraints()
       {
          CI.resize(_np+_nq, 0);
+         _qp = active_set_qp(_np+_nq);
       }
 
       //! \brief Add a constraint by specifying the vector
@@ -57,11 +87,18 @@ class quadratic_program
       }
 
       //! Set the indices of the remaining data
-      void set_training_set(const std::list<unsigned int>& ts)
+      void set_training_set(const std::vector<unsigned int>& ts)
       {
          this->training_set = ts;
       }
 
+      //! \brief Timings of the iterations done so far, one entry per call
+      //! to \a test_constraints.
+      const std::vector<iteration_timing>& timings() const
+      {
+         return _timings;
+      }
+
       //! \brief Solves the quadratic program and update the p and
       //! q vector if necessary.
       inline bool solve_program(Eigen::VectorXd& x, double& delta, vec& p, vec& q)
@@ -92,9 +129,46 @@ class quadratic_program
          }
       }
 
-      //! \brief Solves the quadratic program
+      //! \brief Solves the quadratic program.
+      //!
+      //! \details
+      //! Unless the delta parameter is computed from the constraints, the
+      //! program is solved incrementally: the solver keeps its active set
+      //! between calls and only processes the constraints added since the
+      //! last one.
       inline bool solve_program(Eigen::VectorXd& v, double& delta)
       {
+         const auto start = std::chrono::steady_clock::now();
+
+         if(!_compute_delta)
+         {
+            // Restart when the constraint vector changed
+            if(delta != _qp_delta || _qp.nb_constraints() > CI.cols())
+            {
+               _qp = active_set_qp(_np+_nq);
+               _qp_delta = delta;
+            }
+
+            for(int i=_qp.nb_constraints(); i<CI.cols(); ++i)
+            {
+               _qp.add_constraint(CI.col(i), -delta * CI.col(i).norm());
+            }
+
+            vec x;
+            const bool solves_qp = _qp.solve(x);
+            if(solves_qp)
+            {
+               v = x;
+            }
+            else
+            {
+               // The state of the solver is not usable anymore
+               _qp = active_set_qp(_np+_nq);
+            }
+
+            _last_solve = seconds_since(start);
+            return solves_qp;
+         }
          const int m = CI.rows();
          const int n = CI.cols();
 
@@ -138,6 +212,7 @@ class quadratic_program
 
          // Compute the solution
          const double cost = QuadProgPP::solve_quadprog(G, g, CE, ce, CI, ci, v);
+         _last_solve = seconds_since(start);
 
          bool solves_qp = !(cost == std::numeric_limits<double>::infinity());
          return solves_qp;
@@ -146,68 +221,98 @@ class quadratic_program
 #define PACANOWSKI2012
 
         //! \brief Test all the constraints of the data.
-        //! Add the sample that is farest away from the function.
+        //! Add the samples that are farest away from the function.
       bool test_constraints(int ny, const rational_function_1d* r, const ptr<vertical_segment>& data)
       {
 #ifdef PACANOWSKI2012
-            int nb_failed = 0;
-            double max_dev = 0.0; // Maximum absolute distance of the current
-                                  // solution to the data.
-            std::list<unsigned int>::iterator max_ind;
-            vec cu, cl;
-
-            std::list<unsigned int>::iterator it;
-            for(it = training_set.begin(); it != training_set.end(); it++)
+            const auto start = std::chrono::steady_clock::now();
+            const int n = training_set.size();
+
+            // Read the samples through column views of the data
+            const auto X  = data->x_view();
+            const auto YL = data->yl_view().col(ny);
+            const auto YU = data->yu_view().col(ny);
+
+            // Evaluate the function on chunks of the remaining samples in
+            // parallel, and store the distance of each violated constraint
+            // to the middle of its interval (zero when it is satisfied).
+            vec dev(n);
+            parallel_for_chunks(n, chunk_size, [&](int, int first, int count)
             {
-               vec x, yl, yu;
-               data->get(*it, x, yl, yu);
-
-               vec y = r->value(x);
-               bool fail_upper = y[0] > yu[ny];
-               bool fail_lower = y[0] < yl[ny];
-               if(fail_lower || fail_upper)
+               RowMatrixXd x(count, X.cols()), y(count, 1);
+               for(int k=0; k<count; ++k)
                {
-                  const double dev = std::abs(0.5*(yu[ny]+yl[ny]) - y[0]);
-
-                  nb_failed++;
+                  x.row(k) = X.row(training_set[first + k]);
+               }
+               r->values(x, y);
 
-                  if(max_dev < dev)
-                  {
-                     get_constraint(x, yl, yu, ny, r, cu, cl);
-                     max_dev = dev;
-                     max_ind = it;
-                  }
+               for(int k=0; k<count; ++k)
+               {
+                  const int i = training_set[first + k];
+                  const bool fail = y(k, 0) < YL[i] || y(k, 0) > YU[i];
+                  dev[first + k] = fail ? std::abs(0.5*(YU[i]+YL[i]) - y(k, 0)) : 0.0;
                }
+            }, _nb_threads);
+
+            // Select the most violated constraints, the first ones in the
+            // training set in case of ties.
+            std::vector<int> failed;
+            for(int k=0; k<n; ++k)
+            {
+               if(dev[k] > 0.0) { failed.push_back(k); }
             }
+            const int nb_failed = failed.size();
+            const int nb_added  = std::min(nb_failed, _nb_violators);
+            std::partial_sort(failed.begin(), failed.begin() + nb_added, failed.end(),
+                              [&](int a, int b)
+                              {
+                                 return dev[a] > dev[b] || (dev[a] == dev[b] && a < b);
+                              });
+            failed.resize(nb_added);
+
 #ifdef DEBUG
             std::cout << "<<TRACE>> " << nb_failed << " constraints where not satified." << std::endl;
-            std::cout << "<<TRACE>> an interval failed the test with distance = " << max_dev << std::endl;
-#endif
-
             if(nb_failed > 0)
             {
-                add_constraints(cu);
-                add_constraints(cl);
-                training_set.erase(max_ind);
-#ifdef DEBUG
-                std::cout << "<<DEBUG>> number of remaining training elements: " << training_set.size() << std::endl;
+               std::cout << "<<TRACE>> an interval failed the test with distance = " << dev[failed[0]] << std::endl;
+            }
 #endif
 
-                return false;
+            vec x(X.cols()), cu, cl;
+            for(int k : failed)
+            {
+               const int i = training_set[k];
+               x = X.row(i);
+               get_constraint(x, YL[i], YU[i], r, cu, cl);
+               add_constraints(cu);
+               add_constraints(cl);
             }
-            else
+
+            // Remove the added samples from the training set, keeping the
+            // order of the others.
+            std::sort(failed.begin(), failed.end());
+            for(int k=nb_added-1; k>=0; --k)
             {
-                return true;
+               training_set.erase(training_set.begin() + failed[k]);
             }
+#ifdef DEBUG
+            std::cout << "<<DEBUG>> number of remaining training elements: " << training_set.size() << std::endl;
+#endif
+
+            const iteration_timing timing = { _last_solve, seconds_since(start),
+                                              nb_failed, nb_added };
+            _timings.push_back(timing);
+
+            return nb_failed == 0;
 #else
             int n = next_unmatching_constraint(0, ny, r, data);
             if(n < data->size())
             {
-                vec x, yl, yu;
-                data->get(n, x, yl, yu);
+                const vec x = data->x_view().row(n);
 
                 vec cu, cl;
-                get_constraint(x, yl, yu, ny, r, cu, cl);
+                get_constraint(x, data->yl_view()(n, ny), data->yu_view()(n, ny),
+                               r, cu, cl);
 
                 add_constraints(cu);
                 add_constraints(cl);
@@ -221,9 +326,9 @@ class quadratic_program
 #endif
       }
 
-      //! \brief Generate two constraint vectors from a vertical segment and a
-      //! ration function type.
-      inline void get_constraint(const vec& xi, const vec& yl, const vec& yu, int ny,
+      //! \brief Generate two constraint vectors from a vertical segment
+      //! [YL, YU] at XI and a ration function type.
+      inline void get_constraint(const vec& xi, double yl, double yu,
                                  const rational_function_1d* func,
                                  vec& cu, vec& cl);
 
@@ -233,55 +338,64 @@ class quadratic_program
                                             const vertical_segment* data);
 
    protected:
+      //! \brief Number of samples evaluated at once by a thread.
+      static const int chunk_size = 1024;
+
+      //! \brief Return the time elapsed since START in seconds.
+      static double seconds_since(std::chrono::steady_clock::time_point start)
+      {
+         return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
+
       int _np, _nq;
       bool _compute_delta;
+      int _nb_violators;
+      int _nb_threads;
+      double _last_solve;
       Eigen::MatrixXd CI;
 
+      //! Incremental solver, and the delta parameter of its constraints.
+      active_set_qp _qp;
+      double _qp_delta;
+
       //! Contains the indices of the vertical segment unused during the
       //! rational interpolation.
-      std::list<unsigned int> training_set;
+      std::vector<unsigned int> training_set;
+
+      std::vector<iteration_timing> _timings;
 };
 
 
-inline void quadratic_program::get_constraint(const vec& xi, const vec& yl, const vec& yu,
-                                              int ny, const rational_function_1d* func,
+inline void quadratic_program::get_constraint(const vec& xi, double yl, double yu,
+                                              const rational_function_1d* func,
                                               vec& cu, vec& cl)
 {
    cu.resize(_np+_nq);
    cl.resize(_np+_nq);
 
-   // Create two vector of constraints
-   for(int j=0; j<_np+_nq; ++j)
-   {
-      // Filling the p part
-      if(j<_np)
-      {
-         const double pi = func->p(xi, j) ;
-         cu[j] =  pi ;
-         cl[j] = -pi ;
-
-      }
-      // Filling the q part
-      else
-      {
-         const double qi = func->q(xi, j-_np) ;
+   // Evaluate all the basis functions at once
+   func->basis(xi, cu.head(_np), cu.tail(_nq));
 
-         cu[j] = -yu[ny] * qi ;
-         cl[j] =  yl[ny] * qi ;
-      }
-   }
+   // Create two vector of constraints
+   cl.head(_np) = -cu.head(_np);
+   cl.tail(_nq) =  yl * cu.tail(_nq);
+   cu.tail(_nq) *= -yu;
 }
 
 int quadratic_program::next_unmatching_constraint(int i, int ny, const rational_function_1d* r,
                                                   const vertical_segment* data)
 {
+   const auto X  = data->x_view();
+   const auto YL = data->yl_view().col(ny);
+   const auto YU = data->yu_view().col(ny);
+   vec x(X.cols());
+
    for(int n=i; n<data->size(); ++n)
    {
-      vec x, yl, yu;
-      data->get(n, x, yl, yu);
+      x = X.row(n);
 
       vec y = r->value(x);
-        if(y[0] < yl[ny] || y[0] > yu[ny])
+      if(y[0] < YL[n] || y[0] > YU[n])
       {
          return n;
       }
@@ -91,10 +91,21 @@ double chebychev(double x, int i) {
 #endif
 }
 
+void rational_function_chebychev_1d::basis_table(double x, vecref t) const
+{
+	// T_{k} = 2 x T_{k-1} - T_{k-2}
+	t[0] = 1.0;
+	if(t.size() > 1) { t[1] = x; }
+	for(int k=2; k<t.size(); ++k)
+	{
+		t[k] = 2.0*x*t[k-1] - t[k-2];
+	}
+}
+
 // Get the p_i and q_j function
 double rational_function_chebychev_1d::p(const vec& x, int i) const
 {
-	std::vector<int> deg = index2degree(i);
+	const std::vector<int>& deg = degree(i);
 	double res = 1.0;
 	for(int k=0; k<_parameters.dimX(); ++k)
 	{
@@ -106,7 +117,7 @@ double rational_function_chebychev_1d::p(const vec& x, int i) const
 }
 double rational_function_chebychev_1d::q(const vec& x, int i) const
 {
-	std::vector<int> deg = index2degree(i);
+	const std::vector<int>& deg = degree(i);
 	double res = 1.0; 
 	for(int k=0; k<_parameters.dimX(); ++k)
 	{
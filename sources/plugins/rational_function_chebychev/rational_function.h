@@ -40,6 +40,10 @@ public: // methods
 
 protected:  // methods
 
+    // Evaluate the Chebychev polynomials of all degrees at once
+    virtual void basis_table(double x, vecref t) const ;
+    virtual bool monomial_basis() const { return false; }
+
 } ;
 
 /*! \ingroup functions
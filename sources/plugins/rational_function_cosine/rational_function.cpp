@@ -63,36 +63,76 @@ double rational_function_legendre_1d::legendre(double x, int i) const
 	}
 	else
 	{
-		return ((2*i-1)*x*legendre(x, i-1) - (i-1)*legendre(x, i-2)) / (double)i ;
+		// Bonnet's recurrence from the hard coded terms
+		double p0 = legendre(x, 6), p1 = legendre(x, 7);
+		for(int k=8; k<=i; ++k)
+		{
+			const double pk = ((2*k-1)*x*p1 - (k-1)*p0) / (double)k;
+			p0 = p1;
+			p1 = pk;
+		}
+		return p1;
 	}
 }
 
-// Get the p_i and q_j function
-double rational_function_legendre_1d::p(const vec& x, int i) const
+void rational_function_legendre_1d::basis_table(double x, vecref t) const
 {
-	std::vector<int> deg = index2degree(i);
-	double res = 1.0;
-	for(int k=0; k<_parameters.dimX(); ++k)
+	t[0] = 1.0;
+	if(t.size() > 1) { t[1] = x; }
+	for(int k=2; k<t.size(); ++k)
 	{
-		res *= legendre(2.0*((x[k] - _min[k]) / (_max[k]-_min[k]) - 0.5), deg[k]);
+		t[k] = ((2*k-1)*x*t[k-1] - (k-1)*t[k-2]) / (double)k;
 	}
+}
 
+double rational_function_legendre_1d::cosine_factor(const double* x) const
+{
 	// Apply cosine factor to the result if a parametrization was
 	// set. I apply both cos(theta_l) and cos(theta_v).
 	if(_parameters.input_parametrization() != params::UNKNOWN_INPUT)
 	{
 		double cart[6];
-		params::convert(&x[0], _parameters.input_parametrization(),
+		params::convert(x, _parameters.input_parametrization(),
                     params::CARTESIAN, cart);
 
-		res *= cart[2]*cart[5];
+		return cart[2]*cart[5];
 	}
 
-	return res ;
+	return 1.0;
+}
+
+void rational_function_legendre_1d::basis(const vec& x, vecref p, vecref q) const
+{
+	rational_function_1d::basis(x, p, q);
+	p *= cosine_factor(x.data());
+}
+
+void rational_function_legendre_1d::bases(const Eigen::Ref<const RowMatrixXd>& x,
+                                          Eigen::Ref<RowMatrixXd> p,
+                                          Eigen::Ref<RowMatrixXd> q) const
+{
+	rational_function_1d::bases(x, p, q);
+	for(int i=0; i<x.rows(); ++i)
+	{
+		p.row(i) *= cosine_factor(x.row(i).data());
+	}
+}
+
+// Get the p_i and q_j function
+double rational_function_legendre_1d::p(const vec& x, int i) const
+{
+	const std::vector<int>& deg = degree(i);
+	double res = 1.0;
+	for(int k=0; k<_parameters.dimX(); ++k)
+	{
+		res *= legendre(2.0*((x[k] - _min[k]) / (_max[k]-_min[k]) - 0.5), deg[k]);
+	}
+
+	return res * cosine_factor(x.data());
 }
 double rational_function_legendre_1d::q(const vec& x, int i) const 
 {
-	std::vector<int> deg = index2degree(i);
+	const std::vector<int>& deg = degree(i);
 	double res = 1.0;
 	for(int k=0; k<_parameters.dimX(); ++k)
 	{
@@ -35,12 +35,23 @@ class rational_function_legendre_1d : public rational_function_1d
 		// Get the p_i and q_j function
 		virtual double p(const vec& x, int i) const ;
 		virtual double q(const vec& x, int j) const ;
+		virtual void basis(const vec& x, vecref p, vecref q) const ;
+		virtual void bases(const Eigen::Ref<const RowMatrixXd>& x,
+		                   Eigen::Ref<RowMatrixXd> p,
+		                   Eigen::Ref<RowMatrixXd> q) const ;
 
 	protected:  // methods
 
 		// Legendre polynomial evaluation
 		double legendre(double x, int i) const;
 
+		// Evaluate the Legendre polynomials of all degrees at once
+		virtual void basis_table(double x, vecref t) const;
+		virtual bool monomial_basis() const { return false; }
+
+		// Cosine factor applied to the numerator at X
+		double cosine_factor(const double* x) const;
+
   private:
 		rational_function_legendre_1d() ;
 } ;
@@ -31,24 +31,36 @@ rational_function_legendre_1d::rational_function_legendre_1d(int nX, int np, int
 
 double rational_function_legendre_1d::legendre(double x, int i) const
 {
+	// Bonnet's recurrence: i P_i = (2i-1) x P_{i-1} - (i-1) P_{i-2}
+	double p0 = 1.0, p1 = x;
 	if(i == 0)
 	{
-		return 1;
+		return p0;
 	}
-	else if(i == 1)
+
+	for(int k=2; k<=i; ++k)
 	{
-		return x;
+		const double pk = ((2*k-1)*x*p1 - (k-1)*p0) / (double)k;
+		p0 = p1;
+		p1 = pk;
 	}
-	else
+	return p1;
+}
+
+void rational_function_legendre_1d::basis_table(double x, vecref t) const
+{
+	t[0] = 1.0;
+	if(t.size() > 1) { t[1] = x; }
+	for(int k=2; k<t.size(); ++k)
 	{
-		return ((2*i-1)*x*legendre(x, i-1) - (i-1)*legendre(x, i-2)) / (double)i ;
+		t[k] = ((2*k-1)*x*t[k-1] - (k-1)*t[k-2]) / (double)k;
 	}
 }
 
 // Get the p_i and q_j function
 double rational_function_legendre_1d::p(const vec& x, int i) const
 {
-	std::vector<int> deg = index2degree(i);
+	const std::vector<int>& deg = degree(i);
 	double res = 1.0;
 	for(int k=0; k<_parameters.dimX(); ++k)
 	{
@@ -40,6 +40,10 @@ class rational_function_legendre_1d : public rational_function_1d
 
 		// Legendre polynomial evaluation
 		double legendre(double x, int i) const;
+
+		// Evaluate the Legendre polynomials of all degrees at once
+		virtual void basis_table(double x, vecref t) const;
+		virtual bool monomial_basis() const { return false; }
 } ;
 
 /*! \ingroup functions
@@ -54,9 +58,9 @@ class rational_function_legendre_1d : public rational_function_1d
  *  \f$ f(x) = \sum a_i p_i(x) / b_i q_{i}(x) \f$, with \f$ p_i = q_i\f$.
  *  </center>
  *
- *  Legendre polynomials can be defined using a recursive formulation (see Wikipedia
- *  page). Consequently, they qre less performant compared to Chebychev polynomials
- *  for higher order expansions. The first terms of the basis are hard coded.
+ *  Legendre polynomials are evaluated with Bonnet's three-term recurrence (see
+ *  Wikipedia page): all the degrees of a coordinate are computed at once when
+ *  evaluating the basis, in time linear in the highest degree.
  *
  *  For more details see the addendum on Rational BRDF available at https://hal.inria.fr/hal-00913516
  *
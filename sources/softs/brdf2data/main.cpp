@@ -19,6 +19,8 @@
 #include <core/args.h>
 #include <core/data.h>
 #include <core/vertical_segment.h>
+#include <core/streaming_data.h>
+#include <core/data_storage.h>
 #include <core/params.h>
 #include <core/function.h>
 #include <core/fitter.h>
@@ -31,6 +33,7 @@
 #include <limits>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
 
 using namespace alta;
 
@@ -93,34 +96,75 @@ int main(int argc, char** argv)
    if(d && f != NULL)
    {
       const bool output_dif = args.is_defined("export-diff");
+      const int nX = d->parametrization().dimX();
+      const int nY = d->parametrization().dimY();
+
+      // Streaming data is read-only and may not fit in memory: write the
+      // output as we go rather than updating D.
+      const bool streaming = dynamic_pointer_cast<streaming_data>(d) != NULL;
+      std::ofstream output;
+      if(streaming)
+      {
+         output.exceptions(std::ios_base::failbit);
+         output.open(args["output"].c_str());
+         save_text_header(output, d->parametrization());
+      }
 
-      vec temp(f->parametrization().dimX());
-      for(int i=0; i<d->size(); ++i)
+      // Process the data block by block.
+      RowMatrixXd block(std::min(d->block_size(), d->size()), nX + nY);
+      for(int first=0; first<d->size(); first += block.rows())
       {
-         // Copy the input vector
-         vec x = d->get(i);
+         if(d->size() - first < block.rows())
+         {
+            block.conservativeResize(d->size() - first, Eigen::NoChange);
+         }
+         d->get_block(first, block);
 
          // Convert the data to the function's input space.
+         RowMatrixXd xs(block.rows(), f->parametrization().dimX());
          if(f->parametrization().input_parametrization() == params::UNKNOWN_INPUT)
          {
-            temp = x.head(f->parametrization().dimX());
+            xs = block.leftCols(f->parametrization().dimX());
          }
          else
          {
-            params::convert(&x[0],
+            params::convert(block.data(),
                             d->parametrization().input_parametrization(),
                             f->parametrization().input_parametrization(),
-                            &temp[0]);
+                            xs.data(), block.rows(), block.cols(), xs.cols());
          }
 
          // Eval BRDF
-         vec y = f->value(temp);
-         x.tail(d->parametrization().dimY()) = (output_dif) ? x.tail(d->parametrization().dimY())-y : y;
-         d->set(i, x);
-      }  
+         RowMatrixXd ys(block.rows(), f->parametrization().dimY());
+         f->values(xs, ys);
+         if(output_dif)
+         {
+            block.rightCols(nY) -= ys;
+         }
+         else
+         {
+            block.rightCols(nY) = ys;
+         }
+
+         if(!streaming)
+         {
+            for(int i=0; i<block.rows(); ++i)
+            {
+               d->set(first + i, block.row(i).transpose());
+            }
+         }
+
+         if(streaming)
+         {
+            save_text_rows(output, block);
+         }
+      }
 
       // Save data to file
-      d->save(args["output"]);
+      if(!streaming)
+      {
+         d->save(args["output"]);
+      }
    }  
    else
    {
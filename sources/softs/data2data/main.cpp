@@ -106,9 +106,13 @@
 #include <limits>
 #include <cstdlib>
 #include <cmath>
+#include <atomic>
 
 using namespace alta;
 
+// Number of output points interpolated at once by a thread.
+static const int chunk_size = 1024;
+
 static parameters compute_parameters(const data& d_in,
                                      const arguments& args)
 {
@@ -229,45 +233,70 @@ static void convert_with_interpolation(ptr<data> d_in, ptr<data> d_out)
         std::cerr << "            This is currently not handled properly by ALTA." << std::endl;
 		}
 
-    unsigned int stats_incorrect = 0;
+    const params::input in_param  = d_in->parametrization().input_parametrization();
+    const params::input out_param = d_out->parametrization().input_parametrization();
+    const int in_dimX  = d_in->parametrization().dimX();
+    const int in_dimY  = d_in->parametrization().dimY();
+    const int out_dimX = d_out->parametrization().dimX();
+    const int out_dimY = d_out->parametrization().dimY();
 
-#pragma omp parallel for
-		for(int i=0; i<d_out->size(); ++i)
-		{
-        vec temp(d_in->parametrization().dimX());
-        vec cart(6);
-        vec y(d_in->parametrization().dimY());
+    std::atomic<unsigned int> stats_incorrect(0);
 
-        // Copy the input vector
-        vec x = d_out->get(i);
-        params::convert(&x[0],
-                        d_out->parametrization().input_parametrization(),
-                        params::CARTESIAN, &cart[0]);
+    // Interpolate chunks of the output points at once, so that the input
+    // data can process all the queries of a chunk together.
+    parallel_for_chunks(d_out->size(), chunk_size,
+                        [&](int, int first, int count)
+    {
+        RowMatrixXd x(count, out_dimX + out_dimY);
+        d_out->get_block(first, x);
 
+        RowMatrixXd cart(count, 6);
+        params::convert(x.data(), out_param, params::CARTESIAN, cart.data(),
+                        count, x.cols(), 6);
 
         // Check if the output configuration is below the hemisphere when
         // converted to cartesian coordinates. Note that this prevent from
         // converting BTDF data.
-        if(cart[2] >= 0.0 && cart[5] >= 0.0) {
-            params::convert(&cart[0], params::CARTESIAN,
-                            d_in->parametrization().input_parametrization(),
-                            &temp[0]);
-            y = d_in->value(temp);
-        } else {
-            ++stats_incorrect;
-            y.setZero();
+        std::vector<int> valid;
+        valid.reserve(count);
+        for(int i=0; i<count; ++i)
+        {
+            if(cart(i, 2) >= 0.0 && cart(i, 5) >= 0.0) { valid.push_back(i); }
         }
+        stats_incorrect += count - valid.size();
 
-        // Convert the value stored in the input data in the value format of
-        // the output data file.
-        params::convert(&y[0],
-                        d_in->parametrization().output_parametrization(),
-                        d_in->parametrization().dimY(),
-                        d_out->parametrization().output_parametrization(), d_out->parametrization().dimY(),
-                        &x[d_out->parametrization().dimX()]);
+        RowMatrixXd valid_cart(valid.size(), 6);
+        for(unsigned int k=0; k<valid.size(); ++k)
+        {
+            valid_cart.row(k) = cart.row(valid[k]);
+        }
 
-        d_out->set(i, x);
-		}
+        RowMatrixXd temp(valid.size(), in_dimX);
+        params::convert(valid_cart.data(), params::CARTESIAN, in_param,
+                        temp.data(), valid.size(), 6, in_dimX);
+
+        RowMatrixXd valid_y(valid.size(), in_dimY);
+        d_in->values(temp, valid_y);
+
+        RowMatrixXd y = RowMatrixXd::Zero(count, in_dimY);
+        for(unsigned int k=0; k<valid.size(); ++k)
+        {
+            y.row(valid[k]) = valid_y.row(k);
+        }
+
+        for(int i=0; i<count; ++i)
+        {
+            // Convert the value stored in the input data in the value format of
+            // the output data file.
+            params::convert(y.row(i).data(),
+                            d_in->parametrization().output_parametrization(),
+                            in_dimY,
+                            d_out->parametrization().output_parametrization(), out_dimY,
+                            &x(i, out_dimX));
+
+            d_out->set(first + i, x.row(i).transpose());
+        }
+    });
 
     if(stats_incorrect > 0) {
         std::cerr << "<<DEBUG>> Number of incorrect configuration: "
@@ -0,0 +1,103 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the incremental active-set solver of the rational fitters
+ * reaches the optimum of random feasible programs, and that adding
+ * constraints to a solved program gives the same solution as solving it
+ * from scratch.  */
+
+#include <plugins/rational_fitters/active_set_qp.h>
+#include <tests.h>
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace alta;
+using namespace alta::tests;
+
+static const int n = 8, m = 400;
+static const double tolerance = 1e-8;
+
+// Return true if X satisfies the KKT conditions of QP, whose constraints
+// are C^T x + C0 >= 0 and whose objective is 1/2 x^T G x.
+static bool is_optimal(const active_set_qp& qp, const Eigen::MatrixXd& G,
+                       const Eigen::MatrixXd& C, const vec& c0, const vec& x)
+{
+    const vec s = C.transpose() * x + c0;
+    if (s.minCoeff() < -tolerance)
+        return false;
+
+    const std::vector<int> active = qp.active_set();
+    const vec u = qp.multipliers();
+    vec grad = G * x;
+    for (unsigned int k = 0; k < active.size(); ++k)
+    {
+        if (u[k] < -tolerance || std::abs(s[active[k]]) > tolerance)
+            return false;
+        grad -= u[k] * C.col(active[k]);
+    }
+
+    return grad.norm() < tolerance * std::max(1.0, x.norm());
+}
+
+// Solve a random feasible program with G, once with all its constraints
+// and once adding them in batches.
+static void test_program(const Eigen::MatrixXd& G)
+{
+    // Constraints satisfied by a random point.
+    const vec xf = vec::Random(n);
+    const Eigen::MatrixXd C = Eigen::MatrixXd::Random(n, m);
+    const vec c0 = -C.transpose() * xf
+        + 0.1 * (vec::Random(m) + vec::Ones(m));
+
+    active_set_qp cold(G);
+    for (int i = 0; i < m; ++i)
+        cold.add_constraint(C.col(i), c0[i]);
+
+    vec x_cold;
+    TEST_ASSERT(cold.solve(x_cold));
+    TEST_ASSERT(is_optimal(cold, G, C, c0, x_cold));
+
+    active_set_qp warm(G);
+    vec x_warm;
+    for (int i = 0; i < m; ++i)
+    {
+        warm.add_constraint(C.col(i), c0[i]);
+        if ((i + 1) % 50 == 0)
+        {
+            TEST_ASSERT(warm.solve(x_warm));
+            TEST_ASSERT(is_optimal(warm, G, C.leftCols(i + 1),
+                                   c0.head(i + 1), x_warm));
+        }
+    }
+    TEST_ASSERT((x_warm - x_cold).norm() < tolerance);
+}
+
+int main(int argc, char** argv)
+{
+    std::srand(1);
+
+    test_program(Eigen::MatrixXd::Identity(n, n));
+
+    const Eigen::MatrixXd A = Eigen::MatrixXd::Random(n, n);
+    test_program(A * A.transpose() + Eigen::MatrixXd::Identity(n, n));
+
+    // An infeasible program: x >= 1 and x <= -1 on the first coordinate.
+    active_set_qp qp(n);
+    vec c = vec::Zero(n);
+    c[0] = 1.0;
+    qp.add_constraint(c, -1.0);
+    qp.add_constraint(-c, -1.0);
+
+    vec x;
+    TEST_ASSERT(!qp.solve(x));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the adaptive grid interpolant meets its tolerance on a BRDF
+ * with a sharp peak while storing few vertices, that its batch and
+ * point-wise queries agree, that it loads back identically, and that
+ * truncated or corrupted files are rejected.  */
+
+#include <core/data.h>
+#include <core/params.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <unistd.h>
+
+using namespace alta;
+
+// A diffuse term and a peak around theta_h = 0, in RUSIN_TH_TD_PD.
+static vec brdf(const vec& x)
+{
+    const double peak = 50.0 * std::exp(-(x[0] * x[0]) / 0.01);
+    vec y(3);
+    y[0] = 0.1 + peak;
+    y[1] = 0.2 + 0.05 * std::cos(x[1]) + 0.5 * peak;
+    y[2] = 0.3 + 0.01 * std::cos(x[2]);
+    return y;
+}
+
+// Load the adaptive grid in FILE, discarding the error messages.
+static bool load_quietly(const std::string& file)
+{
+    std::streambuf* err = std::cerr.rdbuf(NULL);
+    ptr<data> loaded = plugins_manager::load_data(file, "data_adaptive_grid");
+    std::cerr.rdbuf(err);
+    return bool(loaded);
+}
+
+int main()
+{
+    const parameters params(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR);
+    const double tolerance = 0.01, floor = 0.001;
+    arguments args;
+    args.update("grid-levels", "6");
+    args.update("grid-tolerance", "0.01");
+
+    ptr<data> grid = plugins_manager::get_data("data_adaptive_grid", 0,
+                                               params, args);
+    TEST_ASSERT(grid && grid->size() == 65 * 65 * 65);
+
+    for (int i = 0; i < grid->size(); ++i)
+    {
+        vec x = grid->get(i);
+        x.tail(3) = brdf(x.head(3));
+        grid->set(i, x);
+    }
+
+    // Random queries, which build the tree: batch and point-wise queries
+    // agree.
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> theta(0.0, 0.5 * M_PI);
+    std::uniform_real_distribution<double> phi(0.0, 2.0 * M_PI);
+    const int rows = 10000;
+    RowMatrixXd x(rows, 3), y(rows, 3);
+    for (int i = 0; i < rows; ++i)
+    {
+        x(i, 0) = theta(gen);
+        x(i, 1) = theta(gen);
+        x(i, 2) = phi(gen);
+    }
+    grid->values(x, y);
+
+    double batch_error = 0.0;
+    for (int i = 0; i < rows; ++i)
+    {
+        const vec yi = grid->value(x.row(i).transpose());
+        batch_error = std::max(batch_error,
+                               (yi - y.row(i).transpose()).cwiseAbs().maxCoeff());
+    }
+    TEST_ASSERT(batch_error == 0.0);
+
+    // The tree reproduces the samples within the tolerance.
+    double error = 0.0;
+    for (int i = 0; i < grid->size(); ++i)
+    {
+        const vec xi = grid->get(i);
+        const vec yi = brdf(xi.head(3));
+        error = std::max(error,
+                         ((xi.tail(3) - yi).array().abs()
+                          / (yi.array().abs() + floor)).maxCoeff());
+    }
+    std::cout << "<<INFO>> max relative error at the samples " << error
+              << std::endl;
+    TEST_ASSERT(error <= tolerance);
+
+    // The saved grid is much smaller than the lattice, and loads back
+    // identically.
+    const std::string file = "t-adaptive-grid.binary";
+    grid->save(file);
+    std::ifstream saved(file, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(saved)),
+                            std::istreambuf_iterator<char>());
+    ptr<data> loaded = plugins_manager::load_data(file, "data_adaptive_grid");
+
+    std::cout << "<<INFO>> " << bytes.size() << " bytes saved for a lattice of "
+              << grid->size() * 3 * sizeof(double) << " bytes" << std::endl;
+    TEST_ASSERT(bytes.size() < grid->size() * 3 * sizeof(double) / 500);
+
+    // Truncated files and trees referring to nodes out of the file are
+    // rejected.
+    const size_t stream = bytes.find("#BEGIN_STREAM\n") + 14;
+    TEST_ASSERT(stream < bytes.size());
+    std::ofstream(file, std::ios::binary) << bytes.substr(0, bytes.size() - 8);
+    TEST_ASSERT(!load_quietly(file));
+
+    std::string corrupted = bytes;
+    const int32_t root = 0x7ffffff8;
+    std::memcpy(&corrupted[stream], &root, sizeof(root));
+    std::ofstream(file, std::ios::binary) << corrupted;
+    TEST_ASSERT(!load_quietly(file));
+    ::unlink(file.c_str());
+
+    TEST_ASSERT(loaded && loaded->size() == grid->size());
+    RowMatrixXd loaded_y(rows, 3);
+    loaded->values(x, loaded_y);
+    TEST_ASSERT((loaded_y - y).cwiseAbs().maxCoeff() == 0.0);
+
+    return EXIT_SUCCESS;
+}
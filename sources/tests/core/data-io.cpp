@@ -27,6 +27,7 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cstdint>
 
 // Get the 'unlink' declaration.
 #ifdef _WIN32
@@ -89,6 +90,14 @@ static void test_simple_load_from_text()
     TEST_ASSERT(view.col(1) == Eigen::Vector3d(1., 5., 9.));
     TEST_ASSERT(view.col(2) == Eigen::Vector3d(2., 6., 10.));
     TEST_ASSERT(view.col(3) == Eigen::Vector3d(3., 7., 11.));
+
+    // The column views agree with 'get'.
+    TEST_ASSERT(data->x_view().cols() == 1);
+    TEST_ASSERT(data->x_view().col(0) == Eigen::Vector3d(0., 4., 8.));
+    TEST_ASSERT(data->y_view().cols() == 3);
+    TEST_ASSERT(data->y_view().col(1) == Eigen::Vector3d(2., 6., 10.));
+    TEST_ASSERT(data->yl_view().row(1).transpose() == y_lower);
+    TEST_ASSERT(data->yu_view().row(1).transpose() == y_upper);
 }
 
 // Try loading a simple example from a text-format stream, with extra
@@ -265,9 +274,21 @@ int main(int argc, char** argv)
         temp3.open(temp_file3, std::ios::in | std::ios::binary);
         auto sample3 = plugins_manager::load_data("vertical_segment", temp3);
 
+        // Loading from the file name maps the binary file in memory.
+        auto sample4 = plugins_manager::load_data(temp_file3,
+                                                  "vertical_segment");
+
+        // Read it on demand, through a window smaller than the data.
+        arguments streaming_args = { { "data-window", "7" } };
+        auto sample5 = plugins_manager::load_data(temp_file3,
+                                                  "streaming_data",
+                                                  streaming_args);
+
         TEST_ASSERT(sample1->equals(*sample2));
         TEST_ASSERT(files_are_equal(temp_file1, temp_file2));
         TEST_ASSERT(sample2->equals(*sample3));
+        TEST_ASSERT(sample3->equals(*sample4));
+        TEST_ASSERT(sample3->equals(*sample5));
 
         TEST_ASSERT(sample1->min().size() == sample1->parametrization().dimX());
         TEST_ASSERT(sample1->max().size() == sample1->parametrization().dimX());
@@ -276,6 +297,17 @@ int main(int argc, char** argv)
         TEST_ASSERT(sample1->max() == sample2->max());
         TEST_ASSERT(sample1->min() == sample3->min());
         TEST_ASSERT(sample1->max() == sample3->max());
+        TEST_ASSERT(sample1->min() == sample5->min());
+        TEST_ASSERT(sample1->max() == sample5->max());
+
+        // Blocks straddle the window of SAMPLE5.
+        auto dimXY = sample1->parametrization().dimX()
+            + sample1->parametrization().dimY();
+        RowMatrixXd block1(10, dimXY), block5(10, dimXY);
+        sample1->get_block(3, block1);
+        sample5->get_block(3, block5);
+        TEST_ASSERT(block1 == block5);
+        TEST_ASSERT(block1.row(0) == sample1->get(3).transpose());
 
         // Make sure confidence interval data was preserved.
         auto vs_sample1 = dynamic_pointer_cast<vertical_segment>(sample1);
@@ -295,6 +327,14 @@ int main(int argc, char** argv)
         TEST_ASSERT(vs_sample1->matrix_view() == vs_sample2->matrix_view());
         TEST_ASSERT(vs_sample1->matrix_view() == vs_sample3->matrix_view());
 
+        auto vs_sample4 = dynamic_pointer_cast<vertical_segment>(sample4);
+        TEST_ASSERT(vs_sample4 != NULL);
+        TEST_ASSERT(vs_sample1->matrix_view() == vs_sample4->matrix_view());
+#ifndef _WIN32
+        // The sample stream of version 1 files is page-aligned.
+        TEST_ASSERT((uintptr_t) vs_sample4->matrix_view().data() % 4096 == 0);
+#endif
+
         auto dimX = sample1->parametrization().dimX();
         auto dimY = sample1->parametrization().dimY();
         for (auto i = 0; i < vs_sample1->size(); i++)
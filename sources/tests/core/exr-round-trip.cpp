@@ -0,0 +1,168 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the OpenEXR files written by the EXR plugins are read back
+ * with their values: through 'EXR_IO', from a stream and from a mapped file
+ * that starts past the beginning of the file, and through the BRDF slice
+ * plugin, in double and single precision.  */
+
+#include <core/common.h>
+#include <core/data.h>
+#include <core/plugins_manager.h>
+#include <plugins/data_io/EXR_IO.h>
+#include <tests.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace alta;
+
+// Return true if the value READ of the pixel component EXPECTED was read
+// back from a file in single precision, or in half precision if HALF.
+static bool same_value(double expected, double read, bool half)
+{
+    // Half floats have 11 significant bits, and subnormals down to 2^-24
+    const double tolerance = half
+        ? std::ldexp(std::abs(expected), -11) + std::ldexp(1.0, -25) : 0.0;
+    return std::abs(float(expected) - read) <= tolerance;
+}
+
+// Return true if the W x H interleaved RGB images EXPECTED and READ match.
+template<typename T>
+static bool same_image(const std::vector<double>& expected, const T* read,
+                       bool half)
+{
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (!same_value(expected[i], read[i], half))
+        {
+            std::cerr << "<<ERROR>> component " << i << ": read " << read[i]
+                      << " instead of " << expected[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Save PIX with 'EXR_IO' and read it back in the different ways.
+static bool check_exr_io(int W, int H, const std::vector<double>& pix, bool half)
+{
+    const std::string file = half ? "t-exr-round-trip-half.exr" : "t-exr-round-trip.exr";
+    TEST_ASSERT(t_EXR_IO<double>::SaveEXR(file.c_str(), W, H, pix.data(), 3, half));
+
+    int w = 0, h = 0;
+    float* read = NULL;
+    {
+        std::ifstream input(file.c_str(), std::ios::binary);
+        TEST_ASSERT(EXR_IO::LoadEXR(input, w, h, read));
+        TEST_ASSERT(w == W && h == H && same_image(pix, read, half));
+        delete[] read;
+    }
+    {
+        std::ifstream input(file.c_str(), std::ios::binary);
+        TEST_ASSERT(EXR_IO::LoadEXR(file, input, w, h, read));
+        TEST_ASSERT(w == W && h == H && same_image(pix, read, half));
+        delete[] read;
+    }
+
+    // The same file past a few bytes that are not part of it: the part of
+    // the file that is mapped does not start at a page boundary.
+    const std::string shifted = file + ".shifted";
+    {
+        std::ifstream in(file.c_str(), std::ios::binary);
+        std::ofstream out(shifted.c_str(), std::ios::binary);
+        out << "not an EXR file" << in.rdbuf();
+    }
+    {
+        std::ifstream input(shifted.c_str(), std::ios::binary);
+        input.seekg(std::strlen("not an EXR file"));
+        TEST_ASSERT(EXR_IO::LoadEXR(shifted, input, w, h, read));
+        TEST_ASSERT(w == W && h == H && same_image(pix, read, half));
+        delete[] read;
+    }
+
+    std::remove(shifted.c_str());
+    std::remove(file.c_str());
+    return true;
+}
+
+// Save a BRDF slice with the 'data_brdf_slice' plugin, with the precision
+// of ARGS, and load it back in double and single precision.
+static bool check_slice(const arguments& args, bool half)
+{
+    const parameters params(2, 3, params::STARK_2D, params::RGB_COLOR);
+    ptr<data> slice = plugins_manager::get_data("data_brdf_slice", 0, params, args);
+    TEST_ASSERT(slice != NULL);
+
+    std::vector<double> pix(3 * slice->size());
+    for (int i = 0; i < slice->size(); ++i)
+    {
+        vec x = slice->get(i);
+        for (int c = 0; c < 3; ++c)
+        {
+            pix[3 * i + c] = (c + 1) * x[0] * x[1] + 0.25 * c;
+            x[2 + c] = pix[3 * i + c];
+        }
+        slice->set(i, x);
+    }
+
+    const std::string file = "t-exr-round-trip-slice.exr";
+    slice->save(file);
+
+    for (bool single : { false, true })
+    {
+        arguments load_args;
+        if (single)
+            load_args.update("slice-float", "");
+        ptr<data> loaded = plugins_manager::load_data(file, "data_brdf_slice", load_args);
+        TEST_ASSERT(loaded != NULL && loaded->size() == slice->size());
+
+        std::vector<double> read(pix.size());
+        bool same_abscissae = true;
+        for (int i = 0; i < loaded->size(); ++i)
+        {
+            const vec x = loaded->get(i);
+            same_abscissae = same_abscissae && x.head(2) == slice->get(i).head(2);
+            for (int c = 0; c < 3; ++c)
+                read[3 * i + c] = x[2 + c];
+        }
+        TEST_ASSERT(same_abscissae);
+        TEST_ASSERT(same_image(pix, read.data(), half));
+    }
+
+    std::remove(file.c_str());
+    return true;
+}
+
+int main()
+{
+    const int W = 37, H = 11;
+    std::vector<double> pix(3 * W * H);
+    for (size_t i = 0; i < pix.size(); ++i)
+        pix[i] = (i % 3 == 0 ? 1.0 : -1.0) * (0.37 * i + 1e-6 * i * i);
+
+    TEST_ASSERT(check_exr_io(W, H, pix, false));
+    TEST_ASSERT(check_exr_io(W, H, pix, true));
+
+    arguments args;
+    TEST_ASSERT(check_slice(args, false));
+    args.update("slice-float", "");
+    TEST_ASSERT(check_slice(args, false));
+    args.update("exr-half", "");
+    TEST_ASSERT(check_slice(args, true));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check the layout of the OpenEXR files written by the EXR plugins: the
+ * header attributes, the offset table and the bytes of each scanline, in
+ * single and half precision.  */
+
+#include <core/common.h>
+#include <plugins/data_io/EXR_writer.h>
+#include <tests.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Reader of the little endian values of a file.
+struct reader
+{
+    std::vector<unsigned char> bytes;
+    size_t pos;
+
+    uint32_t u32()
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= uint32_t(bytes.at(pos++)) << (8 * i);
+        return v;
+    }
+
+    uint64_t u64()
+    {
+        const uint64_t low = u32();
+        return low | (uint64_t(u32()) << 32);
+    }
+
+    uint16_t u16()
+    {
+        const uint16_t v = bytes.at(pos) | (bytes.at(pos + 1) << 8);
+        pos += 2;
+        return v;
+    }
+
+    float f32()
+    {
+        const uint32_t v = u32();
+        float f;
+        std::memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+
+    std::string name()
+    {
+        std::string s;
+        while (bytes.at(pos) != 0)
+            s += char(bytes.at(pos++));
+        ++pos;
+        return s;
+    }
+};
+
+static reader read_file(const std::string& file)
+{
+    std::ifstream in(file.c_str(), std::ios::binary);
+    reader r;
+    r.bytes.assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+    r.pos = 0;
+    return r;
+}
+
+// Check the attribute at the position of R: NAME, TYPE and SIZE bytes of
+// value, which are skipped.
+static bool check_attribute(reader& r, const std::string& name,
+                            const std::string& type, uint32_t size)
+{
+    if (r.name() != name || r.name() != type || r.u32() != size)
+    {
+        std::cerr << "<<ERROR>> unexpected attribute '" << name << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write the W x H interleaved RGB image PIX in FILE and check its layout.
+static bool check_file(const std::string& file, int W, int H,
+                       const std::vector<double>& pix, bool half)
+{
+    EXR_writer writer(file.c_str(), W, H, half);
+    for (int y = 0; y < H; ++y)
+    {
+        const double* line = pix.data() + 3 * W * y;
+        writer.write_line(line, line + 1, line + 2, 3);
+    }
+    if (!writer.close())
+        return false;
+
+    reader r = read_file(file);
+    ::unlink(file.c_str());
+
+    // Magic number and version, single part with scanlines
+    TEST_ASSERT(r.u32() == 20000630);
+    TEST_ASSERT(r.u32() == 2);
+
+    // Channels, sorted by name
+    TEST_ASSERT(check_attribute(r, "channels", "chlist", 3 * 18 + 1));
+    for (const char* channel : { "B", "G", "R" })
+    {
+        TEST_ASSERT(r.name() == channel);
+        TEST_ASSERT(r.u32() == (half ? 1u : 2u));
+        TEST_ASSERT(r.u32() == 0);    // pLinear, reserved
+        TEST_ASSERT(r.u32() == 1);    // xSampling
+        TEST_ASSERT(r.u32() == 1);    // ySampling
+    }
+    TEST_ASSERT(r.bytes.at(r.pos++) == 0);
+
+    TEST_ASSERT(check_attribute(r, "compression", "compression", 1));
+    TEST_ASSERT(r.bytes.at(r.pos++) == 0);
+    for (const char* window : { "dataWindow", "displayWindow" })
+    {
+        TEST_ASSERT(check_attribute(r, window, "box2i", 16));
+        TEST_ASSERT(r.u32() == 0 && r.u32() == 0);
+        TEST_ASSERT(r.u32() == uint32_t(W - 1) && r.u32() == uint32_t(H - 1));
+    }
+    TEST_ASSERT(check_attribute(r, "lineOrder", "lineOrder", 1));
+    TEST_ASSERT(r.bytes.at(r.pos++) == 0);
+    TEST_ASSERT(check_attribute(r, "pixelAspectRatio", "float", 4));
+    TEST_ASSERT(r.f32() == 1.0f);
+    TEST_ASSERT(check_attribute(r, "screenWindowCenter", "v2f", 8));
+    TEST_ASSERT(r.f32() == 0.0f && r.f32() == 0.0f);
+    TEST_ASSERT(check_attribute(r, "screenWindowWidth", "float", 4));
+    TEST_ASSERT(r.f32() == 1.0f);
+    TEST_ASSERT(r.bytes.at(r.pos++) == 0);
+
+    // Offset table, then the scanlines in order: each has its index, its
+    // size, and the B, G and R values of its pixels.
+    const size_t line_size = 8 + size_t(W) * 3 * (half ? 2 : 4);
+    std::vector<uint64_t> offsets(H);
+    for (int y = 0; y < H; ++y)
+        offsets[y] = r.u64();
+
+    for (int y = 0; y < H; ++y)
+    {
+        TEST_ASSERT(offsets[y] == r.pos);
+        TEST_ASSERT(r.u32() == uint32_t(y));
+        TEST_ASSERT(r.u32() == line_size - 8);
+        for (int c = 2; c >= 0; --c)
+            for (int x = 0; x < W; ++x)
+            {
+                const double value = pix[3 * (W * y + x) + c];
+                if (half)
+                    TEST_ASSERT(r.u16() == float_to_half(float(value)));
+                else
+                    TEST_ASSERT(r.f32() == float(value));
+            }
+    }
+    TEST_ASSERT(r.pos == r.bytes.size());
+
+    std::cout << "<<INFO>> " << (half ? "half" : "float") << " file of "
+              << r.bytes.size() << " bytes checked" << std::endl;
+    return true;
+}
+
+int main()
+{
+    // Half encodings of a few values
+    TEST_ASSERT(float_to_half(1.0f) == 0x3c00);
+    TEST_ASSERT(float_to_half(-2.0f) == 0xc000);
+    TEST_ASSERT(float_to_half(0.5f) == 0x3800);
+    TEST_ASSERT(float_to_half(65504.0f) == 0x7bff);
+    TEST_ASSERT(float_to_half(1e6f) == 0x7c00);
+    TEST_ASSERT(float_to_half(1.0f + 1.0f / 2048.0f) == 0x3c00);   // tie to even
+    TEST_ASSERT(float_to_half(1.0f + 3.0f / 2048.0f) == 0x3c02);
+    TEST_ASSERT(float_to_half(std::ldexp(1.0f, -24)) == 0x0001);  // subnormal
+
+    const int W = 5, H = 3;
+    std::vector<double> pix(3 * W * H);
+    for (size_t i = 0; i < pix.size(); ++i)
+        pix[i] = (i % 3 == 0 ? 1.0 : -1.0) * (0.37 * i + 1e-6 * i * i);
+
+    TEST_ASSERT(check_file("t-exr-writer-float.exr", W, H, pix, false));
+    TEST_ASSERT(check_file("t-exr-writer-half.exr", W, H, pix, true));
+
+    return EXIT_SUCCESS;
+}
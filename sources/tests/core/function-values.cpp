@@ -0,0 +1,252 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that evaluating functions and their Jacobians on blocks of points
+ * with 'function::values' and 'nonlinear_function::parametersJacobians'
+ * matches their point-wise evaluation, that the values match the formulas
+ * of the BRDF models, and that the Jacobians match finite differences of
+ * the values.  */
+
+#include <core/function.h>
+#include <core/params.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace alta;
+
+static const int dimY = 3;
+
+// Return ROWS random pairs of directions in the upper hemisphere, in
+// CARTESIAN coordinates.
+static RowMatrixXd random_directions(int rows)
+{
+    RowMatrixXd x(rows, 6);
+    for(int n = 0; n < rows; ++n)
+    {
+        double angles[4];
+        angles[0] = 0.5 * M_PI * double(std::rand()) / RAND_MAX;
+        angles[1] = 2.0 * M_PI * double(std::rand()) / RAND_MAX;
+        angles[2] = 0.5 * M_PI * double(std::rand()) / RAND_MAX;
+        angles[3] = 2.0 * M_PI * double(std::rand()) / RAND_MAX;
+        params::convert(angles, params::SPHERICAL_TL_PL_TV_PV,
+                        params::CARTESIAN, &x(n, 0));
+    }
+    return x;
+}
+
+// Return ROWS random points in the input space of F.
+static RowMatrixXd input_points(const function& f, int rows)
+{
+    RowMatrixXd x(rows, f.parametrization().dimX());
+    RowMatrixXd directions = random_directions(rows);
+    for(int n = 0; n < rows; ++n)
+        params::convert(&directions(n, 0), params::CARTESIAN,
+                        f.parametrization().input_parametrization(),
+                        &x(n, 0));
+    return x;
+}
+
+// Return true if the rows of BLOCK match the EXPECTED row vectors, up to
+// the relative TOLERANCE.
+template<typename Function>
+static bool rows_match(const RowMatrixXd& block, Function expected,
+                       double tolerance = 1e-12)
+{
+    for(int n = 0; n < block.rows(); ++n)
+    {
+        const vec e = expected(n);
+        if((block.row(n).transpose() - e).norm() > tolerance * (1.0 + e.norm()))
+        {
+            std::cerr << "mismatch at row " << n << ": "
+                      << block.row(n) << " vs. " << e.transpose()
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Return true if the block evaluation of F and of its Jacobian on X match
+// their point-wise evaluation.
+static bool block_matches_pointwise(const nonlinear_function& f,
+                                    const RowMatrixXd& x)
+{
+    RowMatrixXd y(x.rows(), f.parametrization().dimY());
+    f.values(x, y);
+
+    RowMatrixXd jac(x.rows(), f.parametrization().dimY() * f.nbParameters());
+    f.parametersJacobians(x, jac);
+
+    return rows_match(y, [&](int n) {
+            return f.value(x.row(n).transpose());
+        })
+        // Without parameters, 'parametersJacobian' may return a dummy
+        // vector.
+        && (f.nbParameters() == 0 || rows_match(jac, [&](int n) {
+            return f.parametersJacobian(x.row(n).transpose());
+        }));
+}
+
+// Return the value at X, in the input space of the function, of the BRDF
+// model NAME with parameters P and DIMY channels, as given by its formula.
+static vec model_value(const std::string& name, const vec& p, const vec& x)
+{
+    vec res = vec::Zero(dimY);
+    if(name == "nonlinear_function_blinn")
+    {
+        // ks cos(theta_h)^N, with the parameters (ks, N) of each channel
+        for(int i = 0; i < dimY; ++i)
+            if(x[0] > 0.0)
+                res[i] = p[2*i] * std::pow(x[0], p[2*i + 1]);
+        return res;
+    }
+
+    // Directions L and V, and the half vector H
+    const Eigen::Vector3d l = x.segment(0, 3), v = x.segment(3, 3);
+    const Eigen::Vector3d h = (l + v).normalized();
+    const bool above = l[2] * v[2] > 0.0;
+
+    for(int i = 0; i < dimY; ++i)
+    {
+        if(name == "nonlinear_function_beckmann" && above && h[2] > 0.0)
+        {
+            // (ks, alpha)
+            const double ks = p[2*i], a2 = p[2*i + 1] * p[2*i + 1];
+            const double c2 = h[2] * h[2];
+            res[i] = ks / (4.0 * M_PI * a2 * c2 * c2)
+                   * std::exp((c2 - 1.0) / (a2 * c2));
+        }
+        else if(name == "nonlinear_function_ward" && above)
+        {
+            // (ks, alpha_x, alpha_y)
+            const double ks = p[3*i], ax = p[3*i + 1], ay = p[3*i + 2];
+            const double e = (std::pow(h[0] / ax, 2) + std::pow(h[1] / ay, 2))
+                           / (h[2] * h[2]);
+            res[i] = ks / (4.0 * M_PI * ax * ay * std::sqrt(l[2] * v[2]))
+                   * std::exp(-e);
+        }
+        else if(name == "nonlinear_function_lafortune")
+        {
+            // A single anisotropic lobe (Cx, Cy, Cz, N), and no diffuse term
+            const double d = p[4*i] * l[0] * v[0] + p[4*i + 1] * l[1] * v[1]
+                           + p[4*i + 2] * l[2] * v[2];
+            if(d > 0.0)
+                res[i] = std::pow(d, p[4*i + 3]);
+        }
+    }
+
+    // The diffuse function has no parameters, and a zero albedo.
+    return res;
+}
+
+// Return true if the values of F, the model NAME, on X match its formula.
+static bool values_match_model(const nonlinear_function& f,
+                               const std::string& name, const RowMatrixXd& x)
+{
+    RowMatrixXd y(x.rows(), f.parametrization().dimY());
+    f.values(x, y);
+
+    const vec p = f.parameters();
+    return rows_match(y, [&](int n) {
+            return model_value(name, p, x.row(n).transpose());
+        }, 1e-10);
+}
+
+// Return true if the Jacobian of F on X matches the central differences of
+// its values.
+static bool jacobian_matches_differences(nonlinear_function& f,
+                                         const RowMatrixXd& x)
+{
+    const int nY = f.parametrization().dimY();
+    const int nbParams = f.nbParameters();
+    const vec p = f.parameters();
+
+    RowMatrixXd jac(x.rows(), nY * nbParams);
+    f.parametersJacobians(x, jac);
+
+    RowMatrixXd differences(x.rows(), nY * nbParams);
+    RowMatrixXd above(x.rows(), nY), below(x.rows(), nY);
+    for(int k = 0; k < nbParams; ++k)
+    {
+        const double step = 1e-6 * std::abs(p[k]);
+        vec q = p;
+        q[k] = p[k] + step;
+        f.setParameters(q);
+        f.values(x, above);
+        q[k] = p[k] - step;
+        f.setParameters(q);
+        f.values(x, below);
+
+        for(int i = 0; i < nY; ++i)
+            differences.col(i*nbParams + k) =
+                (above.col(i) - below.col(i)) / (2.0 * step);
+    }
+    f.setParameters(p);
+
+    return rows_match(jac, [&](int n) -> vec {
+            return differences.row(n).transpose();
+        }, 1e-5);
+}
+
+int main()
+{
+    static const std::vector<std::string> names
+        { "nonlinear_function_beckmann",
+          "nonlinear_function_blinn",
+          "nonlinear_function_ward",
+          "nonlinear_function_lafortune",
+          "nonlinear_function_diffuse" };
+
+    const parameters params(6, dimY, params::CARTESIAN, params::RGB_COLOR);
+
+    std::vector<ptr<nonlinear_function> > functions;
+    for(auto&& name: names)
+    {
+        auto f = dynamic_pointer_cast<nonlinear_function>(
+            plugins_manager::get_function(name, params));
+        TEST_ASSERT(f != NULL);
+
+        vec p(f->nbParameters());
+        for(int i = 0; i < p.size(); ++i)
+            p[i] = 0.1 + double(std::rand()) / RAND_MAX;
+        f->setParameters(p);
+
+        functions.push_back(f);
+    }
+
+    for(unsigned int i = 0; i < functions.size(); ++i)
+    {
+        std::cerr << "testing '" << names[i] << "'...\n";
+        const RowMatrixXd x = input_points(*functions[i], 100);
+        TEST_ASSERT(block_matches_pointwise(*functions[i], x));
+        TEST_ASSERT(values_match_model(*functions[i], names[i], x));
+        TEST_ASSERT(jacobian_matches_differences(*functions[i], x));
+    }
+
+    // The compound of all the functions.
+    compound_function compound(functions,
+                               std::vector<arguments>(functions.size()));
+    TEST_ASSERT(block_matches_pointwise(compound,
+                                        input_points(compound, 100)));
+
+    // The product of two functions with different input spaces.
+    product_function product(functions[0], functions[1]);
+    TEST_ASSERT(block_matches_pointwise(product,
+                                        input_points(product, 100)));
+
+    return EXIT_SUCCESS;
+}
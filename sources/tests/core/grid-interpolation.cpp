@@ -0,0 +1,125 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the grid interpolant reproduces multilinear functions, that
+ * its batch and point-wise queries agree, and that grids saved in text and
+ * binary form load back identically.  */
+
+#include <core/data.h>
+#include <core/params.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#include <unistd.h>
+
+using namespace alta;
+
+// A multilinear function of the abscissae, with three channels.
+static vec f(const vec& x)
+{
+    vec y(3);
+    y[0] = 1.0 + 2.0 * x[0] - 0.5 * x[1];
+    y[1] = x[0] * x[1];
+    y[2] = 0.25 + x[1] * (1.0 - x[0]);
+    return y;
+}
+
+// Return the largest difference between the values of A and B at the rows
+// of X.
+static double max_difference(const data& a, const data& b, const RowMatrixXd& x)
+{
+    RowMatrixXd ya(x.rows(), 3), yb(x.rows(), 3);
+    a.values(x, ya);
+    b.values(x, yb);
+    return (ya - yb).cwiseAbs().maxCoeff();
+}
+
+// Save GRID to FILE with ARGS and check that it loads back identically.
+static bool check_round_trip(const ptr<data>& grid, const RowMatrixXd& x,
+                             bool binary)
+{
+    const parameters params(2, 3, params::RUSIN_TH_TD, params::RGB_COLOR);
+    arguments args;
+    args.update("grid-size", "[5, 7]");
+    if (binary)
+        args.update("grid-binary", "");
+
+    ptr<data> copy = plugins_manager::get_data("data_grid", 0, params, args);
+    for (int i = 0; i < grid->size(); ++i)
+        copy->set(i, grid->get(i));
+
+    const std::string file = binary ? "t-grid.binary" : "t-grid.txt";
+    copy->save(file);
+    ptr<data> loaded = plugins_manager::load_data(file, "data_grid");
+    ::unlink(file.c_str());
+
+    if (!loaded || loaded->size() != grid->size())
+        return false;
+
+    double error = 0.0;
+    for (int i = 0; i < grid->size(); ++i)
+        error = std::max(error, (loaded->get(i) - grid->get(i)).cwiseAbs().maxCoeff());
+    error = std::max(error, max_difference(*loaded, *grid, x));
+
+    std::cout << "<<INFO>> " << (binary ? "binary" : "text")
+              << " round trip: max error " << error << std::endl;
+
+    // The text format is printed with digits10 digits.
+    return error <= (binary ? 0.0 : 1e-12);
+}
+
+int main()
+{
+    const parameters params(2, 3, params::RUSIN_TH_TD, params::RGB_COLOR);
+    arguments args;
+    args.update("grid-size", "[5, 7]");
+
+    ptr<data> grid = plugins_manager::get_data("data_grid", 0, params, args);
+    TEST_ASSERT(grid && grid->size() == 5 * 7);
+
+    for (int i = 0; i < grid->size(); ++i)
+    {
+        vec x = grid->get(i);
+        x.tail(3) = f(x.head(2));
+        grid->set(i, x);
+    }
+
+    // Queries inside and outside of the domain [0, pi/2]^2
+    const int rows = 1000;
+    RowMatrixXd x = (RowMatrixXd::Random(rows, 2).array() + 1.0) * 0.275 * M_PI;
+
+    RowMatrixXd y(rows, 3);
+    grid->values(x, y);
+
+    double error = 0.0, batch_error = 0.0;
+    for (int i = 0; i < rows; ++i)
+    {
+        vec xi = x.row(i).transpose();
+        const vec yi = grid->value(xi);
+        batch_error = std::max(batch_error, (yi - y.row(i).transpose()).cwiseAbs().maxCoeff());
+
+        // The grid is extended by its boundary values
+        xi = xi.cwiseMax(0.0).cwiseMin(0.5 * M_PI);
+        error = std::max(error, (yi - f(xi)).cwiseAbs().maxCoeff());
+    }
+    std::cout << "<<INFO>> max interpolation error " << error
+              << ", max batch error " << batch_error << std::endl;
+
+    TEST_ASSERT(error < 1e-12);
+    TEST_ASSERT(batch_error == 0.0);
+    TEST_ASSERT(check_round_trip(grid, x, false));
+    TEST_ASSERT(check_round_trip(grid, x, true));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the batch lookup of the MERL plugin gives the same results as
+ * its point-wise lookup, in double and single precision and when the table
+ * is mapped from a file, and compare their throughput.  */
+
+#include <core/data.h>
+#include <core/params.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+
+#include <unistd.h>
+
+using namespace alta;
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start).count();
+}
+
+// Return a MERL table filled with a smooth function of its abscissae,
+// stored in single precision when SINGLE is true.
+static ptr<data> make_merl(bool single)
+{
+    const parameters params(3, 3, params::RUSIN_TH_TD_PD, params::RGB_COLOR);
+    arguments args;
+    if (single)
+        args.update("merl-float", "");
+
+    ptr<data> merl = plugins_manager::get_data("data_merl", 0, params, args);
+    if (!merl)
+        return merl;
+
+    for (int i = 0; i < merl->size(); ++i)
+    {
+        vec x = merl->get(i);
+        x[3] = 1.0 + std::cos(x[0]);
+        x[4] = 1.0 + std::sin(x[1]) * std::cos(x[2]);
+        x[5] = 0.1 + x[0] * x[1];
+        merl->set(i, x);
+    }
+
+    return merl;
+}
+
+// Look up X in MERL point-wise and in batch, check that both agree with
+// EXPECTED, and report their timings.
+static bool check_lookup(const data& merl, const RowMatrixXd& x,
+                         RowMatrixXd& expected, double tolerance,
+                         const std::string& name)
+{
+    const int rows = x.rows();
+    RowMatrixXd pointwise(rows, 3), batch(rows, 3);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rows; ++i)
+        pointwise.row(i) = merl.value(x.row(i).transpose()).transpose();
+    const double pointwise_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    merl.values(x, batch);
+    const double batch_time = seconds_since(start);
+
+    if (expected.rows() == 0)
+        expected = pointwise;
+
+    const double error = std::max((pointwise - batch).cwiseAbs().maxCoeff(),
+                                  (expected - batch).cwiseAbs().maxCoeff());
+    std::cout << "<<INFO>> " << name << ": point-wise " << pointwise_time
+              << " s, batch " << batch_time << " s, max error " << error
+              << std::endl;
+
+    return error <= tolerance * expected.cwiseAbs().maxCoeff();
+}
+
+int main(int argc, char** argv)
+{
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    ptr<data> merl = make_merl(false), merl_float = make_merl(true);
+    TEST_ASSERT(merl && merl_float);
+
+    // Random directions, in the parametrization of the table, including
+    // configurations outside of its domain.
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> theta(-0.1, 0.55 * M_PI);
+    std::uniform_real_distribution<double> phi(-2.0 * M_PI, 2.0 * M_PI);
+    RowMatrixXd x(rows, 3);
+    for (int i = 0; i < rows; ++i)
+    {
+        x(i, 0) = theta(gen);
+        x(i, 1) = theta(gen);
+        x(i, 2) = phi(gen);
+    }
+
+    RowMatrixXd expected;
+    TEST_ASSERT(check_lookup(*merl, x, expected, 0.0, "double"));
+    TEST_ASSERT(check_lookup(*merl_float, x, expected, 1e-6, "float"));
+
+    // Save the table and map it back.
+    const std::string file = "t-merl-lookup.binary";
+    merl->save(file);
+    ptr<data> merl_mapped = plugins_manager::load_data(file, "data_merl");
+    ::unlink(file.c_str());
+    TEST_ASSERT(merl_mapped && merl_mapped->size() == merl->size());
+    TEST_ASSERT(check_lookup(*merl_mapped, x, expected, 0.0, "mapped"));
+
+    // Writing to the mapped table must not change the file nor the samples
+    // that are not written to.
+    vec sample = merl_mapped->get(0);
+    sample.tail(3) *= 2.0;
+    merl_mapped->set(0, sample);
+    TEST_ASSERT((merl_mapped->get(0) - sample).norm() < 1e-12);
+    TEST_ASSERT(merl_mapped->get(1) == merl->get(1));
+
+    return EXIT_SUCCESS;
+}
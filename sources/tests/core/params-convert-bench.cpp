@@ -0,0 +1,125 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that the batch 'params::convert' gives the same results as the
+ * point-wise one for the parametrizations used by the fitting and
+ * conversion pipelines, and compare their throughput.  */
+
+#include <core/common.h>
+#include <core/params.h>
+#include <tests.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+
+using namespace alta;
+
+// Return ROWS random pairs of directions on the upper hemisphere, in the
+// CARTESIAN parametrization.
+static RowMatrixXd make_cartesian_data(int rows)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> theta(0., 0.49 * M_PI);
+    std::uniform_real_distribution<double> phi(-M_PI, M_PI);
+
+    RowMatrixXd x(rows, 6);
+    for (int i = 0; i < rows; ++i)
+    {
+        const double spherical[] = {
+            theta(gen), phi(gen), theta(gen), phi(gen)
+        };
+        params::convert(spherical, params::SPHERICAL_TL_PL_TV_PV,
+                        params::CARTESIAN, x.row(i).data());
+    }
+
+    return x;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start).count();
+}
+
+// Convert X from IN to OUT point-wise and in batch, check that both agree,
+// and report their timings.
+static bool check_conversion(const RowMatrixXd& x,
+                             params::input in, params::input out)
+{
+    const int rows = x.rows(), dimX = params::dimension(out);
+    RowMatrixXd expected(rows, dimX), actual(rows, dimX);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rows; ++i)
+        params::convert(x.row(i).data(), in, out, expected.row(i).data());
+    const double pointwise_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    params::convert(x.data(), in, out, actual.data(), rows, x.cols(), dimX);
+    const double batch_time = seconds_since(start);
+
+    const double error = (expected - actual).cwiseAbs().maxCoeff();
+    std::cout << "<<INFO>> " << params::get_name(in) << " -> "
+              << params::get_name(out) << ": point-wise "
+              << pointwise_time << " s, batch " << batch_time
+              << " s, max error " << error << std::endl;
+
+    return error < 1e-10;
+}
+
+int main(int argc, char** argv)
+{
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const RowMatrixXd cartesian = make_cartesian_data(rows);
+
+    static const params::input inputs[] =
+    {
+        params::CARTESIAN,
+        params::RUSIN_TH_TD_PD,
+        params::RUSIN_TH_PH_TD_PD,
+        params::ISOTROPIC_TV_TL_DPHI,
+        params::SPHERICAL_TL_PL_TV_PV
+    };
+
+    static const params::input outputs[] =
+    {
+        params::CARTESIAN,
+        params::COS_TH,
+        params::COS_TLV,
+        params::RUSIN_VH,
+        params::RUSIN_TH_TD,
+        params::RUSIN_TH_TD_PD,
+        params::RUSIN_TH_PH_TD_PD,
+        params::ISOTROPIC_TV_TL_DPHI,
+        params::SPHERICAL_TL_PL_TV_PV
+    };
+
+    int failures = 0;
+    for (auto in : inputs)
+    {
+        // Express the samples in the IN parametrization first.
+        RowMatrixXd x(rows, params::dimension(in));
+        params::convert(cartesian.data(), params::CARTESIAN, in, x.data(),
+                        rows, 6, x.cols());
+
+        for (auto out : outputs)
+        {
+            if (!check_conversion(x, in, out))
+                failures++;
+        }
+    }
+
+    TEST_ASSERT(failures == 0);
+
+    return EXIT_SUCCESS;
+}
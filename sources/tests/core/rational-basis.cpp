@@ -0,0 +1,156 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check the degree table of 'rational_function_1d' and that evaluating all
+ * its basis functions at once with 'basis' matches their point-wise
+ * evaluation.  Also check the channel loop of 'fit_channels'.  */
+
+#include <core/rational_function.h>
+#include <core/params.h>
+#include <tests.h>
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <set>
+#include <vector>
+
+using namespace alta;
+
+static const int np = 40, nq = 25;
+
+// Return the sum of the elements of DEG.
+static int total_degree(const std::vector<int>& deg)
+{
+    return std::accumulate(deg.begin(), deg.end(), 0);
+}
+
+// Check that the degree vectors of R are distinct and sorted by total
+// degree.
+static bool check_degrees(const rational_function_1d& r, int count)
+{
+    std::set<std::vector<int> > seen;
+    int previous = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        const std::vector<int> deg = r.index2degree(i);
+        if(int(deg.size()) != r.parametrization().dimX()
+           || total_degree(deg) < previous
+           || !seen.insert(deg).second)
+            return false;
+
+        previous = total_degree(deg);
+    }
+    return true;
+}
+
+// Check that the basis of R evaluated at once matches its point-wise
+// evaluation on random points.
+static bool check_basis(const rational_function_1d& r)
+{
+    const int dimX = r.parametrization().dimX();
+    vec p(np), q(nq);
+    double error = 0.;
+
+    for(int n = 0; n < 100; ++n)
+    {
+        vec x(dimX);
+        for(int k = 0; k < dimX; ++k)
+            x[k] = double(std::rand()) / RAND_MAX;
+
+        r.basis(x, p, q);
+        for(int i = 0; i < np; ++i)
+            error = std::max(error, std::abs(p[i] - r.p(x, i)));
+        for(int i = 0; i < nq; ++i)
+            error = std::max(error, std::abs(q[i] - r.q(x, i)));
+    }
+
+    std::cout << "<<INFO>> dimX = " << dimX << ", max basis error "
+              << error << std::endl;
+    return error < 1e-12;
+}
+
+// Check that the basis of R evaluated on the rows of a matrix matches its
+// evaluation on each row.
+static bool check_bases(const rational_function_1d& r)
+{
+    const int dimX = r.parametrization().dimX();
+    const RowMatrixXd x = (RowMatrixXd::Random(50, dimX).array() + 1.0) / 2.0;
+    RowMatrixXd p(x.rows(), np), q(x.rows(), nq);
+    r.bases(x, p, q);
+
+    double error = 0.;
+    vec pi(np), qi(nq);
+    for(int i = 0; i < x.rows(); ++i)
+    {
+        r.basis(x.row(i).transpose(), pi, qi);
+        error = std::max(error, (p.row(i).transpose() - pi).lpNorm<Eigen::Infinity>());
+        error = std::max(error, (q.row(i).transpose() - qi).lpNorm<Eigen::Infinity>());
+    }
+
+    return error == 0.;
+}
+
+int main()
+{
+    // The first degrees in two dimensions.
+    {
+        rational_function_1d r(parameters(2, 1, params::UNKNOWN_INPUT,
+                                          params::UNKNOWN_OUTPUT), 6, 6);
+        const int expected[6][2] =
+            { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 2, 0 }, { 1, 1 }, { 0, 2 } };
+        for(int i = 0; i < 6; ++i)
+        {
+            TEST_ASSERT(r.index2degree(i)[0] == expected[i][0]);
+            TEST_ASSERT(r.index2degree(i)[1] == expected[i][1]);
+        }
+    }
+
+    for(int dimX = 1; dimX <= 4; ++dimX)
+    {
+        rational_function_1d r(parameters(dimX, 1, params::UNKNOWN_INPUT,
+                                          params::UNKNOWN_OUTPUT), np, nq);
+        r.setMin(vec::Zero(dimX));
+        r.setMax(vec::Ones(dimX));
+
+        vec a = vec::Random(np), b = vec::Random(nq);
+        b[0] = 1.0;
+        r.update(a, b);
+
+        // Indices beyond the size of the function are still valid.
+        TEST_ASSERT(check_degrees(r, 2 * np));
+        TEST_ASSERT(check_basis(r));
+        TEST_ASSERT(check_bases(r));
+    }
+
+    // 'fit_channels' fits each channel once, with its own 1D function.
+    {
+        rational_function r(parameters(1, 5, params::UNKNOWN_INPUT,
+                                       params::UNKNOWN_OUTPUT), 2, 2);
+        r.setMin(vec::Zero(1));
+        r.setMax(vec::Ones(1));
+
+        std::vector<int> calls(5, 0);
+        TEST_ASSERT(fit_channels(r, [&](int j, rational_function_1d* rj)
+        {
+            ++calls[j];
+            return rj == r.get(j);
+        }, 2));
+        TEST_ASSERT(calls == std::vector<int>(5, 1));
+
+        TEST_ASSERT(!fit_channels(r, [](int j, rational_function_1d*)
+        {
+            return j != 3;
+        }));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check that 'rational_function_1d::value' gives the same results as the
+ * evaluation of its basis functions and as the original implementation,
+ * which called 'pow' for each coordinate of each basis function, and
+ * compare their throughput.  */
+
+#include <core/common.h>
+#include <core/rational_function.h>
+#include <tests.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+using namespace alta;
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start).count();
+}
+
+// Evaluate R at X as the original implementation of 'value' did, with the
+// vectors of degree DEGREES of the basis functions.
+static double pow_value(const rational_function_1d& r,
+                        const std::vector<std::vector<int> >& degrees,
+                        const vec& x)
+{
+    const vec min = r.min(), max = r.max();
+    const int np = r.getP().size(), nq = r.getQ().size();
+
+    double p = 0.0, q = 0.0;
+    for (int i = 0; i < std::max(np, nq); ++i)
+    {
+        double basis = 1.0;
+        for (int k = 0; k < x.size(); ++k)
+        {
+            const double xp = 2.0 * ((x[k] - min[k]) / (max[k] - min[k]) - 0.5);
+            basis *= std::pow(xp, degrees[i][k]);
+        }
+        if (i < np)
+            p += r.getP(i) * basis;
+        if (i < nq)
+            q += r.getQ(i) * basis;
+    }
+
+    return p / q;
+}
+
+// Evaluate R on ROWS random points with 'value', with the basis functions
+// and as the original implementation did, check that they agree, and
+// report their timings.
+static bool check_evaluation(int dimX, int np, int nq, int rows)
+{
+    rational_function_1d r(parameters(dimX, 1, params::UNKNOWN_INPUT,
+                                      params::UNKNOWN_OUTPUT), np, nq);
+    r.setMin(vec::Zero(dimX));
+    r.setMax(vec::Ones(dimX));
+
+    // Keep the denominator away from zero.
+    vec a = vec::Random(np), b = 0.1 * vec::Random(nq);
+    b[0] = 1.0;
+    r.update(a, b);
+
+    const RowMatrixXd x = (RowMatrixXd::Random(rows, dimX).array() + 1.0) / 2.0;
+    vec original(rows), expected(rows), actual(rows);
+
+    std::vector<std::vector<int> > degrees;
+    for (int i = 0; i < std::max(np, nq); ++i)
+        degrees.push_back(r.index2degree(i));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rows; ++i)
+        original[i] = pow_value(r, degrees, x.row(i).transpose());
+    const double pow_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    const vec p = r.getP(), q = r.getQ();
+    vec pi(np), qi(nq);
+    for (int i = 0; i < rows; ++i)
+    {
+        r.basis(x.row(i).transpose(), pi, qi);
+        expected[i] = p.dot(pi) / q.dot(qi);
+    }
+    const double generic_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rows; ++i)
+        actual[i] = r.value(x.row(i).transpose())[0];
+    const double value_time = seconds_since(start);
+
+    const double scale = original.cwiseAbs().maxCoeff();
+    const double error = std::max((expected - actual).cwiseAbs().maxCoeff(),
+                                  (original - actual).cwiseAbs().maxCoeff())
+        / scale;
+    std::cout << "<<INFO>> dimX = " << dimX << ", np = " << np
+              << ", nq = " << nq << ": pow " << pow_time
+              << " s, basis " << generic_time
+              << " s, value " << value_time << " s ("
+              << pow_time / value_time << "x), max relative error "
+              << error << std::endl;
+
+    return error < 1e-10;
+}
+
+int main(int argc, char** argv)
+{
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    int failures = 0;
+    for (int dimX = 1; dimX <= 4; ++dimX)
+    {
+        static const int sizes[][2] = { { 1, 1 }, { 10, 8 }, { 35, 20 } };
+        for (auto size : sizes)
+        {
+            if (!check_evaluation(dimX, size[0], size[1], rows))
+                failures++;
+        }
+    }
+
+    TEST_ASSERT(failures == 0);
+
+    return EXIT_SUCCESS;
+}
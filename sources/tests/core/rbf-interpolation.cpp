@@ -0,0 +1,132 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Check the block queries of the RBF interpolant: that it reproduces the
+ * data at their abscissae, that blocks evaluated from a parallel region
+ * match a single block, and that the k-d tree saved by a first run is
+ * loaded back by the next one.  */
+
+#include <core/common.h>
+#include <core/data.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <dirent.h>
+
+using namespace alta;
+
+static const char data_file[] = "t-rbf-interpolation.txt";
+
+// Remove the k-d trees saved next to the data file.
+static int remove_indices()
+{
+    const std::string prefix = std::string(data_file) + ".";
+    const std::string suffix = ".flann";
+
+    int removed = 0;
+    DIR* dir = opendir(".");
+    if (dir == NULL)
+        return 0;
+    while (struct dirent* entry = readdir(dir))
+    {
+        const std::string name = entry->d_name;
+        if (name.size() > prefix.size() + suffix.size()
+            && name.compare(0, prefix.size(), prefix) == 0
+            && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            removed += std::remove(name.c_str()) == 0;
+        }
+    }
+    closedir(dir);
+    return removed;
+}
+
+static ptr<data> load(int knn)
+{
+    arguments args;
+    args.update("knn", std::to_string(knn));
+    return plugins_manager::load_data(data_file, "data_rbf", args);
+}
+
+int main()
+{
+    // Random abscissae in [0,1]^2, and two channels
+    const int size = 500;
+    RowMatrixXd points = (RowMatrixXd::Random(size, 4).array() + 1.0) * 0.5;
+    points.col(2) = (3.0 * points.col(0)).array().sin();
+    points.col(3) = points.col(0).cwiseProduct(points.col(1));
+
+    {
+        std::ofstream out(data_file);
+        out.precision(std::numeric_limits<double>::digits10 + 2);
+        out << "#DIM 2 2" << std::endl << "#VS 0" << std::endl;
+        for (int i = 0; i < size; ++i)
+            out << points.row(i) << std::endl;
+    }
+
+    // At the abscissae of the data, the nearest neighbour is the point
+    // itself, which the search always finds first.
+    remove_indices();
+    {
+        ptr<data> rbf = load(1);
+        TEST_ASSERT(rbf != NULL);
+
+        RowMatrixXd y(size, 2);
+        rbf->values(points.leftCols(2), y);
+        const double error = (y - points.rightCols(2)).cwiseAbs().maxCoeff();
+        std::cout << "<<INFO>> max error at the data points " << error << std::endl;
+        TEST_ASSERT(error < 1e-12);
+    }
+
+    // Random queries, as one block searched with all the threads and as
+    // small blocks searched from a parallel region.
+    const int rows = 2000;
+    const RowMatrixXd x = (RowMatrixXd::Random(rows, 2).array() + 1.0) * 0.5;
+    RowMatrixXd block(rows, 2), chunks(rows, 2);
+
+    remove_indices();
+    ptr<data> rbf = load(4);
+    TEST_ASSERT(rbf != NULL);
+    rbf->values(x, block);
+    parallel_for_chunks(rows, 64, [&](int, int first, int count)
+    {
+        Eigen::Ref<RowMatrixXd> y = chunks.middleRows(first, count);
+        rbf->values(x.middleRows(first, count), y);
+    });
+    TEST_ASSERT(block == chunks);
+
+    // Each value is a weighted mean of the data values.
+    TEST_ASSERT((block.rowwise() - points.rightCols(2).colwise().minCoeff())
+                .minCoeff() >= -1e-12);
+    TEST_ASSERT((block.rowwise() - points.rightCols(2).colwise().maxCoeff())
+                .maxCoeff() <= 1e-12);
+
+    // The second run loads the k-d tree saved by the first one.
+    ptr<data> cached = load(4);
+    TEST_ASSERT(cached != NULL);
+    RowMatrixXd y(rows, 2);
+    cached->values(x, y);
+    TEST_ASSERT(y == block);
+
+    const int removed = remove_indices();
+    std::remove(data_file);
+    std::cout << "<<INFO>> " << removed << " k-d tree(s) saved" << std::endl;
+    TEST_ASSERT(removed == 1);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/* ALTA --- Analysis of Bidirectional Reflectance Distribution Functions
+
+   Copyright (C) 2017 Inria
+
+   This file is part of ALTA.
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0.  If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/.  */
+
+/* Compare the text loader of 'vertical_segment' against a reference
+ * loader that reads one line at a time with 'std::getline' and
+ * 'std::stringstream', the way ALTA used to.  Check that both produce the
+ * same samples and report their throughput.  */
+
+#include <core/args.h>
+#include <core/data.h>
+#include <core/vertical_segment.h>
+#include <core/plugins_manager.h>
+#include <tests.h>
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+
+using namespace alta;
+
+static const int dimX = 2, dimY = 3;
+
+// Return the text representation of ROWS samples, with asymmetrical
+// confidence intervals on the first Y dimension.
+static std::string make_text_data(int rows)
+{
+    std::ostringstream out;
+    out << "#DIM " << dimX << " " << dimY << "\n"
+        << "#VS 2\n"
+        << "#PARAM_IN UNKNOWN_INPUT\n"
+        << "#PARAM_OUT RGB_COLOR\n";
+
+    out << std::setprecision(std::numeric_limits<double>::digits10);
+    for (int i = 0; i < rows; ++i)
+    {
+        if (i % 1000 == 0)
+            out << "# a comment\n";
+
+        double t = double(i) / rows;
+        out << t << " " << 1. - t << "\t"
+            << std::sin(10. * t) << " " << std::cos(10. * t) << " " << t * t
+            << " " << 0.01 * t << " " << 0.02 * t << "\n";
+    }
+
+    return out.str();
+}
+
+// Load TEXT the way ALTA used to, with '--ymin 0 --dt 0.05' filtering
+// options, and return the rows as a matrix.
+static RowMatrixXd reference_load(const std::string& text)
+{
+    std::istringstream input(text);
+    arguments::parse_header(input);
+
+    const int row_count = dimX + 3 * dimY;
+    std::vector<double> content;
+
+    while(input.good())
+    {
+        std::string line;
+        std::getline(input, line);
+        std::stringstream linestream(line);
+        if(line.empty() || linestream.peek() == '#')
+            continue;
+
+        auto start = content.size();
+        for(int i = 0; i < dimX + dimY; ++i)
+        {
+            double item;
+            linestream >> item;
+            content.push_back(item);
+        }
+        for(int i = 0; i < 2 * dimY; ++i)
+            content.push_back(0.);
+
+        double* v = &content[start];
+        for(int i = 0; i < dimY; ++i)
+        {
+            double min_dt = -0.05, max_dt = 0.05;
+            if(i == 0)
+            {
+                linestream >> min_dt >> max_dt;
+                min_dt = -min_dt;
+            }
+            v[dimX +   dimY + i] = v[dimX + i] + min_dt;
+            v[dimX + 2*dimY + i] = v[dimX + i] + max_dt;
+        }
+
+        bool keep = true;
+        for(int i = 0; i < dimY; ++i)
+            keep = keep && v[dimX + i] >= 0.;
+        if(!keep)
+            content.resize(start);
+    }
+
+    return Eigen::Map<RowMatrixXd>(content.data(),
+                                   content.size() / row_count, row_count);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 50000;
+    const std::string text = make_text_data(rows);
+    const double megabytes = text.size() / (1024. * 1024.);
+
+    auto start = std::chrono::steady_clock::now();
+    RowMatrixXd expected = reference_load(text);
+    double reference_time = seconds_since(start);
+
+    arguments args = { { "ymin", "[0, 0, 0]" }, { "dt", "0.05" } };
+    std::istringstream input(text);
+    start = std::chrono::steady_clock::now();
+    auto data = dynamic_pointer_cast<vertical_segment>(
+        plugins_manager::load_data("vertical_segment", input, args));
+    double loader_time = seconds_since(start);
+
+    TEST_ASSERT(data != NULL);
+    TEST_ASSERT(data->size() == expected.rows());
+    TEST_ASSERT(data->matrix_view() == expected);
+
+    std::cout << "<<INFO>> " << rows << " rows, " << megabytes << " MiB"
+              << std::endl
+              << "<<INFO>> reference loader: " << reference_time << " s ("
+              << megabytes / reference_time << " MiB/s)" << std::endl
+              << "<<INFO>> ALTA loader:      " << loader_time << " s ("
+              << megabytes / loader_time << " MiB/s)" << std::endl;
+
+    return EXIT_SUCCESS;
+}